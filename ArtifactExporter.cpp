@@ -0,0 +1,210 @@
+#include "ArtifactExporter.h"
+#include "SimilarityMeasure.h"
+
+using namespace cv;
+using namespace std;
+
+//--------------------------------------------------------------------------------------
+// Constructors
+//--------------------------------------------------------------------------------------
+
+// Starts the background I/O threads
+ArtifactExporter::ArtifactExporter(int threadCount) {
+	activeTasks = 0;
+	stopping = false;
+
+	for (int t = 0; t < max(threadCount, 1); t++)
+		workers.push_back(thread(&ArtifactExporter::RunWorker, this));
+}
+
+// Finishes all queued exports, then stops the background I/O threads
+ArtifactExporter::~ArtifactExporter() {
+	{
+		lock_guard<mutex> lock(tasksMutex);
+		stopping = true;
+	}
+
+	tasksAvailable.notify_all();
+
+	for (thread& worker : workers)
+		worker.join();
+}
+
+//--------------------------------------------------------------------------------------
+// Getters & Setters
+//--------------------------------------------------------------------------------------
+
+int ArtifactExporter::GetPendingCount() {
+	lock_guard<mutex> lock(tasksMutex);
+	return int(tasks.size()) + activeTasks;
+}
+
+//--------------------------------------------------------------------------------------
+// Instance Methods (Public)
+//--------------------------------------------------------------------------------------
+
+// Exports the artifacts of a similarity stage according to the options (the matrix is also kept for on-demand export)
+void ArtifactExporter::Export(const SimilarityMatrix& matrix, string videoFilePath, string matrixType, ExportOptions options) {
+	// Parameters:
+	// - matrix: output of the stage (the handle is kept while artifacts remain to be exported, sharing the distance data with the caller)
+	// - videoFilePath: file path for video (artifact file names are derived from it)
+	// - matrixType: Euclidean, motion or future cost
+	// - options: artifacts to write and when to write them
+
+	string key = videoFilePath + "|" + matrixType;
+
+	{
+		lock_guard<mutex> lock(tasksMutex);
+		int exported = (options.mode == ExportMode::OnDemand) ? ARTIFACT_NONE : options.artifacts;
+
+		// Nothing is left to export on demand, so the matrix is not kept (it would hold the whole matrix for the rest of the session)
+		if ((exported & ARTIFACT_ALL) == ARTIFACT_ALL) {
+			deferredMatrices.erase(key);
+			exportedArtifacts.erase(key);
+		}
+		else {
+			deferredMatrices[key] = matrix;
+			exportedArtifacts[key] = exported;
+		}
+	}
+
+	if (options.mode != ExportMode::OnDemand)
+		WriteArtifacts(matrix, videoFilePath, matrixType, options.artifacts, options.mode == ExportMode::Background);
+}
+
+// Queues export of artifacts of a stage that have not already been exported - returns false if the stage has not been computed (or its
+// matrix has been released)
+bool ArtifactExporter::ExportDeferred(string videoFilePath, string matrixType, int artifacts) {
+	string key = videoFilePath + "|" + matrixType;
+	SimilarityMatrix matrix;
+
+	{
+		lock_guard<mutex> lock(tasksMutex);
+
+		auto existing = deferredMatrices.find(key);
+		if (existing == deferredMatrices.end())
+			return false;
+
+		matrix = existing->second;
+		artifacts &= ~exportedArtifacts[key];
+		exportedArtifacts[key] |= artifacts;
+
+		// Release the matrix once every artifact has been queued (the queued writes hold their own handles)
+		if ((exportedArtifacts[key] & ARTIFACT_ALL) == ARTIFACT_ALL) {
+			deferredMatrices.erase(existing);
+			exportedArtifacts.erase(key);
+		}
+	}
+
+	WriteArtifacts(matrix, videoFilePath, matrixType, artifacts, true);
+	return true;
+}
+
+// Blocks until every queued export has been written
+void ArtifactExporter::WaitForPending() {
+	unique_lock<mutex> lock(tasksMutex);
+	tasksFinished.wait(lock, [this]() { return tasks.empty() && (activeTasks == 0); });
+}
+
+// Releases the matrices kept for on-demand export (queued exports are still written)
+void ArtifactExporter::Release(string videoFilePath) {
+	// Parameters:
+	// - videoFilePath: video whose matrices are released (empty releases every video's)
+
+	lock_guard<mutex> lock(tasksMutex);
+
+	if (videoFilePath.empty()) {
+		deferredMatrices.clear();
+		exportedArtifacts.clear();
+		return;
+	}
+
+	string prefix = videoFilePath + "|";
+
+	for (auto entry = deferredMatrices.begin(); entry != deferredMatrices.end(); ) {
+		if (entry->first.compare(0, prefix.size(), prefix) == 0) {
+			exportedArtifacts.erase(entry->first);
+			entry = deferredMatrices.erase(entry);
+		}
+		else {
+			entry++;
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// Static Methods (Public)
+//--------------------------------------------------------------------------------------
+
+// Returns the exporter shared by the similarity measure and the user interface
+ArtifactExporter& ArtifactExporter::GetSharedExporter() {
+	static ArtifactExporter exporter;
+	return exporter;
+}
+
+//--------------------------------------------------------------------------------------
+// Instance Methods (Private)
+//--------------------------------------------------------------------------------------
+
+// Adds an export task to the queue
+void ArtifactExporter::Enqueue(function<void()> task) {
+	{
+		lock_guard<mutex> lock(tasksMutex);
+		tasks.push_back(task);
+	}
+
+	tasksAvailable.notify_one();
+}
+
+// Runs queued export tasks until the exporter is stopped (remaining tasks are finished first)
+void ArtifactExporter::RunWorker() {
+	while (true) {
+		function<void()> task;
+
+		{
+			unique_lock<mutex> lock(tasksMutex);
+			tasksAvailable.wait(lock, [this]() { return stopping || !tasks.empty(); });
+
+			if (tasks.empty())
+				return;
+
+			task = tasks.front();
+			tasks.pop_front();
+			activeTasks++;
+		}
+
+		task();
+
+		{
+			lock_guard<mutex> lock(tasksMutex);
+			activeTasks--;
+		}
+
+		tasksFinished.notify_all();
+	}
+}
+
+// Writes the requested artifacts (one task per file when in the background, so files are written concurrently)
+void ArtifactExporter::WriteArtifacts(const SimilarityMatrix& matrix, string videoFilePath, string matrixType, int artifacts, bool background) {
+	vector<function<void()>> writes;
+
+	if (artifacts & ARTIFACT_BINARY)
+		writes.push_back([=]() { matrix.SaveDistanceMatrix(SimilarityMeasure::ComputeNewFilePath(videoFilePath, "distance", matrixType, "vtm"), videoFilePath); });
+
+	if (artifacts & ARTIFACT_CSV) {
+		writes.push_back([=]() { matrix.SaveDistanceMatrixAsCSV(SimilarityMeasure::ComputeNewFilePath(videoFilePath, "distance", matrixType, "csv")); });
+		writes.push_back([=]() { matrix.SaveProbabilityMatrixAsCSV(SimilarityMeasure::ComputeNewFilePath(videoFilePath, "probability", matrixType, "csv")); });
+	}
+
+	if (artifacts & ARTIFACT_IMAGE) {
+		writes.push_back([=]() { matrix.SaveDistanceMatrixAsImage(SimilarityMeasure::ComputeNewFilePath(videoFilePath, "distance", matrixType, "png")); });
+		writes.push_back([=]() { matrix.SaveProbabilityMatrixAsImage(SimilarityMeasure::ComputeNewFilePath(videoFilePath, "probability", matrixType, "png")); });
+	}
+
+	for (function<void()>& write : writes) {
+		if (background)
+			Enqueue(write);
+		else
+			write();
+	}
+}
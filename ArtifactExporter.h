@@ -0,0 +1,78 @@
+#pragma once
+#include "SimilarityMatrix.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Artifacts that can be exported for a similarity stage (combined as flags)
+enum ArtifactType {
+	ARTIFACT_NONE = 0,
+	ARTIFACT_BINARY = 1,	// Distance matrix as binary matrix file
+	ARTIFACT_CSV = 2,		// Distance and probability matrices as CSV
+	ARTIFACT_IMAGE = 4,		// Distance and probability matrices as PNG
+	ARTIFACT_ALL = 7
+};
+
+// When the artifacts of a stage are written
+enum class ExportMode {
+	Immediate,	// Before the stage returns
+	Background,	// Queued to the background I/O threads (the next stage starts as soon as the matrix is in memory)
+	OnDemand	// Only when requested through ExportDeferred (e.g. when the matrix is viewed)
+};
+
+// Export options for a run of the similarity measure
+struct ExportOptions {
+	int artifacts = ARTIFACT_BINARY | ARTIFACT_IMAGE;
+	ExportMode mode = ExportMode::Background;
+};
+
+// ArtifactExporter
+// - Writes the files produced by each similarity stage (binary matrix, CSV, PNG) on a small pool of background I/O threads
+// - The last matrix of each stage is kept while some of its artifacts have not been exported, so they can be produced later on demand -
+//   kept matrices are released once every artifact has been written, or by Release (e.g. when another video is selected)
+
+class ArtifactExporter {
+	public:
+		// Constructors
+		ArtifactExporter(int threadCount = DEFAULT_THREAD_COUNT);
+		~ArtifactExporter();
+
+		// Getters & Setters
+		int GetPendingCount();
+
+		// Instance Methods
+		void Export(const SimilarityMatrix& matrix, string videoFilePath, string matrixType, ExportOptions options);
+		bool ExportDeferred(string videoFilePath, string matrixType, int artifacts);
+		void WaitForPending();
+		void Release(string videoFilePath = "");
+
+		// Static Methods
+		static ArtifactExporter& GetSharedExporter();
+
+	private:
+		// Parameters
+		vector<thread> workers;
+		deque<function<void()>> tasks;
+		mutex tasksMutex;
+		condition_variable tasksAvailable;
+		condition_variable tasksFinished;
+		int activeTasks;
+		bool stopping;
+		map<string, SimilarityMatrix> deferredMatrices;
+		map<string, int> exportedArtifacts;
+
+		// Static Parameters
+		static const int DEFAULT_THREAD_COUNT = 2;
+
+		// Instance Methods
+		void Enqueue(function<void()> task);
+		void RunWorker();
+		void WriteArtifacts(const SimilarityMatrix& matrix, string videoFilePath, string matrixType, int artifacts, bool background);
+};
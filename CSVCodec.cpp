@@ -0,0 +1,240 @@
+#include "CSVCodec.h"
+#include "MappedFile.h"
+#include "WorkStealingScheduler.h"
+#include <charconv>
+#include <fstream>
+
+using namespace cv;
+using namespace std;
+
+//--------------------------------------------------------------------------------------
+// Static Methods (Public)
+//--------------------------------------------------------------------------------------
+
+// Reads CSV file into a float matrix - returns an empty matrix if the file is missing, empty, ragged or contains invalid values
+Mat CSVCodec::Read(string filePath, string* error, int threadCount) {
+	// Parameters:
+	// - filePath: CSV file (comma separated values, one row per line, blank lines ignored)
+	// - error: receives a description of why the file was rejected (optional)
+	// - threadCount: number of threads used to parse the file (0 uses all cores)
+
+	MappedFile file;
+	if (!file.Open(filePath) || (file.GetSize() == 0)) {
+		if (error)
+			*error = "Unable to open " + filePath;
+		return Mat();
+	}
+
+	shared_ptr<MappedRegion> region = file.MapRegion(0, size_t(file.GetSize()));
+	if (!region) {
+		if (error)
+			*error = "Unable to map " + filePath;
+		return Mat();
+	}
+
+	const char* begin = reinterpret_cast<const char*>(region->GetData());
+	const char* end = begin + region->GetLength();
+
+	// 1. Split file into chunks of whole lines
+	int chunkCount = max(1, (threadCount > 0 ? threadCount : WorkStealingScheduler::GetDefaultThreadCount()) * CHUNKS_PER_THREAD);
+	vector<const char*> boundaries(chunkCount + 1);
+
+	for (int c = 0; c < chunkCount; c++)
+		boundaries[c] = FindLineStart(begin + (region->GetLength() * c) / chunkCount, begin, end);
+	boundaries[chunkCount] = end;
+
+	// 2. Count rows in each chunk (in parallel), then offset each chunk by the rows before it
+	vector<int> chunkRows(chunkCount, 0);
+
+	WorkStealingScheduler::Run(chunkCount, [&](int c) {
+		for (const char* line = boundaries[c]; line < boundaries[c + 1];) {
+			const char* lineEnd = find(line, boundaries[c + 1], '\n');
+			if (!IsBlankLine(line, lineEnd))
+				chunkRows[c]++;
+			line = lineEnd + 1;
+		}
+	}, threadCount);
+
+	vector<int> chunkOffsets(chunkCount + 1, 0);
+	for (int c = 0; c < chunkCount; c++)
+		chunkOffsets[c + 1] = chunkOffsets[c] + chunkRows[c];
+
+	int rows = chunkOffsets[chunkCount];
+	if (rows == 0) {
+		if (error)
+			*error = filePath + " contains no rows";
+		return Mat();
+	}
+
+	// 3. Number of columns is taken from the first row
+	const char* firstLine = begin;
+	const char* firstLineEnd = find(firstLine, end, '\n');
+	while (IsBlankLine(firstLine, firstLineEnd)) {
+		firstLine = firstLineEnd + 1;
+		firstLineEnd = find(firstLine, end, '\n');
+	}
+
+	int cols = int(count(firstLine, firstLineEnd, ',')) + 1;
+	Mat matrix(rows, cols, CV_32F);
+
+	// 4. Parse chunks (in parallel) directly into the matrix - each chunk stops at its first invalid row
+	vector<int> invalidRows(chunkCount, -1);
+	vector<int> invalidCounts(chunkCount, 0);
+
+	WorkStealingScheduler::Run(chunkCount, [&](int c) {
+		int row = chunkOffsets[c];
+
+		for (const char* line = boundaries[c]; line < boundaries[c + 1];) {
+			const char* lineEnd = find(line, boundaries[c + 1], '\n');
+
+			if (!IsBlankLine(line, lineEnd)) {
+				int valueCount = ParseLine(line, lineEnd, matrix.ptr<float>(row), cols);
+
+				if (valueCount != cols) {
+					invalidRows[c] = row;
+					invalidCounts[c] = valueCount;
+					break;
+				}
+
+				row++;
+			}
+
+			line = lineEnd + 1;
+		}
+	}, threadCount);
+
+	// Report first invalid row
+	for (int c = 0; c < chunkCount; c++) {
+		if (invalidRows[c] < 0)
+			continue;
+
+		if (error) {
+			if (invalidCounts[c] < 0)
+				*error = "Row " + to_string(invalidRows[c] + 1) + " contains an invalid value";
+			else
+				*error = "Row " + to_string(invalidRows[c] + 1) + " has " + to_string(invalidCounts[c]) + " values (expected " + to_string(cols) + ")";
+		}
+
+		return Mat();
+	}
+
+	return matrix;
+}
+
+// Writes float matrix to CSV file
+bool CSVCodec::Write(string filePath, Mat matrix, int threadCount) {
+	ofstream output(filePath, ios::binary | ios::trunc);
+	if (!output.is_open())
+		return false;
+
+	WriteRows(output, matrix, threadCount);
+	output.close();
+
+	return !output.fail();
+}
+
+// Writes rows of float matrix to a stream as CSV (formatted in parallel, one buffer-sized batch of rows at a time)
+void CSVCodec::WriteRows(ostream& output, Mat matrix, int threadCount) {
+	if (matrix.empty())
+		return;
+
+	if (matrix.type() != CV_32F)
+		matrix.convertTo(matrix, CV_32F);
+
+	size_t rowBytes = size_t(matrix.cols) * MAX_VALUE_CHARS + 1;
+	int rowsPerBatch = int(max(WRITE_BUFFER_BYTES / rowBytes, size_t(1)));
+	int taskCount = max(1, (threadCount > 0 ? threadCount : WorkStealingScheduler::GetDefaultThreadCount()) * CHUNKS_PER_THREAD);
+
+	vector<char> buffer(size_t(min(rowsPerBatch, matrix.rows)) * rowBytes);
+
+	for (int batchStart = 0; batchStart < matrix.rows; batchStart += rowsPerBatch) {
+		int batchRows = min(rowsPerBatch, matrix.rows - batchStart);
+		int rowsPerTask = (batchRows + taskCount - 1) / taskCount;
+		vector<size_t> taskBytes(taskCount, 0);
+
+		// Each task formats its rows into its own region of the buffer (sized for the longest possible rows)
+		WorkStealingScheduler::Run(taskCount, [&](int t) {
+			int start = t * rowsPerTask;
+
+			for (int r = start; r < min(start + rowsPerTask, batchRows); r++)
+				taskBytes[t] += FormatRow(matrix.ptr<float>(batchStart + r), matrix.cols, buffer.data() + size_t(start) * rowBytes + taskBytes[t]);
+		}, threadCount);
+
+		for (int t = 0; (t < taskCount) && (taskBytes[t] > 0); t++)
+			output.write(buffer.data() + size_t(t) * rowsPerTask * rowBytes, streamsize(taskBytes[t]));
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// Static Methods (Private)
+//--------------------------------------------------------------------------------------
+
+// Returns start of the first line at or after position (i.e. position itself if it starts a line)
+const char* CSVCodec::FindLineStart(const char* position, const char* begin, const char* end) {
+	if (position <= begin)
+		return begin;
+
+	if (*(position - 1) == '\n')
+		return position;
+
+	const char* newline = find(position, end, '\n');
+	return (newline == end) ? end : newline + 1;
+}
+
+// Parses the comma separated values of a line - returns number of values (-1 if a value is invalid)
+int CSVCodec::ParseLine(const char* begin, const char* end, float* output, int capacity) {
+	int count = 0;
+	const char* position = begin;
+
+	while (true) {
+		while ((position < end) && ((*position == ' ') || (*position == '\t') || (*position == '+')))
+			position++;
+
+		float value;
+		from_chars_result result = from_chars(position, end, value);
+		if (result.ec != errc())
+			return -1;
+
+		if (count < capacity)
+			output[count] = value;
+		count++;
+
+		position = result.ptr;
+		while ((position < end) && ((*position == ' ') || (*position == '\t') || (*position == '\r')))
+			position++;
+
+		if (position == end)
+			return count;
+		if (*position != ',')
+			return -1;
+
+		position++;
+	}
+}
+
+// Checks if line contains only whitespace
+bool CSVCodec::IsBlankLine(const char* begin, const char* end) {
+	for (const char* position = begin; position < end; position++) {
+		if ((*position != ' ') && (*position != '\t') && (*position != '\r'))
+			return false;
+	}
+
+	return true;
+}
+
+// Formats row of values as CSV (shortest representation that reads back as the same float) - returns number of characters written
+size_t CSVCodec::FormatRow(const float* values, int count, char* output) {
+	char* position = output;
+
+	for (int j = 0; j < count; j++) {
+		position = to_chars(position, position + MAX_VALUE_CHARS, values[j]).ptr;
+
+		if (j + 1 < count) {
+			*position++ = ',';
+			*position++ = ' ';
+		}
+	}
+
+	*position++ = '\n';
+	return size_t(position - output);
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <ostream>
+#include <string>
+
+using namespace std;
+
+// CSVCodec
+// - Reads and writes float matrices as CSV (kept for interoperability - the binary matrix file is the native format)
+// - Reading maps the file into memory, splits it into chunks of whole rows and parses the chunks in parallel directly into the matrix
+// - Writing formats rows in parallel (shortest representation that round-trips) into large buffers that are written in order
+// - Rows with a different number of values to the first row are rejected rather than padded/truncated
+
+class CSVCodec {
+	public:
+		// Static Methods
+		static cv::Mat Read(string filePath, string* error = NULL, int threadCount = 0);
+		static bool Write(string filePath, cv::Mat matrix, int threadCount = 0);
+		static void WriteRows(ostream& output, cv::Mat matrix, int threadCount = 0);
+
+	private:
+		// Static Parameters
+		static const int CHUNKS_PER_THREAD = 4;
+		static const size_t MAX_VALUE_CHARS = 24;
+		static const size_t WRITE_BUFFER_BYTES = 64 * 1024 * 1024;
+
+		// Static Methods
+		static const char* FindLineStart(const char* position, const char* begin, const char* end);
+		static int ParseLine(const char* begin, const char* end, float* output, int capacity);
+		static bool IsBlankLine(const char* begin, const char* end);
+		static size_t FormatRow(const float* values, int count, char* output);
+};
@@ -0,0 +1,262 @@
+#include "CompactMatrix.h"
+#include "WorkStealingScheduler.h"
+#include <cfloat>
+#include <climits>
+#include <cstring>
+#include <limits>
+
+using namespace cv;
+using namespace std;
+
+//--------------------------------------------------------------------------------------
+// Constructors
+//--------------------------------------------------------------------------------------
+
+// Default constructor - creates an empty matrix
+CompactMatrix::CompactMatrix() {
+	storage = MatrixStorage::Float32;
+}
+
+// Encodes a float matrix (full precision storage shares the matrix rather than copying it)
+CompactMatrix::CompactMatrix(const Mat& matrix, MatrixStorage storage, int threadCount) {
+	// Parameters:
+	// - matrix: distance matrix to encode
+	// - storage: element storage
+	// - threadCount: number of threads used to encode rows (0 uses all cores)
+
+	this->storage = storage;
+
+	Mat values = matrix;
+	if (values.type() != CV_32F)
+		matrix.convertTo(values, CV_32F);
+
+	if ((storage == MatrixStorage::Float32) || values.empty()) {
+		codes = values;
+		scales.assign(values.rows, 1.0f);
+		offsets.assign(values.rows, 0.0f);
+		unboundedRows.assign(values.rows, 0);
+		return;
+	}
+
+	if (storage == MatrixStorage::Float16)
+		codes.create(values.rows, values.cols, CV_16F);
+	else if (storage == MatrixStorage::Quantised16)
+		codes.create(values.rows, values.cols, CV_16U);
+	else
+		codes.create(values.rows, values.cols, CV_8U);
+
+	scales.assign(values.rows, 1.0f);
+	offsets.assign(values.rows, 0.0f);
+	unboundedRows.assign(values.rows, 0);
+
+	int taskCount = (values.rows + ROWS_PER_TASK - 1) / ROWS_PER_TASK;
+
+	WorkStealingScheduler::Run(taskCount, [&](int t) {
+		for (int row = t * ROWS_PER_TASK; row < min((t + 1) * ROWS_PER_TASK, values.rows); row++)
+			EncodeRow(values.ptr<float>(row), row);
+	}, threadCount);
+}
+
+//--------------------------------------------------------------------------------------
+// Getters & Setters
+//--------------------------------------------------------------------------------------
+
+MatrixStorage CompactMatrix::GetStorage() const {
+	return storage;
+}
+
+int CompactMatrix::GetRows() const {
+	return codes.rows;
+}
+
+int CompactMatrix::GetCols() const {
+	return codes.cols;
+}
+
+// Returns bytes held by the codes and the per-row scales/offsets
+size_t CompactMatrix::GetBytes() const {
+	return (codes.total() * codes.elemSize()) + ((scales.size() + offsets.size()) * sizeof(float)) + unboundedRows.size();
+}
+
+//--------------------------------------------------------------------------------------
+// Instance Methods (Public)
+//--------------------------------------------------------------------------------------
+
+bool CompactMatrix::IsEmpty() const {
+	return codes.empty();
+}
+
+// Dequantises columns [colStart, colStart + cols) of a row into the output buffer
+void CompactMatrix::DecodeRow(int row, int colStart, int cols, float* output) const {
+	float scale = scales[row];
+	float offset = offsets[row];
+
+	if (storage == MatrixStorage::Float32) {
+		memcpy(output, codes.ptr<float>(row) + colStart, cols * sizeof(float));
+	}
+	else if (storage == MatrixStorage::Float16) {
+		// Vectorised half to float conversion (scaled back up if the row was scaled down)
+		Mat half(1, cols, CV_16F, const_cast<ushort*>(codes.ptr<ushort>(row) + colStart));
+		Mat decoded(1, cols, CV_32F, output);
+		half.convertTo(decoded, CV_32F, scale);
+	}
+	else if (storage == MatrixStorage::Quantised16) {
+		const ushort* values = codes.ptr<ushort>(row) + colStart;
+		for (int c = 0; c < cols; c++)
+			output[c] = offset + scale * values[c];
+
+		// Top code marks rejected pairs (only reserved in rows that hold any)
+		if (unboundedRows[row]) {
+			for (int c = 0; c < cols; c++) {
+				if (values[c] == USHRT_MAX)
+					output[c] = numeric_limits<float>::infinity();
+			}
+		}
+	}
+	else {
+		const uchar* values = codes.ptr<uchar>(row) + colStart;
+		for (int c = 0; c < cols; c++)
+			output[c] = offset + scale * values[c];
+
+		if (unboundedRows[row]) {
+			for (int c = 0; c < cols; c++) {
+				if (values[c] == UCHAR_MAX)
+					output[c] = numeric_limits<float>::infinity();
+			}
+		}
+	}
+}
+
+// Returns rows [rowStart, rowEnd) as a float matrix (full precision storage returns a header into the stored matrix, no copy)
+Mat CompactMatrix::DecodeRows(int rowStart, int rowEnd) const {
+	if (storage == MatrixStorage::Float32)
+		return codes.rowRange(rowStart, rowEnd);
+
+	Mat output(rowEnd - rowStart, codes.cols, CV_32F);
+
+	for (int row = rowStart; row < rowEnd; row++)
+		DecodeRow(row, 0, codes.cols, output.ptr<float>(row - rowStart));
+
+	return output;
+}
+
+// Returns the whole matrix as a float matrix
+Mat CompactMatrix::Decode(int threadCount) const {
+	if (storage == MatrixStorage::Float32)
+		return codes;
+
+	Mat output(codes.rows, codes.cols, CV_32F);
+	int taskCount = (codes.rows + ROWS_PER_TASK - 1) / ROWS_PER_TASK;
+
+	WorkStealingScheduler::Run(taskCount, [&](int t) {
+		for (int row = t * ROWS_PER_TASK; row < min((t + 1) * ROWS_PER_TASK, codes.rows); row++)
+			DecodeRow(row, 0, codes.cols, output.ptr<float>(row));
+	}, threadCount);
+
+	return output;
+}
+
+// Returns a single dequantised element
+float CompactMatrix::GetValue(int row, int col) const {
+	float value = 0;
+	DecodeRow(row, col, 1, &value);
+
+	return value;
+}
+
+// Measures the error of the stored matrix against the full precision matrix it was encoded from
+CompactMatrixError CompactMatrix::GetError(const Mat& reference, int threadCount) const {
+	CompactMatrixError error;
+
+	if ((reference.rows != codes.rows) || (reference.cols != codes.cols) || (reference.type() != CV_32F))
+		return error;
+
+	int taskCount = (codes.rows + ROWS_PER_TASK - 1) / ROWS_PER_TASK;
+	vector<double> largestDifference(taskCount, 0);
+	vector<double> largestMagnitude(taskCount, 0);
+
+	WorkStealingScheduler::Run(taskCount, [&](int t) {
+		vector<float> decoded(codes.cols);
+
+		for (int row = t * ROWS_PER_TASK; row < min((t + 1) * ROWS_PER_TASK, codes.rows); row++) {
+			const float* values = reference.ptr<float>(row);
+			DecodeRow(row, 0, codes.cols, decoded.data());
+
+			for (int c = 0; c < codes.cols; c++) {
+				if (values[c] >= FLT_MAX)
+					continue;
+
+				largestDifference[t] = max(largestDifference[t], double(abs(decoded[c] - values[c])));
+				largestMagnitude[t] = max(largestMagnitude[t], double(abs(values[c])));
+			}
+		}
+	}, threadCount);
+
+	double magnitude = 0;
+	for (int t = 0; t < taskCount; t++) {
+		error.maxAbsolute = max(error.maxAbsolute, largestDifference[t]);
+		magnitude = max(magnitude, largestMagnitude[t]);
+	}
+
+	error.maxRelative = (magnitude > 0) ? (error.maxAbsolute / magnitude) : 0;
+
+	return error;
+}
+
+//--------------------------------------------------------------------------------------
+// Instance Methods (Private)
+//--------------------------------------------------------------------------------------
+
+// Encodes one row of values (sets the row's scale and offset)
+void CompactMatrix::EncodeRow(const float* values, int row) {
+	int cols = codes.cols;
+	float lowest = FLT_MAX;
+	float highest = -FLT_MAX;
+
+	// Range of the finite values (rejected pairs are coded separately)
+	for (int c = 0; c < cols; c++) {
+		if (values[c] < FLT_MAX) {
+			lowest = min(lowest, values[c]);
+			highest = max(highest, values[c]);
+		}
+		else {
+			unboundedRows[row] = 1;
+		}
+	}
+
+	if (lowest > highest) {
+		lowest = 0;
+		highest = 0;
+	}
+
+	if (storage == MatrixStorage::Float16) {
+		// Rows whose values would overflow half precision are scaled down (relative precision is unchanged)
+		float magnitude = max(abs(lowest), abs(highest));
+		scales[row] = (magnitude > HALF_LIMIT) ? (magnitude / HALF_LIMIT) : 1.0f;
+
+		Mat input(1, cols, CV_32F, const_cast<float*>(values));
+		Mat half(1, cols, CV_16F, codes.ptr<ushort>(row));
+		input.convertTo(half, CV_16F, 1.0 / scales[row]);
+		return;
+	}
+
+	// Map [lowest, highest] onto [0, levels] (rounded to the nearest code) - rejected pairs take the code above levels
+	float top = (storage == MatrixStorage::Quantised16) ? 65535.0f : 255.0f;
+	float levels = unboundedRows[row] ? (top - 1) : top;
+	float scale = (highest - lowest) / levels;
+	float inverse = (scale > 0) ? (1 / scale) : 0;
+
+	offsets[row] = lowest;
+	scales[row] = scale;
+
+	if (storage == MatrixStorage::Quantised16) {
+		ushort* output = codes.ptr<ushort>(row);
+		for (int c = 0; c < cols; c++)
+			output[c] = ushort((values[c] < FLT_MAX) ? min((values[c] - lowest) * inverse + 0.5f, levels) : top);
+	}
+	else {
+		uchar* output = codes.ptr<uchar>(row);
+		for (int c = 0; c < cols; c++)
+			output[c] = uchar((values[c] < FLT_MAX) ? min((values[c] - lowest) * inverse + 0.5f, levels) : top);
+	}
+}
\ No newline at end of file
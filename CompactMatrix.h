@@ -0,0 +1,62 @@
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+using namespace std;
+
+// Element storage of a distance matrix
+enum class MatrixStorage {
+	Float32,		// Full precision (no conversion)
+	Float16,		// Half precision (half the memory, ~3 significant digits)
+	Quantised16,	// 16-bit codes with a per-row scale and offset (half the memory)
+	Quantised8		// 8-bit codes with a per-row scale and offset (a quarter of the memory)
+};
+
+// Error of a compact matrix relative to the full precision matrix it was encoded from
+struct CompactMatrixError {
+	double maxAbsolute = 0;		// Largest absolute difference of any element
+	double maxRelative = 0;		// Largest absolute difference relative to the largest magnitude in the matrix
+};
+
+// CompactMatrix
+// - Stores a float distance matrix in half precision or as quantised codes
+// - Quantised rows store value = offset + scale * code, where offset and scale map the row's range onto the full range of codes
+// - Rejected pairs (+inf) are kept out of each row's range - quantised rows holding any reserve their top code for them
+// - Half precision rows are scaled down when their values would overflow the half precision range
+// - Rows are dequantised on the fly (into a caller-supplied buffer) by the kernels that read them, so the full float matrix is never rebuilt
+
+class CompactMatrix {
+	public:
+		// Constructors
+		CompactMatrix();
+		CompactMatrix(const cv::Mat& matrix, MatrixStorage storage, int threadCount = 0);
+
+		// Getters & Setters
+		MatrixStorage GetStorage() const;
+		int GetRows() const;
+		int GetCols() const;
+		size_t GetBytes() const;
+
+		// Instance Methods
+		bool IsEmpty() const;
+		void DecodeRow(int row, int colStart, int cols, float* output) const;
+		cv::Mat DecodeRows(int rowStart, int rowEnd) const;
+		cv::Mat Decode(int threadCount = 0) const;
+		float GetValue(int row, int col) const;
+		CompactMatrixError GetError(const cv::Mat& reference, int threadCount = 0) const;
+
+	private:
+		// Parameters
+		MatrixStorage storage;
+		cv::Mat codes;
+		vector<float> scales;
+		vector<float> offsets;
+		vector<uchar> unboundedRows;
+
+		// Static Parameters
+		static constexpr float HALF_LIMIT = 32768.0f;
+		static const int ROWS_PER_TASK = 16;
+
+		// Instance Methods
+		void EncodeRow(const float* values, int row);
+};
@@ -14,7 +14,7 @@ CompoundLoop::CompoundLoop() {
 }
 
 // Creates a compound loop containing a single transition
-CompoundLoop::CompoundLoop(Transition t) {
+CompoundLoop::CompoundLoop(Transition t) : CompoundLoop() {
 	AddTransition(t);
 }
 
@@ -22,11 +22,17 @@ CompoundLoop::CompoundLoop(Transition t) {
 // Getters & Setters
 //--------------------------------------------------------------------------------------
 
-vector<Transition> CompoundLoop::GetTransitions() {
+vector<Transition> CompoundLoop::GetTransitions() const {
+	vector<Transition> transitions;
+	transitions.reserve(transitionIds.size());
+
+	for (int id : transitionIds)
+		transitions.push_back(table->transitions[id]);
+
 	return transitions;
 }
 
-int CompoundLoop::GetCost() {
+int CompoundLoop::GetCost() const {
 	return cost;
 }
 
@@ -34,7 +40,7 @@ void CompoundLoop::SetCost(int c) {
 	cost = c;
 }
 
-Point CompoundLoop::GetRange() {
+Point CompoundLoop::GetRange() const {
 	return range;
 }
 
@@ -46,70 +52,67 @@ void CompoundLoop::SetRange(Point r) {
 // Instance Methods (Public)
 //--------------------------------------------------------------------------------------
 
-// Add a tranisition to the compound loop (also recalculates cost and range)
+// Add a tranisition to the compound loop (also updates cost and range)
 void CompoundLoop::AddTransition(Transition t) {
-	transitions.push_back(t);
-
-	CalculateCost();
-	CalculateRange();
+	AddTransitionId(GetTransitionId(t));
 }
 
 // Removes a transition from the compound loop - ensures valid ranges by returning either one or two compound loops
 vector<CompoundLoop> CompoundLoop::RemoveTransition(Transition t) {
 
-	vector<Transition> newTransitionSet;
+	// Convert this compound loop into a list of transitions EXCLUDING transition t (its first occurrence)
+	vector<int> newTransitionIds = transitionIds;
+	vector<int>::iterator removed = find(newTransitionIds.begin(), newTransitionIds.end(), FindTransitionId(t));
 
-	// Convert this compound loop into a vector of transitions EXCLUDING transition t
-	for (int i = 0; i < transitions.size(); i++) {
-		if ((transitions[i] != t) || ((transitions[i] == t) && (newTransitionSet.size() != i)))
-			newTransitionSet.push_back(transitions[i]);
-	}
+	if (removed != newTransitionIds.end())
+		newTransitionIds.erase(removed);
 
-	// Sort this vector of transitions by their source frames (ascending)
-	sort(newTransitionSet.begin(), newTransitionSet.end(), [](Transition& a, Transition& b) {
-		return a.GetSourceFrame() < b.GetSourceFrame();
+	// Sort this list of transitions by their source frames (ascending)
+	sort(newTransitionIds.begin(), newTransitionIds.end(), [&](int a, int b) {
+		return table->transitions[a].GetSourceFrame() < table->transitions[b].GetSourceFrame();
 	});
 
-	// Convert this vector of transitions into compound loop(s) - ensure legal ranges
+	// Convert this list of transitions into compound loop(s) - ensure legal ranges
 	vector<CompoundLoop> compoundLoopsWithLegalTransitions;
-	CompoundLoop currentCompoundLoop;
+	CompoundLoop currentCompoundLoop = RemoveAllTransitions();
 
-	for (int i = 0; i < newTransitionSet.size(); i++) {
-		Transition t = newTransitionSet[i];
+	for (int id : newTransitionIds) {
+		Transition& next = table->transitions[id];
+		Point nextRange(next.GetSourceFrame(), next.GetDestinationFrame());
 
-		if (i == 0)
-			currentCompoundLoop.AddTransition(t);
-		else if (CheckIfOverlappingRanges(currentCompoundLoop, CompoundLoop(t)))
-			currentCompoundLoop.AddTransition(t);
-		else {
+		if ((currentCompoundLoop.GetNumberOfTransitions() > 0) && !CheckIfOverlappingRanges(currentCompoundLoop.range, nextRange)) {
 			compoundLoopsWithLegalTransitions.push_back(currentCompoundLoop);
-			currentCompoundLoop = currentCompoundLoop.RemoveAllTransitions();
-			currentCompoundLoop.AddTransition(t);
+			currentCompoundLoop = RemoveAllTransitions();
 		}
 
-		if (i == newTransitionSet.size() - 1)
-			compoundLoopsWithLegalTransitions.push_back(currentCompoundLoop);
+		currentCompoundLoop.AddTransitionId(id);
 	}
 
+	if (currentCompoundLoop.GetNumberOfTransitions() > 0)
+		compoundLoopsWithLegalTransitions.push_back(currentCompoundLoop);
+
 	return compoundLoopsWithLegalTransitions;
 }
 
-// Removes all transitions from the compound loop
-CompoundLoop CompoundLoop::RemoveAllTransitions() {
+// Removes all transitions from the compound loop (the empty loop keeps the transition table, so loops built from it merge cheaply)
+CompoundLoop CompoundLoop::RemoveAllTransitions() const {
 	CompoundLoop empty;
+	empty.table = table;
+
 	return empty;
 }
 
 // Returns number of transitions in compound loop
-int CompoundLoop::GetNumberOfTransitions() {
-	return transitions.size();
+int CompoundLoop::GetNumberOfTransitions() const {
+	return transitionIds.size();
 }
 
 // Returns transition with latest source frame
-Transition CompoundLoop::GetLatestTransition() {
+Transition CompoundLoop::GetLatestTransition() const {
 	Transition last;
 
-	for (Transition& t : transitions) {
+	for (int id : transitionIds) {
+		Transition& t = table->transitions[id];
 		if (t.GetSourceFrame() > last.GetSourceFrame())
 			last = t;
 	}
@@ -118,24 +121,26 @@ Transition CompoundLoop::GetLatestTransition() {
 }
 
 // Checks if the compound loop contains a specified transition
-bool CompoundLoop::ContainsTransition(Transition inputTransition) {
-
-	for (Transition& t : transitions) {
-		if (t == inputTransition)
-			return true;
-	}
-
-	return false;
+bool CompoundLoop::ContainsTransition(Transition inputTransition) const {
+	return ContainsTransitionId(FindTransitionId(inputTransition));
 }
 
-// Checks if the compound loop contains a specified transition
-bool CompoundLoop::ContainsTransitions(CompoundLoop c) {
+// Checks if the compound loop contains any transition of another compound loop
+bool CompoundLoop::ContainsTransitions(const CompoundLoop& c) const {
 
-	for (Transition& current : transitions) {
-		for (Transition& t : c.GetTransitions()) {
-			if (current == t)
+	// Same table - any common bit
+	if (table == c.table) {
+		for (size_t k = 0; k < min(members.size(), c.members.size()); k++) {
+			if (members[k] & c.members[k])
 				return true;
 		}
+
+		return false;
+	}
+
+	for (int id : c.transitionIds) {
+		if (ContainsTransition(c.table->transitions[id]))
+			return true;
 	}
 
 	return false;
@@ -145,31 +150,54 @@ bool CompoundLoop::ContainsTransitions(CompoundLoop c) {
 // Instance Methods (Private)
 //--------------------------------------------------------------------------------------
 
-// Calculate cost of compound loop
-void CompoundLoop::CalculateCost() {
-	int newCost = 0;
+// Adds a transition of the table by id (updates cost and range from the new transition only)
+void CompoundLoop::AddTransitionId(int id) {
+	Transition& t = table->transitions[id];
 
-	for (Transition& t : transitions) {
-		newCost += t.GetTransitionCost();
-	}
+	if (transitionIds.empty())
+		range = Point(t.GetSourceFrame(), t.GetDestinationFrame());
+	else
+		range = Point(max(range.x, t.GetSourceFrame()), min(range.y, t.GetDestinationFrame()));
+
+	cost += t.GetTransitionCost();
+	transitionIds.push_back(id);
+
+	if (members.size() <= size_t(id / 64))
+		members.resize(id / 64 + 1, 0);
 
-	SetCost(newCost);
+	members[id / 64] |= 1ULL << (id % 64);
 }
 
-// Calculates range of compound loop
-void CompoundLoop::CalculateRange() {
-	int start = INT_MIN;
-	int end = INT_MAX;
+// Returns the id of a transition, adding it to the table if necessary (creates the table if the loop has none)
+int CompoundLoop::GetTransitionId(Transition t) {
+	if (!table)
+		table = make_shared<TransitionTable>();
 
-	for (Transition& t : transitions) {
-		if (t.GetSourceFrame() > start)
-			start = t.GetSourceFrame();
+	tuple<int, int, float> key(t.GetSourceFrame(), t.GetDestinationFrame(), t.GetTransitionCost());
+	map<tuple<int, int, float>, int>::iterator entry = table->ids.find(key);
 
-		if (t.GetDestinationFrame() < end)
-			end = t.GetDestinationFrame();
-	}
+	if (entry != table->ids.end())
+		return entry->second;
+
+	int id = table->transitions.size();
+	table->transitions.push_back(t);
+	table->ids[key] = id;
+
+	return id;
+}
+
+// Returns the id of a transition (-1 if it is not in the table)
+int CompoundLoop::FindTransitionId(Transition t) const {
+	if (!table)
+		return -1;
 
-	SetRange(Point(start, end));
+	map<tuple<int, int, float>, int>::const_iterator entry = table->ids.find(make_tuple(t.GetSourceFrame(), t.GetDestinationFrame(), t.GetTransitionCost()));
+
+	return (entry != table->ids.end()) ? entry->second : -1;
+}
+
+bool CompoundLoop::ContainsTransitionId(int id) const {
+	return (id >= 0) && (size_t(id / 64) < members.size()) && (members[id / 64] & (1ULL << (id % 64)));
 }
 
 //--------------------------------------------------------------------------------------
@@ -177,23 +205,29 @@ void CompoundLoop::CalculateRange() {
 //--------------------------------------------------------------------------------------
 
 // Checks if two compound loops have overlapping ranges
-bool CompoundLoop::CheckIfOverlappingRanges(CompoundLoop c1, CompoundLoop c2) {
-	Point range1 = c1.GetRange();
-	Point range2 = c2.GetRange();
-
-	if ((range2.y - range1.x) * (range1.y - range2.x) >= 0)
-		return true;
-
-	return false;
+bool CompoundLoop::CheckIfOverlappingRanges(const CompoundLoop& c1, const CompoundLoop& c2) {
+	return CheckIfOverlappingRanges(c1.range, c2.range);
 }
 
 // Merges two compound loops into a new compound loop
-CompoundLoop CompoundLoop::MergeCompoundLoops(CompoundLoop c1, CompoundLoop c2) {
+CompoundLoop CompoundLoop::MergeCompoundLoops(const CompoundLoop& c1, const CompoundLoop& c2) {
 	CompoundLoop merged = c1;
 
-	for (Transition& t : c2.GetTransitions()) {
-		merged.AddTransition(t);
-	}
+	if (!merged.table)
+		merged.table = c2.table;
+
+	// Same table - ids are added directly, otherwise each transition is looked up (or added) in the merged loop's table
+	for (int id : c2.transitionIds)
+		merged.AddTransitionId((merged.table == c2.table) ? id : merged.GetTransitionId(c2.table->transitions[id]));
 
 	return merged;
-}
\ No newline at end of file
+}
+
+//--------------------------------------------------------------------------------------
+// Static Methods (Private)
+//--------------------------------------------------------------------------------------
+
+// Checks if two ranges (latest source frame, earliest destination frame) overlap
+bool CompoundLoop::CheckIfOverlappingRanges(Point range1, Point range2) {
+	return (long long)(range2.y - range1.x) * (range1.y - range2.x) >= 0;
+}
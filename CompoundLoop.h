@@ -1,12 +1,20 @@
 #pragma once
 #include "Transition.h"
 #include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <tuple>
 
 using namespace std;
 
 // CompoundLoop
 // - Representation of an unordered set of transitions
 // - Tracks total cost and overall range of all transitions (must ensure all transitions can fit within a single range)
+// - Transitions are held as ids into a transition table shared by a loop and every loop copied or derived from it (see
+//   RemoveAllTransitions), with a bitset of the ids it contains - membership tests and merges of loops sharing a table are bit operations
+// - Cost and range are updated as transitions are added rather than recalculated from every transition
+// - Loops sharing a table must not be extended from several threads at once (new transitions are added to the shared table)
 
 class CompoundLoop {
 	public:
@@ -15,33 +23,45 @@ class CompoundLoop {
 		CompoundLoop(Transition t);
 
 		// Getters & Setters
-		vector<Transition> GetTransitions();
-		int GetCost();
+		vector<Transition> GetTransitions() const;
+		int GetCost() const;
 		void SetCost(int c);
-		cv::Point GetRange();
+		cv::Point GetRange() const;
 		void SetRange(cv::Point r);
 
 		// Instance Methods
 		void AddTransition(Transition t);
 		vector<CompoundLoop> RemoveTransition(Transition t);
-		CompoundLoop RemoveAllTransitions();
-		int GetNumberOfTransitions();
-		Transition GetLatestTransition();
-		bool ContainsTransition(Transition t);
-		bool ContainsTransitions(CompoundLoop c);
+		CompoundLoop RemoveAllTransitions() const;
+		int GetNumberOfTransitions() const;
+		Transition GetLatestTransition() const;
+		bool ContainsTransition(Transition t) const;
+		bool ContainsTransitions(const CompoundLoop& c) const;
 
 		// Static Methods
-		static bool CheckIfOverlappingRanges(CompoundLoop c1, CompoundLoop c2);
-		static CompoundLoop MergeCompoundLoops(CompoundLoop c1, CompoundLoop c2);
+		static bool CheckIfOverlappingRanges(const CompoundLoop& c1, const CompoundLoop& c2);
+		static CompoundLoop MergeCompoundLoops(const CompoundLoop& c1, const CompoundLoop& c2);
 
 	private:
+		// Transitions referred to by id (ids are never reused, so they stay valid for every loop sharing the table)
+		struct TransitionTable {
+			vector<Transition> transitions;
+			map<tuple<int, int, float>, int> ids;
+		};
+
 		// Parameters
-		vector<Transition> transitions;
+		shared_ptr<TransitionTable> table;
+		vector<int> transitionIds;
+		vector<uint64_t> members;
 		int cost;
 		cv::Point range;
 
 		// Instance Methods
-		void CalculateCost();
-		void CalculateRange();
-};
+		void AddTransitionId(int id);
+		int GetTransitionId(Transition t);
+		int FindTransitionId(Transition t) const;
+		bool ContainsTransitionId(int id) const;
 
+		// Static Methods
+		static bool CheckIfOverlappingRanges(cv::Point range1, cv::Point range2);
+};
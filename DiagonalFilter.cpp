@@ -0,0 +1,208 @@
+#include "DiagonalFilter.h"
+#include "WorkStealingScheduler.h"
+#include <cstring>
+
+using namespace cv;
+using namespace std;
+
+//--------------------------------------------------------------------------------------
+// Static Methods (Public)
+//--------------------------------------------------------------------------------------
+
+// Filters distance matrix along its diagonals - returns (rows - T + 1) x (cols - T + 1) matrix (empty if the matrix is smaller than the window)
+Mat DiagonalFilter::Apply(Mat distanceMatrix, vector<float> weights, int threadCount) {
+	// Parameters:
+	// - distanceMatrix: float distance matrix (need not be square)
+	// - weights: filter taps w_0 ... w_(T-1) (see GetBoxWeights, GetBinomialWeights and GetGaussianWeights)
+	// - threadCount: number of threads (0 uses all cores)
+
+	int taps = int(weights.size());
+	int rows = distanceMatrix.rows - taps + 1;
+	int cols = distanceMatrix.cols - taps + 1;
+
+	if ((taps == 0) || (rows <= 0) || (cols <= 0))
+		return Mat();
+
+	if (distanceMatrix.type() != CV_32F)
+		distanceMatrix.convertTo(distanceMatrix, CV_32F);
+
+	Mat output(rows, cols, CV_32F);
+	int taskCount = (rows + ROWS_PER_TASK - 1) / ROWS_PER_TASK;
+
+	WorkStealingScheduler::Run(taskCount, [&](int t) {
+		for (int r = t * ROWS_PER_TASK; r < min((t + 1) * ROWS_PER_TASK, rows); r++)
+			FilterRow(distanceMatrix, weights, r, 0, cols, output.ptr<float>(r));
+	}, threadCount);
+
+	return output;
+}
+
+// Filters compact distance matrix along its diagonals - each task dequantises only the rows its window reads (ROWS_PER_TASK + T - 1)
+Mat DiagonalFilter::Apply(const CompactMatrix& distanceMatrix, vector<float> weights, int threadCount) {
+	// Parameters:
+	// - distanceMatrix: compact distance matrix (need not be square)
+	// - weights: filter taps w_0 ... w_(T-1)
+	// - threadCount: number of threads (0 uses all cores)
+
+	int taps = int(weights.size());
+	int rows = distanceMatrix.GetRows() - taps + 1;
+	int cols = distanceMatrix.GetCols() - taps + 1;
+
+	if ((taps == 0) || (rows <= 0) || (cols <= 0))
+		return Mat();
+
+	Mat output(rows, cols, CV_32F);
+	int taskCount = (rows + ROWS_PER_TASK - 1) / ROWS_PER_TASK;
+
+	WorkStealingScheduler::Run(taskCount, [&](int t) {
+		int rowStart = t * ROWS_PER_TASK;
+		int rowEnd = min(rowStart + ROWS_PER_TASK, rows);
+		Mat window = distanceMatrix.DecodeRows(rowStart, rowEnd + taps - 1);
+
+		for (int r = rowStart; r < rowEnd; r++)
+			FilterRow(window, weights, r - rowStart, 0, cols, output.ptr<float>(r));
+	}, threadCount);
+
+	return output;
+}
+
+// Filters a square distance matrix whose leading rows/columns are unchanged since previousOutput was filtered - output rows/columns
+// [0, firstRow) are copied from previousOutput, so only input rows firstRow ... n - 1 are needed (the rest of the output is filtered from
+// them and mirrored into the remaining columns, since the output is symmetric)
+Mat DiagonalFilter::ApplyIncremental(Mat distanceRows, int firstRow, const Mat& previousOutput, vector<float> weights, int threadCount) {
+	// Parameters:
+	// - distanceRows: rows firstRow ... n - 1 of the n x n float distance matrix
+	// - firstRow: first output row whose window reads a changed input frame (unchanged input frames - T + 1)
+	// - previousOutput: output of the same filter (same taps) for a matrix that shared the first firstRow + T - 1 rows/columns
+	// - weights: filter taps w_0 ... w_(T-1)
+	// - threadCount: number of threads (0 uses all cores)
+
+	int taps = int(weights.size());
+	int count = distanceRows.cols - taps + 1;
+
+	if ((taps == 0) || (count <= 0) || (firstRow < 0) || (firstRow > count) || (distanceRows.rows != distanceRows.cols - firstRow))
+		return Mat();
+
+	if (firstRow == 0)
+		return Apply(distanceRows, weights, threadCount);
+
+	if ((previousOutput.type() != CV_32F) || (previousOutput.rows < firstRow) || (previousOutput.cols < firstRow))
+		return Mat();
+
+	if (distanceRows.type() != CV_32F)
+		distanceRows.convertTo(distanceRows, CV_32F);
+
+	Mat output(count, count, CV_32F);
+
+	// 1. Changed rows, every column (output row r reads input rows r ... r + T - 1)
+	int changedTaskCount = (count - firstRow + ROWS_PER_TASK - 1) / ROWS_PER_TASK;
+
+	WorkStealingScheduler::Run(changedTaskCount, [&](int t) {
+		for (int r = firstRow + t * ROWS_PER_TASK; r < min(firstRow + (t + 1) * ROWS_PER_TASK, count); r++)
+			FilterRow(distanceRows, weights, r - firstRow, 0, count, output.ptr<float>(r));
+	}, threadCount);
+
+	// 2. Unchanged rows - previous values, then the changed columns (read from the changed rows)
+	int unchangedTaskCount = (firstRow + ROWS_PER_TASK - 1) / ROWS_PER_TASK;
+
+	WorkStealingScheduler::Run(unchangedTaskCount, [&](int t) {
+		for (int r = t * ROWS_PER_TASK; r < min((t + 1) * ROWS_PER_TASK, firstRow); r++) {
+			float* row = output.ptr<float>(r);
+			memcpy(row, previousOutput.ptr<float>(r), firstRow * sizeof(float));
+
+			for (int c = firstRow; c < count; c++)
+				row[c] = output.ptr<float>(c)[r];
+		}
+	}, threadCount);
+
+	return output;
+}
+
+// Returns 2m equal weights (the original motion filter)
+vector<float> DiagonalFilter::GetBoxWeights(int m) {
+	return vector<float>(max(2 * m, 0), 1.0f);
+}
+
+// Returns the 2m binomial coefficients C(2m - 1, k) (discrete approximation of a Gaussian)
+vector<float> DiagonalFilter::GetBinomialWeights(int m) {
+	vector<float> weights(max(2 * m, 0), 1.0f);
+
+	for (int k = 1; k < int(weights.size()); k++)
+		weights[k] = weights[k - 1] * float(int(weights.size()) - k) / float(k);
+
+	return weights;
+}
+
+// Returns 2m weights sampled from a Gaussian centred between the middle two taps (peak weight just below one)
+vector<float> DiagonalFilter::GetGaussianWeights(int m, double sigma) {
+	vector<float> weights(max(2 * m, 0));
+
+	for (int k = -m; k < m; k++) {
+		double offset = k + 0.5;
+		weights[k + m] = float(exp(-(offset * offset) / (2 * sigma * sigma)));
+	}
+
+	return weights;
+}
+
+// Computes output columns [colStart, colStart + cols) of one output row - the weighted sum of input rows r ... r + T - 1, each shifted left by its tap index
+void DiagonalFilter::FilterRow(Mat& distanceMatrix, vector<float>& weights, int row, int colStart, int cols, float* output) {
+	// Parameters:
+	// - distanceMatrix: input matrix (rows row ... row + T - 1 and columns colStart ... colStart + cols + T - 2 are read)
+	// - weights: filter taps
+	// - row: output row (first input row of the window)
+	// - colStart, cols: output columns to compute
+	// - output: receives the cols computed values
+
+	// Input row t is read from column colStart + t (its shift along the diagonal)
+	int taps = int(weights.size());
+	vector<const float*> shifted(taps);
+
+	for (int t = 0; t < taps; t++)
+		shifted[t] = distanceMatrix.ptr<float>(row + t) + colStart + t;
+
+	switch (taps) {
+		case 2: FilterRow<2>(shifted.data(), weights.data(), cols, output); return;
+		case 4: FilterRow<4>(shifted.data(), weights.data(), cols, output); return;
+		case 6: FilterRow<6>(shifted.data(), weights.data(), cols, output); return;
+		case 8: FilterRow<8>(shifted.data(), weights.data(), cols, output); return;
+	}
+
+	// Other window sizes - one contiguous pass per tap (no aliasing, so the compiler vectorises each pass)
+	float w0 = weights[0];
+
+	for (int c = 0; c < cols; c++)
+		output[c] = w0 * shifted[0][c];
+
+	for (int t = 1; t < taps; t++) {
+		const float* input = shifted[t];
+		float w = weights[t];
+
+		for (int c = 0; c < cols; c++)
+			output[c] += w * input[c];
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// Static Methods (Private)
+//--------------------------------------------------------------------------------------
+
+// Computes cols output values of a window of Taps shifted rows - the tap loop is unrolled, so each output is written once
+template<int Taps>
+void DiagonalFilter::FilterRow(const float* const* shifted, const float* weights, int cols, float* output) {
+	const float* input[Taps];
+	float w[Taps];
+
+	for (int t = 0; t < Taps; t++) {
+		input[t] = shifted[t];
+		w[t] = weights[t];
+	}
+
+	for (int c = 0; c < cols; c++) {
+		float sum = w[0] * input[0][c];
+		for (int t = 1; t < Taps; t++)
+			sum += w[t] * input[t][c];
+
+		output[c] = sum;
+	}
+}
\ No newline at end of file
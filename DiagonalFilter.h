@@ -0,0 +1,34 @@
+#pragma once
+#include "CompactMatrix.h"
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+using namespace std;
+
+// DiagonalFilter
+// - Filters a distance matrix along its diagonals: output(r, c) = sum_t w_t * input(r + t, c + t), t in [0, T) for T weights
+// - With T = 2m weights, output row/column r corresponds to frame r + m (frames without a full window are trimmed, so no copies are needed afterwards)
+// - Each output row is built from T contiguous, shifted input rows (equivalent to a 1D convolution along every diagonal), split across all cores
+// - Common window sizes (T = 2, 4, 6, 8) use kernels specialised on T, which sum every tap in registers in a single pass over the row
+// - Compact (half precision/quantised) matrices are dequantised on the fly, one window of rows per task
+// - When frames are appended to a video, only the output rows/columns whose window reaches a changed frame are filtered again (from
+//   just the input rows they read)
+
+class DiagonalFilter {
+	public:
+		// Static Methods
+		static cv::Mat Apply(cv::Mat distanceMatrix, vector<float> weights, int threadCount = 0);
+		static cv::Mat Apply(const CompactMatrix& distanceMatrix, vector<float> weights, int threadCount = 0);
+		static cv::Mat ApplyIncremental(cv::Mat distanceRows, int firstRow, const cv::Mat& previousOutput, vector<float> weights, int threadCount = 0);
+		static vector<float> GetBoxWeights(int m);
+		static vector<float> GetBinomialWeights(int m);
+		static vector<float> GetGaussianWeights(int m, double sigma);
+		static void FilterRow(cv::Mat& distanceMatrix, vector<float>& weights, int row, int colStart, int cols, float* output);
+
+	private:
+		// Static Parameters
+		static const int ROWS_PER_TASK = 16;
+
+		// Static Methods
+		template<int Taps> static void FilterRow(const float* const* shifted, const float* weights, int cols, float* output);
+};
@@ -0,0 +1,459 @@
+#include "DistanceKernel.h"
+#include "FrameDescriptor.h"
+#include "PixelDistance.h"
+#include "SparseSimilarityMatrix.h"
+#include "WorkStealingScheduler.h"
+#include <atomic>
+#include <cstring>
+#include <limits>
+
+using namespace cv;
+using namespace std;
+
+//--------------------------------------------------------------------------------------
+// Static Methods (Public)
+//--------------------------------------------------------------------------------------
+
+// Computes Euclidean distance between every pair of frames
+Mat DistanceKernel::ComputeEuclideanDistanceMatrix(FrameStore& frames, DistanceBackend backend, int threadCount) {
+	// Parameters:
+	// - frames: decoded frames to compare
+	// - backend: exact pairwise differences or the GEMM norm expansion
+	// - threadCount: number of workers (0 uses every core)
+
+	if (backend == DistanceBackend::GEMM)
+		return ComputeGEMMDistanceMatrix(frames, threadCount);
+
+	return ComputeExactDistanceMatrix(frames, threadCount);
+}
+
+// Computes Euclidean distance between every pair of frames, reusing the distances between the first unchangedFrameCount frames from a
+// previous matrix (only pairs involving a later frame are compared - the cost of n^2 - u^2 pairs rather than n^2)
+Mat DistanceKernel::ExtendEuclideanDistanceMatrix(FrameStore& frames, const Mat& previousDistanceMatrix, int unchangedFrameCount, int threadCount) {
+	// Parameters:
+	// - frames: decoded frames to compare (the first unchangedFrameCount are the frames previousDistanceMatrix was computed from)
+	// - previousDistanceMatrix: exact Euclidean distance matrix of the previous version of the video
+	// - unchangedFrameCount: number of leading frames that are unchanged (e.g. found by comparing FrameStore::GetFrameHashes)
+	// - threadCount: number of workers (0 uses every core)
+
+	int frameCount = frames.GetFrameCount();
+	int unchanged = min(unchangedFrameCount, min(frameCount, min(previousDistanceMatrix.rows, previousDistanceMatrix.cols)));
+
+	if ((unchanged <= 0) || (previousDistanceMatrix.type() != CV_32F))
+		return ComputeExactDistanceMatrix(frames, threadCount);
+
+	Mat distanceMatrix(frameCount, frameCount, CV_32F, Scalar(0));
+
+	// 1. Unchanged block
+	WorkStealingScheduler::Run(unchanged, [&](int i) {
+		memcpy(distanceMatrix.ptr<float>(i), previousDistanceMatrix.ptr<float>(i), unchanged * sizeof(float));
+	}, threadCount);
+
+	// 2. Tiles on or above the diagonal that hold any pair with a changed frame (column j >= unchanged, since i < j)
+	int tileSize = GetTileSize(frames.GetFrameStride());
+	int blockCount = (frameCount + tileSize - 1) / tileSize;
+
+	vector<Point> tiles;
+	for (int rowBlock = 0; rowBlock < blockCount; rowBlock++) {
+		for (int colBlock = max(rowBlock, unchanged / tileSize); colBlock < blockCount; colBlock++)
+			tiles.push_back(Point(colBlock, rowBlock));
+	}
+
+	WorkStealingScheduler::Run(int(tiles.size()), [&](int t) {
+		int rowStart = tiles[t].y * tileSize;
+		int colStart = tiles[t].x * tileSize;
+		ComputeTile(frames, distanceMatrix, rowStart, min(rowStart + tileSize, frameCount), colStart, min(colStart + tileSize, frameCount), unchanged);
+	}, threadCount);
+
+	return distanceMatrix;
+}
+
+// Computes the distance matrix at a coarse pyramid level, then re-evaluates only the best candidates of each row at full resolution
+Mat DistanceKernel::ComputeCoarseToFineDistanceMatrix(FrameStore& frames, FrameStore& coarseFrames, int candidatesPerRow, int bandHalfWidth, long long* fullComparisons, int threadCount) {
+	// Parameters:
+	// - frames: decoded frames at full resolution
+	// - coarseFrames: the same frames decoded at a small working height
+	// - candidatesPerRow: number of lowest-distance coarse pairs per row (K) re-evaluated at full resolution
+	// - bandHalfWidth: diagonal neighbours (i + k, j + k), k in [-m, m), of each candidate also evaluated (the motion filter's window)
+	// - fullComparisons: set to the number of full-resolution comparisons performed (optional)
+	// - threadCount: number of workers (0 uses every core)
+
+	int frameCount = frames.GetFrameCount();
+
+	// Fall back to exhaustive computation if the levels do not line up or there is nothing to save
+	if ((coarseFrames.GetFrameCount() != frameCount) || (candidatesPerRow <= 0) || (candidatesPerRow >= frameCount - 1)) {
+		if (fullComparisons != NULL)
+			*fullComparisons = (long long)(frameCount) * (frameCount - 1) / 2;
+		return ComputeExactDistanceMatrix(frames, threadCount);
+	}
+
+	// 1. Full matrix at the coarse level
+	Mat coarseDistanceMatrix = ComputeExactDistanceMatrix(coarseFrames, threadCount);
+
+	// 2. Top-K candidates per row and their diagonal neighbourhoods (symmetric, so each pair is kept once as i < j)
+	vector<vector<int>> candidates = SparseSimilarityMatrix::AddDiagonalBand(SelectCandidates(coarseDistanceMatrix, candidatesPerRow), bandHalfWidth);
+	vector<Point> pairs;
+
+	for (int i = 0; i < frameCount; i++) {
+		for (int j : candidates[i]) {
+			if (j != i)
+				pairs.push_back(Point(max(i, j), min(i, j)));
+		}
+	}
+
+	sort(pairs.begin(), pairs.end(), [](const Point& a, const Point& b) {
+		return (a.y < b.y) || ((a.y == b.y) && (a.x < b.x));
+	});
+	pairs.erase(unique(pairs.begin(), pairs.end(), [](const Point& a, const Point& b) {
+		return (a.x == b.x) && (a.y == b.y);
+	}), pairs.end());
+
+	// 3. Re-evaluate candidates at full resolution
+	vector<float> distances = ComputePairDistances(frames, pairs, threadCount);
+
+	// 4. Refined pairs in both triangles - every other pair is rejected (+inf, so it never becomes a transition)
+	Mat distanceMatrix(frameCount, frameCount, CV_32F, Scalar(numeric_limits<float>::infinity()));
+
+	for (int i = 0; i < frameCount; i++)
+		distanceMatrix.at<float>(i, i) = 0;
+
+	for (size_t p = 0; p < pairs.size(); p++) {
+		distanceMatrix.at<float>(pairs[p].y, pairs[p].x) = distances[p];
+		distanceMatrix.at<float>(pairs[p].x, pairs[p].y) = distances[p];
+	}
+
+	if (fullComparisons != NULL)
+		*fullComparisons = (long long)(pairs.size());
+
+	return distanceMatrix;
+}
+
+// Returns the columns of the lowest distances in each row (excluding the diagonal)
+vector<vector<int>> DistanceKernel::SelectCandidates(Mat distanceMatrix, int candidatesPerRow) {
+	int frameCount = distanceMatrix.rows;
+	vector<vector<int>> candidates(frameCount);
+
+	WorkStealingScheduler::Run(frameCount, [&](int i) {
+		const float* row = distanceMatrix.ptr<float>(i);
+		vector<int> columns;
+
+		for (int j = 0; j < distanceMatrix.cols; j++) {
+			if (j != i)
+				columns.push_back(j);
+		}
+
+		int count = min(candidatesPerRow, int(columns.size()));
+		partial_sort(columns.begin(), columns.begin() + count, columns.end(), [&](int a, int b) {
+			return row[a] < row[b];
+		});
+
+		candidates[i] = vector<int>(columns.begin(), columns.begin() + count);
+	});
+
+	return candidates;
+}
+
+// Returns the K lowest-distance earlier frames (j < i) of every frame - pairs are visited in order of their thumbnail lower bound, and
+// once K candidates are held, pairs whose bound (or partial distance) reaches the K-th best are rejected without a full comparison
+vector<vector<int>> DistanceKernel::SelectBackwardCandidates(FrameStore& frames, int candidatesPerRow, PrefilterStatistics* statistics, int threadCount) {
+	// Parameters:
+	// - frames: decoded frames to compare
+	// - candidatesPerRow: number of candidates kept per frame (K)
+	// - statistics: receives the number of pairs rejected, abandoned and compared in full (optional)
+	// - threadCount: number of workers (0 uses every core)
+
+	int frameCount = frames.GetFrameCount();
+	size_t frameBytes = frames.GetFrameBytes();
+	vector<vector<int>> candidates(frameCount);
+
+	if (statistics != NULL)
+		*statistics = PrefilterStatistics();
+
+	if ((frameCount == 0) || (candidatesPerRow <= 0))
+		return candidates;
+
+	Mat thumbnails = FrameDescriptor::ComputeBoundingThumbnails(frames, FrameDescriptor::DEFAULT_BOUNDING_GRID_SIZE, threadCount);
+	atomic<long long> thumbnailRejections(0), partialRejections(0), fullComparisons(0);
+
+	WorkStealingScheduler::Run(frameCount, [&](int i) {
+		// Closest thumbnails first, so the K-th best distance falls quickly
+		const float* thumbnail1 = thumbnails.ptr<float>(i);
+		vector<pair<double, int>> order(i);
+
+		for (int j = 0; j < i; j++)
+			order[j] = make_pair(FrameDescriptor::GetSquaredLowerBound(thumbnail1, thumbnails.ptr<float>(j), thumbnails.cols), j);
+
+		sort(order.begin(), order.end());
+
+		// Max-heap of (squared distance, frame) holding the best K seen so far
+		vector<pair<uint64_t, int>> best;
+		const uchar* frame1 = frames.GetFrameData(i);
+		long long rowPartialRejections = 0, rowFullComparisons = 0;
+
+		for (int k = 0; k < i; k++) {
+			bool full = (int(best.size()) == candidatesPerRow);
+			uint64_t bound = full ? best.front().first : UINT64_MAX;
+
+			// Bounds only increase from here, so every remaining pair is rejected (the margin absorbs float rounding in the bound)
+			if (full && (order[k].first * (1 - LOWER_BOUND_MARGIN) >= double(bound))) {
+				thumbnailRejections += i - k;
+				break;
+			}
+
+			uint64_t squaredDistance = PixelDistance::SquaredL2Bounded(frame1, frames.GetFrameData(order[k].second), frameBytes, bound);
+
+			if (squaredDistance >= bound) {
+				rowPartialRejections++;
+				continue;
+			}
+
+			rowFullComparisons++;
+
+			if (full)
+				pop_heap(best.begin(), best.end());
+			else
+				best.push_back(pair<uint64_t, int>());
+
+			best.back() = make_pair(squaredDistance, order[k].second);
+			push_heap(best.begin(), best.end());
+		}
+
+		partialRejections += rowPartialRejections;
+		fullComparisons += rowFullComparisons;
+
+		for (pair<uint64_t, int>& entry : best)
+			candidates[i].push_back(entry.second);
+	}, threadCount);
+
+	if (statistics != NULL) {
+		statistics->pairs = (long long)(frameCount) * (frameCount - 1) / 2;
+		statistics->thumbnailRejections = thumbnailRejections;
+		statistics->partialRejections = partialRejections;
+		statistics->fullComparisons = fullComparisons;
+	}
+
+	return candidates;
+}
+
+// Computes distances between a block of rows and a block of columns, returned as a (rowEnd - rowStart) x (colEnd - colStart) matrix (single-threaded)
+Mat DistanceKernel::ComputeDistanceBlock(FrameStore& frames, int rowStart, int rowEnd, int colStart, int colEnd) {
+	size_t frameBytes = frames.GetFrameBytes();
+	Mat block(max(rowEnd - rowStart, 0), max(colEnd - colStart, 0), CV_32F, Scalar(0));
+
+	for (int i = rowStart; i < rowEnd; i++) {
+		const uchar* frame1 = frames.GetFrameData(i);
+		float* output = block.ptr<float>(i - rowStart);
+
+		for (int j = colStart; j < colEnd; j++) {
+			if (i != j)
+				output[j - colStart] = float(sqrt(double(PixelDistance::SquaredL2(frame1, frames.GetFrameData(j), frameBytes))));
+		}
+	}
+
+	return block;
+}
+
+// Computes full-resolution distances for a list of frame pairs (x, y)
+vector<float> DistanceKernel::ComputePairDistances(FrameStore& frames, vector<Point>& pairs, int threadCount) {
+	vector<float> distances(pairs.size());
+	size_t frameBytes = frames.GetFrameBytes();
+	int taskCount = int((pairs.size() + PAIRS_PER_TASK - 1) / PAIRS_PER_TASK);
+
+	WorkStealingScheduler::Run(taskCount, [&](int t) {
+		size_t end = min(pairs.size(), size_t(t + 1) * PAIRS_PER_TASK);
+		for (size_t p = size_t(t) * PAIRS_PER_TASK; p < end; p++) {
+			uint64_t squaredDistance = PixelDistance::SquaredL2(frames.GetFrameData(pairs[p].x), frames.GetFrameData(pairs[p].y), frameBytes);
+			distances[p] = float(sqrt(double(squaredDistance)));
+		}
+	}, threadCount);
+
+	return distances;
+}
+
+// Counts rows whose lowest off-diagonal distance is in the same column in both matrices (used to verify approximate matrices)
+int DistanceKernel::CountMatchingRowMinima(Mat reference, Mat candidate) {
+	if (reference.size() != candidate.size())
+		return 0;
+
+	int matching = 0;
+
+	for (int i = 0; i < reference.rows; i++) {
+		int referenceColumn = -1, candidateColumn = -1;
+		float referenceLowest = FLT_MAX, candidateLowest = FLT_MAX;
+
+		for (int j = 0; j < reference.cols; j++) {
+			if (j == i)
+				continue;
+			if (reference.at<float>(i, j) < referenceLowest) {
+				referenceLowest = reference.at<float>(i, j);
+				referenceColumn = j;
+			}
+			if (candidate.at<float>(i, j) < candidateLowest) {
+				candidateLowest = candidate.at<float>(i, j);
+				candidateColumn = j;
+			}
+		}
+
+		if (referenceColumn == candidateColumn)
+			matching++;
+	}
+
+	return matching;
+}
+
+// Returns largest absolute difference between two distance matrices, relative to the largest reference distance
+double DistanceKernel::GetMaximumRelativeError(Mat reference, Mat candidate) {
+	if ((reference.size() != candidate.size()) || reference.empty())
+		return DBL_MAX;
+
+	double largest = norm(reference, NORM_INF);
+	double difference = norm(reference, candidate, NORM_INF);
+
+	return (largest > 0) ? (difference / largest) : difference;
+}
+
+// Checks that a distance matrix matches the reference (e.g. the exact backend) to within a relative tolerance
+bool DistanceKernel::CheckTolerance(Mat reference, Mat candidate, double tolerance) {
+	return (GetMaximumRelativeError(reference, candidate) <= tolerance);
+}
+
+// Returns number of frames per block such that two blocks fit in L2 cache
+int DistanceKernel::GetTileSize(size_t frameBytes) {
+	if (frameBytes == 0)
+		return 1;
+
+	return max(int(L2_CACHE_BYTES / (2 * frameBytes)), 1);
+}
+
+//--------------------------------------------------------------------------------------
+// Static Methods (Private)
+//--------------------------------------------------------------------------------------
+
+// Computes the distance matrix from pairwise frame differences
+Mat DistanceKernel::ComputeExactDistanceMatrix(FrameStore& frames, int threadCount) {
+	int frameCount = frames.GetFrameCount();
+	Mat distanceMatrix(frameCount, frameCount, CV_32F, Scalar(0));
+
+	if (frameCount == 0)
+		return distanceMatrix;
+
+	// Split frames into blocks such that the frames of two blocks fit in L2 together
+	int tileSize = GetTileSize(frames.GetFrameStride());
+	int blockCount = (frameCount + tileSize - 1) / tileSize;
+
+	// Only tiles on or above the diagonal are computed (ordered by row so that neighbouring tasks share a block)
+	vector<Point> tiles;
+	for (int rowBlock = 0; rowBlock < blockCount; rowBlock++) {
+		for (int colBlock = rowBlock; colBlock < blockCount; colBlock++)
+			tiles.push_back(Point(colBlock, rowBlock));
+	}
+
+	WorkStealingScheduler::Run(int(tiles.size()), [&](int t) {
+		int rowStart = tiles[t].y * tileSize;
+		int colStart = tiles[t].x * tileSize;
+		ComputeTile(frames, distanceMatrix, rowStart, min(rowStart + tileSize, frameCount), colStart, min(colStart + tileSize, frameCount));
+	}, threadCount);
+
+	return distanceMatrix;
+}
+
+// Computes the distance matrix as ||a||^2 + ||b||^2 - 2ab, where the cross terms come from a blocked matrix multiply
+Mat DistanceKernel::ComputeGEMMDistanceMatrix(FrameStore& frames, int threadCount) {
+	// The frame store already holds the frames as a row matrix (one frame per row), so blocks are taken directly from it
+
+	int frameCount = frames.GetFrameCount();
+	Mat distanceMatrix(frameCount, frameCount, CV_32F, Scalar(0));
+
+	if (frameCount == 0)
+		return distanceMatrix;
+
+	// Squared norm of each frame (integer accumulation, so exact)
+	size_t frameBytes = frames.GetFrameBytes();
+	vector<double> squaredNorms(frameCount);
+
+	WorkStealingScheduler::Run(frameCount, [&](int i) {
+		const uchar* frame = frames.GetFrameData(i);
+		uint64_t total = 0;
+		for (size_t k = 0; k < frameBytes; k++)
+			total += uint64_t(frame[k]) * frame[k];
+		squaredNorms[i] = double(total);
+	}, threadCount);
+
+	// Blocks on or above the diagonal
+	int blockCount = (frameCount + GEMM_BLOCK_FRAMES - 1) / GEMM_BLOCK_FRAMES;
+
+	vector<Point> blocks;
+	for (int rowBlock = 0; rowBlock < blockCount; rowBlock++) {
+		for (int colBlock = rowBlock; colBlock < blockCount; colBlock++)
+			blocks.push_back(Point(colBlock, rowBlock));
+	}
+
+	WorkStealingScheduler::Run(int(blocks.size()), [&](int b) {
+		int rowStart = blocks[b].y * GEMM_BLOCK_FRAMES;
+		int colStart = blocks[b].x * GEMM_BLOCK_FRAMES;
+		ComputeGEMMTile(frames, distanceMatrix, squaredNorms, rowStart, min(rowStart + GEMM_BLOCK_FRAMES, frameCount), colStart, min(colStart + GEMM_BLOCK_FRAMES, frameCount));
+	}, threadCount);
+
+	return distanceMatrix;
+}
+
+// Computes distances between a block of rows and a block of columns, mirroring each result below the diagonal
+void DistanceKernel::ComputeTile(FrameStore& frames, Mat& distanceMatrix, int rowStart, int rowEnd, int colStart, int colEnd, int firstChangedFrame) {
+	size_t frameBytes = frames.GetFrameBytes();
+
+	for (int i = rowStart; i < rowEnd; i++) {
+		const uchar* frame1 = frames.GetFrameData(i);
+
+		// Diagonal tiles only compute the strictly upper part (and pairs of unchanged frames are skipped when extending a matrix)
+		for (int j = max(max(colStart, i + 1), firstChangedFrame); j < colEnd; j++) {
+			const uchar* frame2 = frames.GetFrameData(j);
+			float distance = float(sqrt(double(PixelDistance::SquaredL2(frame1, frame2, frameBytes))));
+
+			distanceMatrix.at<float>(i, j) = distance;
+			distanceMatrix.at<float>(j, i) = distance;
+		}
+	}
+}
+
+// Computes distances between two blocks of frames via the norm expansion
+void DistanceKernel::ComputeGEMMTile(FrameStore& frames, Mat& distanceMatrix, vector<double>& squaredNorms, int rowStart, int rowEnd, int colStart, int colEnd) {
+	int frameBytes = int(frames.GetFrameBytes());
+	Mat crossTerms(rowEnd - rowStart, colEnd - colStart, CV_64F, Scalar(0));
+	Mat rowChunk, colChunk, chunkProduct;
+
+	// Multiply in chunks of GEMM_CHUNK_BYTES pixels: each chunk's dot products are integers below 2^24, so the float
+	// multiply is exact, and the running total across chunks is accumulated in float64
+	for (int offset = 0; offset < frameBytes; offset += GEMM_CHUNK_BYTES) {
+		int width = min(GEMM_CHUNK_BYTES, frameBytes - offset);
+
+		GetFrameChunk(frames, rowStart, rowEnd, offset, width).convertTo(rowChunk, CV_32F);
+		GetFrameChunk(frames, colStart, colEnd, offset, width).convertTo(colChunk, CV_32F);
+
+		gemm(rowChunk, colChunk, 1, noArray(), 0, chunkProduct, GEMM_2_T);
+
+		for (int i = 0; i < crossTerms.rows; i++) {
+			double* total = crossTerms.ptr<double>(i);
+			const float* product = chunkProduct.ptr<float>(i);
+			for (int j = 0; j < crossTerms.cols; j++)
+				total[j] += product[j];
+		}
+	}
+
+	// Combine with the norms (clamped, since rounding must never produce a negative squared distance)
+	for (int i = rowStart; i < rowEnd; i++) {
+		const double* total = crossTerms.ptr<double>(i - rowStart);
+		for (int j = max(colStart, i + 1); j < colEnd; j++) {
+			double squaredDistance = squaredNorms[i] + squaredNorms[j] - (2 * total[j - colStart]);
+			float distance = float(sqrt(max(squaredDistance, 0.0)));
+
+			distanceMatrix.at<float>(i, j) = distance;
+			distanceMatrix.at<float>(j, i) = distance;
+		}
+	}
+}
+
+// Returns a view of pixels [offset, offset + width) for frames [start, end) of the store (one frame per row)
+Mat DistanceKernel::GetFrameChunk(FrameStore& frames, int start, int end, int offset, int width) {
+	uchar* data = const_cast<uchar*>(frames.GetFrameData(start)) + offset;
+	return Mat(end - start, width, CV_8U, data, frames.GetFrameStride());
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include "FrameStore.h"
+#include <opencv2/opencv.hpp>
+
+using namespace std;
+
+// Backends available for computing the Euclidean distance matrix
+enum class DistanceBackend {
+	Exact,	// Pairwise frame differences
+	GEMM	// Norm expansion ||a||^2 + ||b||^2 - 2ab with a blocked matrix multiply
+};
+
+// Work done selecting candidates (each pair is either rejected on its thumbnails, abandoned part way, or compared in full)
+struct PrefilterStatistics {
+	long long pairs = 0;				// Frame pairs considered
+	long long thumbnailRejections = 0;	// Pairs rejected on their bounding thumbnails (no pixels compared)
+	long long partialRejections = 0;	// Pairs abandoned once their partial distance passed the row's K-th best
+	long long fullComparisons = 0;		// Pairs compared in full
+};
+
+// DistanceKernel
+// - Computes the Euclidean distance matrix between all frames of a frame store
+// - The matrix is symmetric with a zero diagonal, so only the upper triangle is computed (in cache-sized tiles, across all cores) and then mirrored
+// - A matrix can be extended after frames are appended (or the video is trimmed), computing only the pairs involving a changed frame
+// - Candidate selection visits pairs in order of a thumbnail lower bound, skipping pairs whose bound (or partial distance) already
+//   exceeds the K-th best distance found so far - the K best are still exact
+// - Coarse-to-fine matrices hold exact distances for each row's coarse candidates (and their diagonal neighbourhoods, so the motion
+//   filter sees whole windows) - every other pair is +inf, like the prefiltered matrix, rather than an estimate
+
+class DistanceKernel {
+	public:
+		// Static Methods
+		static cv::Mat ComputeEuclideanDistanceMatrix(FrameStore& frames, DistanceBackend backend = DistanceBackend::Exact, int threadCount = 0);
+		static cv::Mat ExtendEuclideanDistanceMatrix(FrameStore& frames, const cv::Mat& previousDistanceMatrix, int unchangedFrameCount, int threadCount = 0);
+		static cv::Mat ComputeCoarseToFineDistanceMatrix(FrameStore& frames, FrameStore& coarseFrames, int candidatesPerRow, int bandHalfWidth = 0, long long* fullComparisons = NULL, int threadCount = 0);
+		static vector<vector<int>> SelectCandidates(cv::Mat distanceMatrix, int candidatesPerRow);
+		static vector<vector<int>> SelectBackwardCandidates(FrameStore& frames, int candidatesPerRow, PrefilterStatistics* statistics = NULL, int threadCount = 0);
+		static int GetTileSize(size_t frameBytes);
+		static cv::Mat ComputeDistanceBlock(FrameStore& frames, int rowStart, int rowEnd, int colStart, int colEnd);
+		static vector<float> ComputePairDistances(FrameStore& frames, vector<cv::Point>& pairs, int threadCount = 0);
+		static int CountMatchingRowMinima(cv::Mat reference, cv::Mat candidate);
+		static double GetMaximumRelativeError(cv::Mat reference, cv::Mat candidate);
+		static bool CheckTolerance(cv::Mat reference, cv::Mat candidate, double tolerance);
+
+	private:
+		// Static Parameters
+		static const size_t L2_CACHE_BYTES = 1024 * 1024;
+		static const int GEMM_BLOCK_FRAMES = 128;
+		static const int GEMM_CHUNK_BYTES = 256;
+		static const int PAIRS_PER_TASK = 256;
+		static constexpr double LOWER_BOUND_MARGIN = 1e-4;
+
+		// Static Methods
+		static cv::Mat ComputeExactDistanceMatrix(FrameStore& frames, int threadCount);
+		static cv::Mat ComputeGEMMDistanceMatrix(FrameStore& frames, int threadCount);
+		static void ComputeTile(FrameStore& frames, cv::Mat& distanceMatrix, int rowStart, int rowEnd, int colStart, int colEnd, int firstChangedFrame = 0);
+		static void ComputeGEMMTile(FrameStore& frames, cv::Mat& distanceMatrix, vector<double>& squaredNorms, int rowStart, int rowEnd, int colStart, int colEnd);
+		static cv::Mat GetFrameChunk(FrameStore& frames, int start, int end, int offset, int width);
+};
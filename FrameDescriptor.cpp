@@ -0,0 +1,200 @@
+#include "FrameDescriptor.h"
+#include "WorkStealingScheduler.h"
+#include <numeric>
+
+using namespace cv;
+using namespace std;
+
+//--------------------------------------------------------------------------------------
+// Static Methods (Public)
+//--------------------------------------------------------------------------------------
+
+// Computes a descriptor for every frame (one descriptor per row)
+Mat FrameDescriptor::ComputeDescriptors(FrameStore& frames, int thumbnailHeight, int dimensions) {
+	// Parameters:
+	// - frames: decoded frames
+	// - thumbnailHeight: height of the area-downsampled thumbnail (aspect ratio is maintained)
+	// - dimensions: number of principal components to keep (0 keeps the thumbnail as it is)
+
+	int frameCount = frames.GetFrameCount();
+	if ((frameCount == 0) || (thumbnailHeight <= 0))
+		return Mat();
+
+	Size frameSize = frames.GetFrameSize();
+	int height = min(thumbnailHeight, frameSize.height);
+	int width = max(1, int(double(frameSize.width) * height / frameSize.height));
+	int channels = CV_MAT_CN(frames.GetFrameType());
+
+	// 1. Area-downsample each frame into a row of the descriptor matrix
+	Mat thumbnails(frameCount, width * height * channels, CV_32F);
+
+	WorkStealingScheduler::Run(frameCount, [&](int i) {
+		Mat thumbnail;
+		resize(frames.GetFrame(i), thumbnail, Size(width, height), 0, 0, INTER_AREA);
+		thumbnail.reshape(1, 1).convertTo(thumbnails.row(i), CV_32F);
+	});
+
+	if ((dimensions <= 0) || (dimensions >= thumbnails.cols))
+		return thumbnails;
+
+	// 2. Project onto the principal components of the clip
+	PCA pca(thumbnails, noArray(), PCA::DATA_AS_ROW, min(dimensions, frameCount));
+	return pca.project(thumbnails);
+}
+
+// Computes Euclidean distance between every pair of descriptors
+Mat FrameDescriptor::ComputeDistanceMatrix(Mat descriptors, int threadCount) {
+	int frameCount = descriptors.rows;
+	Mat distanceMatrix(frameCount, frameCount, CV_32F, Scalar(0));
+
+	// Upper triangle only (one row per task), mirrored below the diagonal
+	WorkStealingScheduler::Run(frameCount, [&](int i) {
+		Mat descriptor1 = descriptors.row(i);
+		for (int j = i + 1; j < frameCount; j++) {
+			float distance = float(norm(descriptor1, descriptors.row(j), NORM_L2));
+			distanceMatrix.at<float>(i, j) = distance;
+			distanceMatrix.at<float>(j, i) = distance;
+		}
+	}, threadCount);
+
+	return distanceMatrix;
+}
+
+// Computes a bounding thumbnail for every frame (one per row) - gridSize x gridSize blocks per channel, each holding the block's pixel
+// sum divided by the square root of its pixel count
+Mat FrameDescriptor::ComputeBoundingThumbnails(FrameStore& frames, int gridSize, int threadCount) {
+	// Parameters:
+	// - frames: decoded frames
+	// - gridSize: number of blocks along each side (a finer grid gives a tighter bound but costs more per comparison)
+	// - threadCount: number of threads (0 uses all cores)
+
+	int frameCount = frames.GetFrameCount();
+	Size frameSize = frames.GetFrameSize();
+	int channels = CV_MAT_CN(frames.GetFrameType());
+	int grid = min(gridSize, min(frameSize.width, frameSize.height));
+
+	if ((frameCount == 0) || (grid <= 0))
+		return Mat();
+
+	// Block of every pixel column and row (blocks differ in size by at most one pixel), and the scale of every block
+	vector<int> columnBlocks(frameSize.width), rowBlocks(frameSize.height);
+	for (int x = 0; x < frameSize.width; x++)
+		columnBlocks[x] = int((long long)(x) * grid / frameSize.width);
+	for (int y = 0; y < frameSize.height; y++)
+		rowBlocks[y] = int((long long)(y) * grid / frameSize.height);
+
+	vector<double> pixelCounts(grid * grid, 0);
+	for (int y = 0; y < frameSize.height; y++) {
+		for (int x = 0; x < frameSize.width; x++)
+			pixelCounts[rowBlocks[y] * grid + columnBlocks[x]]++;
+	}
+
+	Mat thumbnails(frameCount, grid * grid * channels, CV_32F);
+
+	WorkStealingScheduler::Run(frameCount, [&](int i) {
+		Mat frame = frames.GetFrame(i);
+		vector<uint64_t> sums(grid * grid * channels, 0);
+
+		for (int y = 0; y < frameSize.height; y++) {
+			const uchar* pixels = frame.ptr<uchar>(y);
+			uint64_t* blockRow = sums.data() + size_t(rowBlocks[y]) * grid * channels;
+
+			for (int x = 0; x < frameSize.width; x++) {
+				uint64_t* block = blockRow + columnBlocks[x] * channels;
+				for (int c = 0; c < channels; c++)
+					block[c] += pixels[x * channels + c];
+			}
+		}
+
+		float* thumbnail = thumbnails.ptr<float>(i);
+		for (int b = 0; b < grid * grid; b++) {
+			for (int c = 0; c < channels; c++)
+				thumbnail[b * channels + c] = float(double(sums[b * channels + c]) / sqrt(pixelCounts[b]));
+		}
+	}, threadCount);
+
+	return thumbnails;
+}
+
+// Returns a lower bound on the squared Euclidean distance between the frames two bounding thumbnails were computed from
+double FrameDescriptor::GetSquaredLowerBound(const float* thumbnail1, const float* thumbnail2, int length) {
+	double total = 0;
+
+	for (int k = 0; k < length; k++) {
+		double difference = double(thumbnail1[k]) - thumbnail2[k];
+		total += difference * difference;
+	}
+
+	return total;
+}
+
+// Computes Spearman rank correlation between two distance matrices (1 means the approximation orders every pair identically)
+double FrameDescriptor::GetRankCorrelation(Mat exactDistanceMatrix, Mat approximateDistanceMatrix) {
+	if ((exactDistanceMatrix.size() != approximateDistanceMatrix.size()) || (exactDistanceMatrix.rows < 3))
+		return 0;
+
+	vector<double> exactRanks = GetRanks(GetUpperTriangle(exactDistanceMatrix));
+	vector<double> approximateRanks = GetRanks(GetUpperTriangle(approximateDistanceMatrix));
+
+	// Pearson correlation of the ranks (handles ties correctly)
+	double count = double(exactRanks.size());
+	double exactMean = accumulate(exactRanks.begin(), exactRanks.end(), 0.0) / count;
+	double approximateMean = accumulate(approximateRanks.begin(), approximateRanks.end(), 0.0) / count;
+
+	double covariance = 0, exactVariance = 0, approximateVariance = 0;
+	for (size_t k = 0; k < exactRanks.size(); k++) {
+		double a = exactRanks[k] - exactMean;
+		double b = approximateRanks[k] - approximateMean;
+		covariance += a * b;
+		exactVariance += a * a;
+		approximateVariance += b * b;
+	}
+
+	if ((exactVariance == 0) || (approximateVariance == 0))
+		return 0;
+
+	return covariance / sqrt(exactVariance * approximateVariance);
+}
+
+//--------------------------------------------------------------------------------------
+// Static Methods (Private)
+//--------------------------------------------------------------------------------------
+
+// Returns the entries above the diagonal (each frame pair once)
+vector<double> FrameDescriptor::GetUpperTriangle(Mat matrix) {
+	vector<double> values;
+	values.reserve(size_t(matrix.rows) * (matrix.rows - 1) / 2);
+
+	for (int i = 0; i < matrix.rows; i++) {
+		const float* row = matrix.ptr<float>(i);
+		for (int j = i + 1; j < matrix.cols; j++)
+			values.push_back(row[j]);
+	}
+
+	return values;
+}
+
+// Converts values into ranks (tied values share their average rank)
+vector<double> FrameDescriptor::GetRanks(vector<double> values) {
+	vector<size_t> order(values.size());
+	iota(order.begin(), order.end(), 0);
+	sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+		return values[a] < values[b];
+	});
+
+	vector<double> ranks(values.size());
+	size_t start = 0;
+	while (start < order.size()) {
+		size_t end = start + 1;
+		while ((end < order.size()) && (values[order[end]] == values[order[start]]))
+			end++;
+
+		double averageRank = (start + end - 1) / 2.0;
+		for (size_t k = start; k < end; k++)
+			ranks[order[k]] = averageRank;
+
+		start = end;
+	}
+
+	return ranks;
+}
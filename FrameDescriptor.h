@@ -0,0 +1,29 @@
+#pragma once
+#include "FrameStore.h"
+#include <opencv2/opencv.hpp>
+
+using namespace std;
+
+// FrameDescriptor
+// - Reduces each frame to a compact vector (area-downsampled thumbnail, optionally PCA-projected to k dimensions learned from the clip)
+// - Distances between descriptors approximate the Euclidean distances between the full-resolution frames
+// - Bounding thumbnails hold block sums scaled by 1 / sqrt(block size), so their squared distance never exceeds the squared distance
+//   between the full-resolution frames (Cauchy-Schwarz) - pairs can be rejected on the thumbnails alone without losing exactness
+
+class FrameDescriptor {
+	public:
+		// Static Methods
+		static cv::Mat ComputeDescriptors(FrameStore& frames, int thumbnailHeight, int dimensions = 0);
+		static cv::Mat ComputeDistanceMatrix(cv::Mat descriptors, int threadCount = 0);
+		static cv::Mat ComputeBoundingThumbnails(FrameStore& frames, int gridSize = DEFAULT_BOUNDING_GRID_SIZE, int threadCount = 0);
+		static double GetSquaredLowerBound(const float* thumbnail1, const float* thumbnail2, int length);
+		static double GetRankCorrelation(cv::Mat exactDistanceMatrix, cv::Mat approximateDistanceMatrix);
+
+		// Static Parameters
+		static const int DEFAULT_BOUNDING_GRID_SIZE = 16;
+
+	private:
+		// Static Methods
+		static vector<double> GetUpperTriangle(cv::Mat matrix);
+		static vector<double> GetRanks(vector<double> values);
+};
@@ -0,0 +1,215 @@
+#include "FrameMask.h"
+#include "MatrixFile.h"
+#include "WorkStealingScheduler.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace cv;
+using namespace std;
+
+//--------------------------------------------------------------------------------------
+// Constructors
+//--------------------------------------------------------------------------------------
+
+// Default constructor - creates an empty mask (nothing is active)
+FrameMask::FrameMask() {}
+
+// Creates a mask from a weight image (8-bit images map 0 ... 255 onto 0 ... 1, colour images are converted to greyscale)
+FrameMask::FrameMask(Mat weights) {
+	// Parameters:
+	// - weights: weight of every pixel (any size - rescaled to the frames it is applied to)
+
+	if (weights.empty())
+		return;
+
+	Mat grey = weights;
+	if (grey.channels() == 3)
+		cvtColor(grey, grey, COLOR_BGR2GRAY);
+
+	grey.convertTo(this->weights, CV_32F, (grey.depth() == CV_8U) ? (1.0 / 255) : 1.0);
+
+	// Weights are clamped to [0, 1] (continuous, so the checksum covers exactly the weights)
+	this->weights = this->weights.clone();
+
+	for (int y = 0; y < this->weights.rows; y++) {
+		float* row = this->weights.ptr<float>(y);
+		for (int x = 0; x < this->weights.cols; x++)
+			row[x] = min(max(row[x], 0.0f), 1.0f);
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// Getters & Setters
+//--------------------------------------------------------------------------------------
+
+Mat FrameMask::GetWeights() const {
+	return weights;
+}
+
+Size FrameMask::GetSize() const {
+	return weights.size();
+}
+
+//--------------------------------------------------------------------------------------
+// Instance Methods (Public)
+//--------------------------------------------------------------------------------------
+
+bool FrameMask::IsEmpty() const {
+	return weights.empty();
+}
+
+// Returns the fraction of pixels that are compared
+double FrameMask::GetActiveFraction() const {
+	if (weights.empty())
+		return 0;
+
+	size_t active = 0;
+	for (int y = 0; y < weights.rows; y++) {
+		const float* row = weights.ptr<float>(y);
+		for (int x = 0; x < weights.cols; x++)
+			active += (row[x] >= MIN_WEIGHT) ? 1 : 0;
+	}
+
+	return double(active) / weights.total();
+}
+
+// Returns a hash of the weights (identifies the mask in similarity cache keys)
+uint64_t FrameMask::GetChecksum() const {
+	if (weights.empty())
+		return 0;
+
+	uint64_t size[2] = { uint64_t(weights.cols), uint64_t(weights.rows) };
+	uint64_t checksum = MatrixFile::ComputeChecksum(reinterpret_cast<const unsigned char*>(size), sizeof(size));
+
+	return MatrixFile::ComputeChecksum(weights.data, weights.total() * weights.elemSize(), checksum);
+}
+
+// Returns the active bytes of a frame as runs of consecutive bytes with the same weight, in raster order
+vector<GatherRun> FrameMask::GetGatherRuns(Size frameSize, int channels) const {
+	// Parameters:
+	// - frameSize: size of the frames the mask is applied to (the weights are area-resampled if the sizes differ)
+	// - channels: channels per pixel (every channel of an active pixel is gathered)
+
+	vector<GatherRun> runs;
+
+	if (weights.empty() || frameSize.empty())
+		return runs;
+
+	Mat frameWeights = weights;
+	if (frameWeights.size() != frameSize)
+		resize(weights, frameWeights, frameSize, 0, 0, INTER_AREA);
+
+	for (int y = 0; y < frameSize.height; y++) {
+		const float* row = frameWeights.ptr<float>(y);
+
+		for (int x = 0; x < frameSize.width; x++) {
+			if (row[x] < MIN_WEIGHT)
+				continue;
+
+			float scale = (row[x] >= 1) ? 1.0f : sqrt(row[x]);
+			int offset = (y * frameSize.width + x) * channels;
+
+			// Extend the previous run if this pixel follows it with the same weight (e.g. a row of a region of interest)
+			if (!runs.empty() && (runs.back().scale == scale) && (runs.back().sourceOffset + runs.back().length == offset))
+				runs.back().length += channels;
+			else
+				runs.push_back({ offset, channels, scale });
+		}
+	}
+
+	return runs;
+}
+
+//--------------------------------------------------------------------------------------
+// Static Methods (Public)
+//--------------------------------------------------------------------------------------
+
+// Creates a mask that compares only the pixels inside a rectangle
+FrameMask FrameMask::FromRegion(Size frameSize, Rect region) {
+	// Parameters:
+	// - frameSize: size of the frames the region is given in (e.g. the source resolution of the video)
+	// - region: region of interest (clipped to the frame)
+
+	Mat weights(frameSize, CV_32F, Scalar(0));
+	Rect clipped = region & Rect(0, 0, frameSize.width, frameSize.height);
+
+	if (clipped.area() > 0)
+		weights(clipped).setTo(Scalar(1));
+
+	return FrameMask(weights);
+}
+
+// Loads a mask from an image file (black pixels are ignored, white pixels have full weight) - returns an empty mask if the file is invalid
+FrameMask FrameMask::FromImage(string filePath) {
+	return FrameMask(imread(filePath, IMREAD_GRAYSCALE));
+}
+
+// Creates a mask of the pixels with the most temporal variance (the parts of the shot that move)
+FrameMask FrameMask::FromMotionEnergy(FrameStore& frames, double activeFraction, int sampleCount) {
+	// Parameters:
+	// - frames: decoded frames (the mask is created at their size)
+	// - activeFraction: fraction of pixels kept (those with the highest variance - static pixels are never kept)
+	// - sampleCount: number of frames (evenly spaced) the variance is estimated from
+
+	int frameCount = frames.GetFrameCount();
+	Size frameSize = frames.GetFrameSize();
+	int channels = CV_MAT_CN(frames.GetFrameType());
+
+	if ((frameCount < 2) || (activeFraction <= 0))
+		return FrameMask();
+
+	int step = max(1, frameCount / max(sampleCount, 2));
+	vector<int> samples;
+	for (int i = 0; i < frameCount; i += step)
+		samples.push_back(i);
+
+	// 1. Variance of every pixel over the sampled frames (summed over channels), one image row per task
+	Mat energy(frameSize, CV_32F);
+
+	WorkStealingScheduler::Run(frameSize.height, [&](int y) {
+		int rowBytes = frameSize.width * channels;
+		vector<double> sums(rowBytes, 0), squaredSums(rowBytes, 0);
+
+		for (int i : samples) {
+			const uchar* pixels = frames.GetFrameData(i) + size_t(y) * rowBytes;
+			for (int k = 0; k < rowBytes; k++) {
+				sums[k] += pixels[k];
+				squaredSums[k] += double(pixels[k]) * pixels[k];
+			}
+		}
+
+		float* row = energy.ptr<float>(y);
+		for (int x = 0; x < frameSize.width; x++) {
+			double variance = 0;
+			for (int c = 0; c < channels; c++) {
+				double mean = sums[x * channels + c] / samples.size();
+				variance += squaredSums[x * channels + c] / samples.size() - mean * mean;
+			}
+
+			row[x] = float(max(variance, 0.0));
+		}
+	});
+
+	// 2. Keep the pixels above the (1 - activeFraction) quantile
+	vector<float> values;
+	values.reserve(energy.total());
+
+	for (int y = 0; y < frameSize.height; y++)
+		values.insert(values.end(), energy.ptr<float>(y), energy.ptr<float>(y) + frameSize.width);
+
+	size_t rank = size_t((1 - min(activeFraction, 1.0)) * (values.size() - 1));
+	nth_element(values.begin(), values.begin() + rank, values.end());
+
+	float threshold = values[rank];
+	Mat weights(frameSize, CV_32F, Scalar(0));
+
+	for (int y = 0; y < frameSize.height; y++) {
+		const float* row = energy.ptr<float>(y);
+		float* output = weights.ptr<float>(y);
+
+		for (int x = 0; x < frameSize.width; x++)
+			output[x] = ((row[x] >= threshold) && (row[x] > 0)) ? 1.0f : 0.0f;
+	}
+
+	return FrameMask(weights);
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include "FrameStore.h"
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Run of consecutive bytes of a frame that are gathered with the same weight
+struct GatherRun {
+	int sourceOffset;	// First byte in the source frame
+	int length;			// Number of bytes
+	float scale;		// Square root of the weight (1 copies the bytes unchanged)
+};
+
+// FrameMask
+// - Per-pixel weights (0 to 1) restricting frame comparisons to the part of the frame that moves - a region of interest, a
+//   user-supplied weight image, or an automatic mask of the pixels with the most temporal variance (motion energy)
+// - Only active pixels are compared: FrameStore::Gather packs them into a compacted layout, so every distance kernel runs unchanged at
+//   a cost proportional to the active area
+// - Weighted pixels are gathered pre-scaled by sqrt(weight), so distances between gathered frames are sqrt(sum w (a - b)^2) - exact
+//   for weights of 1, within rounding to 8 bits otherwise
+
+class FrameMask {
+	public:
+		// Constructors
+		FrameMask();
+		FrameMask(cv::Mat weights);
+
+		// Getters & Setters
+		cv::Mat GetWeights() const;
+		cv::Size GetSize() const;
+
+		// Instance Methods
+		bool IsEmpty() const;
+		double GetActiveFraction() const;
+		uint64_t GetChecksum() const;
+		vector<GatherRun> GetGatherRuns(cv::Size frameSize, int channels) const;
+
+		// Static Methods
+		static FrameMask FromRegion(cv::Size frameSize, cv::Rect region);
+		static FrameMask FromImage(string filePath);
+		static FrameMask FromMotionEnergy(FrameStore& frames, double activeFraction = DEFAULT_ACTIVE_FRACTION, int sampleCount = DEFAULT_SAMPLE_COUNT);
+
+		// Static Parameters
+		static constexpr double DEFAULT_ACTIVE_FRACTION = 0.25;
+		static const int DEFAULT_SAMPLE_COUNT = 256;
+
+	private:
+		// Parameters
+		cv::Mat weights;
+
+		// Static Parameters
+		static constexpr float MIN_WEIGHT = 1.0f / 255;
+};
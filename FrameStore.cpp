@@ -0,0 +1,351 @@
+#include "FrameStore.h"
+#include "FrameMask.h"
+#include "MatrixFile.h"
+#include "SimilarityCache.h"
+#include "WorkStealingScheduler.h"
+#include <cstring>
+#include <future>
+#include <map>
+#include <mutex>
+
+using namespace cv;
+using namespace std;
+
+// Shared store of a video - the video key (see SimilarityCache::GetVideoKey) is taken before decoding, so a video that is changed in
+// place (e.g. appended to) is decoded again rather than served from the old frames
+// - The store is decoded outside the lock, callers asking for the same store while it is decoded wait on its future
+struct SharedStore {
+	uint64_t videoKey;
+	shared_future<shared_ptr<FrameStore>> store;
+};
+
+// Stores shared by the similarity measure, synthesis, rendering and matrix viewer (keyed on file path and working format)
+static map<string, shared_ptr<SharedStore>> sharedStores;
+static mutex sharedStoresMutex;
+
+//--------------------------------------------------------------------------------------
+// Constructors
+//--------------------------------------------------------------------------------------
+
+// Default constructor - creates an empty frame store
+FrameStore::FrameStore() {
+	workingHeight = 0;
+	greyscale = false;
+	frameCount = 0;
+	frameType = CV_8UC3;
+	frameBytes = 0;
+	frameStride = 0;
+	fps = 0;
+	fourcc = 0;
+}
+
+// Creates a frame store by decoding the specified video
+FrameStore::FrameStore(string videoFilePath, int workingHeight, bool greyscale) : FrameStore() {
+	Load(videoFilePath, workingHeight, greyscale);
+}
+
+//--------------------------------------------------------------------------------------
+// Getters & Setters
+//--------------------------------------------------------------------------------------
+
+string FrameStore::GetVideoFilePath() {
+	return videoFilePath;
+}
+
+int FrameStore::GetFrameCount() {
+	return frameCount;
+}
+
+Size FrameStore::GetFrameSize() {
+	return frameSize;
+}
+
+Size FrameStore::GetSourceFrameSize() {
+	return sourceFrameSize;
+}
+
+int FrameStore::GetFrameType() {
+	return frameType;
+}
+
+size_t FrameStore::GetFrameBytes() {
+	return frameBytes;
+}
+
+size_t FrameStore::GetFrameStride() {
+	return frameStride;
+}
+
+double FrameStore::GetFPS() {
+	return fps;
+}
+
+int FrameStore::GetFourCC() {
+	return fourcc;
+}
+
+//--------------------------------------------------------------------------------------
+// Instance Methods (Public)
+//--------------------------------------------------------------------------------------
+
+// Decodes every frame of the video (in order) into the frame buffer
+bool FrameStore::Load(string videoFilePath, int workingHeight, bool greyscale) {
+	// Parameters:
+	// - videoFilePath: file path for video
+	// - workingHeight: height frames are stored at (0 keeps the source resolution, aspect ratio is maintained)
+	// - greyscale: stores single channel frames rather than BGR
+
+	this->videoFilePath = videoFilePath;
+	this->workingHeight = workingHeight;
+	this->greyscale = greyscale;
+	frameCount = 0;
+	buffer.release();
+	frameHashes.clear();
+
+	VideoCapture inputVideo(videoFilePath);
+
+	if (!inputVideo.isOpened())
+		return false;
+
+	fps = inputVideo.get(CAP_PROP_FPS);
+	fourcc = int(inputVideo.get(CAP_PROP_FOURCC));
+	sourceFrameSize = Size(int(inputVideo.get(CAP_PROP_FRAME_WIDTH)), int(inputVideo.get(CAP_PROP_FRAME_HEIGHT)));
+
+	// Frame count reported by the container is only an estimate - the buffer grows if more frames are decoded
+	int expectedFrameCount = max(int(inputVideo.get(CAP_PROP_FRAME_COUNT)), 1);
+	Mat frame;
+
+	while (inputVideo.read(frame)) {
+		Mat prepared = PrepareFrame(frame);
+
+		// Size the buffer using the first decoded frame
+		if (frameCount == 0) {
+			frameSize = prepared.size();
+			frameType = prepared.type();
+			frameBytes = prepared.total() * prepared.elemSize();
+			frameStride = ((frameBytes + FRAME_ALIGNMENT - 1) / FRAME_ALIGNMENT) * FRAME_ALIGNMENT;
+			buffer.create(expectedFrameCount, int(frameStride), CV_8U);
+		}
+
+		if (frameCount == buffer.rows) {
+			Mat larger(buffer.rows * 2, int(frameStride), CV_8U);
+			buffer.copyTo(larger.rowRange(0, buffer.rows));
+			buffer = larger;
+		}
+
+		prepared.copyTo(Mat(frameSize, frameType, buffer.ptr(frameCount)));
+		frameHashes.push_back(MatrixFile::ComputeChecksum(buffer.ptr(frameCount), frameBytes));
+		frameCount++;
+	}
+
+	return (frameCount > 0);
+}
+
+// Fills the store with the active pixels of another store's frames, in raster order and pre-scaled by sqrt(weight) - returns false if
+// no pixel is active
+bool FrameStore::Gather(FrameStore& source, const FrameMask& mask, int threadCount) {
+	// Parameters:
+	// - source: decoded frames
+	// - mask: pixels to keep and their weights (rescaled to the source's frame size if necessary)
+	// - threadCount: number of threads (0 uses all cores)
+
+	videoFilePath = source.videoFilePath;
+	workingHeight = source.workingHeight;
+	greyscale = source.greyscale;
+	sourceFrameSize = source.sourceFrameSize;
+	frameType = source.frameType;
+	fps = source.fps;
+	fourcc = source.fourcc;
+	frameCount = 0;
+	buffer.release();
+	frameHashes.clear();
+
+	int channels = CV_MAT_CN(source.frameType);
+	vector<GatherRun> runs = mask.GetGatherRuns(source.frameSize, channels);
+
+	size_t activeBytes = 0;
+	for (GatherRun& run : runs)
+		activeBytes += run.length;
+
+	if (!source.IsLoaded() || (activeBytes == 0))
+		return false;
+
+	// Compact frames are as tall as the number of source rows holding active pixels (a region of interest keeps its shape), and
+	// padded with zeros to fill the last row (zeros add nothing to a distance)
+	int rowBytes = source.frameSize.width * channels;
+	int activeRows = 0;
+	int lastRow = -1;
+
+	for (GatherRun& run : runs) {
+		int firstRunRow = run.sourceOffset / rowBytes;
+		int lastRunRow = (run.sourceOffset + run.length - 1) / rowBytes;
+
+		activeRows += lastRunRow - max(firstRunRow, lastRow + 1) + 1;
+		lastRow = lastRunRow;
+	}
+
+	int activePixels = int(activeBytes / channels);
+	int height = max(1, min(activeRows, activePixels));
+	int width = (activePixels + height - 1) / height;
+
+	frameSize = Size(width, height);
+	frameBytes = size_t(width) * height * channels;
+	frameStride = ((frameBytes + FRAME_ALIGNMENT - 1) / FRAME_ALIGNMENT) * FRAME_ALIGNMENT;
+	buffer = Mat(source.frameCount, int(frameStride), CV_8U, Scalar(0));
+	frameHashes.resize(source.frameCount);
+
+	WorkStealingScheduler::Run(source.frameCount, [&](int i) {
+		const uchar* input = source.GetFrameData(i);
+		uchar* output = buffer.ptr(i);
+
+		for (GatherRun& run : runs) {
+			if (run.scale == 1) {
+				memcpy(output, input + run.sourceOffset, run.length);
+			}
+			else {
+				for (int k = 0; k < run.length; k++)
+					output[k] = uchar(input[run.sourceOffset + k] * run.scale + 0.5f);
+			}
+
+			output += run.length;
+		}
+
+		frameHashes[i] = MatrixFile::ComputeChecksum(buffer.ptr(i), frameBytes);
+	}, threadCount);
+
+	frameCount = source.frameCount;
+
+	return true;
+}
+
+// Checks if any frames have been decoded into the store
+bool FrameStore::IsLoaded() {
+	return (frameCount > 0);
+}
+
+// Returns frame at specified index (header into the frame buffer - clone before modifying)
+Mat FrameStore::GetFrame(int index) {
+	if ((index < 0) || (index >= frameCount))
+		return Mat();
+
+	return Mat(frameSize, frameType, buffer.ptr(index));
+}
+
+// Returns pointer to the packed pixel data of the frame at specified index
+const uchar* FrameStore::GetFrameData(int index) {
+	if ((index < 0) || (index >= frameCount))
+		return NULL;
+
+	return buffer.ptr(index);
+}
+
+// Returns a hash of each frame's pixels (at the working resolution/colour depth of the store)
+const vector<uint64_t>& FrameStore::GetFrameHashes() {
+	return frameHashes;
+}
+
+//--------------------------------------------------------------------------------------
+// Instance Methods (Private)
+//--------------------------------------------------------------------------------------
+
+// Converts decoded frame into the working resolution/colour depth of the store
+Mat FrameStore::PrepareFrame(Mat frame) {
+	Mat output = frame;
+
+	if (greyscale && (output.channels() == 3))
+		cvtColor(output, output, COLOR_BGR2GRAY);
+
+	if ((workingHeight > 0) && (workingHeight < output.rows)) {
+		int width = max(1, int(double(output.cols) * workingHeight / output.rows));
+		resize(output, output, Size(width, workingHeight), 0, 0, INTER_AREA);
+	}
+
+	if (!output.isContinuous())
+		output = output.clone();
+
+	return output;
+}
+
+//--------------------------------------------------------------------------------------
+// Static Methods (Public)
+//--------------------------------------------------------------------------------------
+
+// Returns a decoded frame store for the video, decoding it only if it has not already been decoded in this format
+shared_ptr<FrameStore> FrameStore::GetSharedStore(string videoFilePath, int workingHeight, bool greyscale) {
+	string key = videoFilePath + "|" + to_string(workingHeight) + "|" + to_string(int(greyscale));
+	uint64_t videoKey = SimilarityCache::GetVideoKey(videoFilePath);
+
+	promise<shared_ptr<FrameStore>> decoded;
+	shared_ptr<SharedStore> entry;
+	bool decode = false;
+
+	{
+		lock_guard<mutex> lock(sharedStoresMutex);
+
+		// A store decoded (or being decoded) from an earlier version of the file is replaced
+		auto existing = sharedStores.find(key);
+		if ((existing != sharedStores.end()) && (existing->second->videoKey == videoKey) && (videoKey != 0))
+			entry = existing->second;
+		else {
+			entry = make_shared<SharedStore>();
+			entry->videoKey = videoKey;
+			entry->store = decoded.get_future().share();
+			sharedStores[key] = entry;
+			decode = true;
+		}
+	}
+
+	// Another caller is already decoding (or has decoded) this store - waits for it outside the lock
+	if (!decode)
+		return entry->store.get();
+
+	// Decodes without holding the lock (lookups of other stores carry on meanwhile)
+	shared_ptr<FrameStore> store = make_shared<FrameStore>(videoFilePath, workingHeight, greyscale);
+	decoded.set_value(store);
+
+	// A video that failed to decode is not kept (unless the entry has already been replaced or released)
+	if (!store->IsLoaded()) {
+		lock_guard<mutex> lock(sharedStoresMutex);
+
+		auto existing = sharedStores.find(key);
+		if ((existing != sharedStores.end()) && (existing->second == entry))
+			sharedStores.erase(existing);
+	}
+
+	return store;
+}
+
+// Returns the shared store of a video if it has already been decoded from the current version of the file (NULL otherwise - nothing
+// is decoded)
+shared_ptr<FrameStore> FrameStore::FindSharedStore(string videoFilePath, int workingHeight, bool greyscale) {
+	string key = videoFilePath + "|" + to_string(workingHeight) + "|" + to_string(int(greyscale));
+	uint64_t videoKey = SimilarityCache::GetVideoKey(videoFilePath);
+
+	lock_guard<mutex> lock(sharedStoresMutex);
+
+	// A store still being decoded is not waited for
+	auto existing = sharedStores.find(key);
+	if ((existing == sharedStores.end()) || (existing->second->videoKey != videoKey) || (videoKey == 0))
+		return NULL;
+
+	if (existing->second->store.wait_for(chrono::seconds(0)) != future_status::ready)
+		return NULL;
+
+	return existing->second->store.get();
+}
+
+// Releases all shared frame stores (e.g. when a new input video is selected)
+void FrameStore::ReleaseSharedStores() {
+	lock_guard<mutex> lock(sharedStoresMutex);
+	sharedStores.clear();
+}
+
+// Returns the number of leading frames two lists of frame hashes have in common (e.g. the unchanged frames after footage is appended)
+int FrameStore::GetMatchingPrefixLength(const vector<uint64_t>& frameHashes1, const vector<uint64_t>& frameHashes2) {
+	size_t length = 0;
+
+	while ((length < frameHashes1.size()) && (length < frameHashes2.size()) && (frameHashes1[length] == frameHashes2[length]))
+		length++;
+
+	return int(length);
+}
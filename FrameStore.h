@@ -0,0 +1,72 @@
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+class FrameMask;
+
+// FrameStore
+// - Decodes a video sequentially (exactly once) into a single contiguous buffer and serves frames by index
+// - Frames can optionally be stored at a reduced working resolution and/or in greyscale
+// - Each frame occupies one row of the buffer, padded so that every frame starts on an aligned boundary
+// - A hash of every frame's pixels is taken as it is decoded, so edited videos can be compared with earlier versions frame by frame
+// - A store can also be gathered from another store through a FrameMask, holding only the active pixels of each frame (packed into a
+//   compact frame), so masked comparisons cost no more than the active area
+
+class FrameStore {
+	public:
+		// Constructors
+		FrameStore();
+		FrameStore(string videoFilePath, int workingHeight = 0, bool greyscale = false);
+
+		// Getters & Setters
+		string GetVideoFilePath();
+		int GetFrameCount();
+		cv::Size GetFrameSize();
+		cv::Size GetSourceFrameSize();
+		int GetFrameType();
+		size_t GetFrameBytes();
+		size_t GetFrameStride();
+		double GetFPS();
+		int GetFourCC();
+
+		// Instance Methods
+		bool Load(string videoFilePath, int workingHeight = 0, bool greyscale = false);
+		bool Gather(FrameStore& source, const FrameMask& mask, int threadCount = 0);
+		bool IsLoaded();
+		cv::Mat GetFrame(int index);
+		const uchar* GetFrameData(int index);
+		const vector<uint64_t>& GetFrameHashes();
+
+		// Static Methods
+		static shared_ptr<FrameStore> GetSharedStore(string videoFilePath, int workingHeight = 0, bool greyscale = false);
+		static shared_ptr<FrameStore> FindSharedStore(string videoFilePath, int workingHeight = 0, bool greyscale = false);
+		static void ReleaseSharedStores();
+		static int GetMatchingPrefixLength(const vector<uint64_t>& frameHashes1, const vector<uint64_t>& frameHashes2);
+
+	private:
+		// Parameters
+		string videoFilePath;
+		int workingHeight;
+		bool greyscale;
+		int frameCount;
+		cv::Size frameSize;
+		cv::Size sourceFrameSize;
+		int frameType;
+		size_t frameBytes;
+		size_t frameStride;
+		double fps;
+		int fourcc;
+		cv::Mat buffer;
+		vector<uint64_t> frameHashes;
+
+		// Static Parameters
+		static const size_t FRAME_ALIGNMENT = 64;
+
+		// Instance Methods
+		cv::Mat PrepareFrame(cv::Mat frame);
+};
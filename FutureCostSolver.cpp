@@ -0,0 +1,835 @@
+#include "FutureCostSolver.h"
+#include "SparseSimilarityMatrix.h"
+#include "TiledMatrixStore.h"
+#include "WorkStealingScheduler.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <queue>
+
+using namespace cv;
+using namespace std;
+
+//--------------------------------------------------------------------------------------
+// Constructors
+//--------------------------------------------------------------------------------------
+
+FutureCostSolver::FutureCostSolver(double p, float alpha, float tolerance, int maxIterations, FutureCostMethod method) {
+	// Parameters:
+	// - p: exponent applied to motion distances (lower values favour many small transition costs over a few large ones)
+	// - alpha: discount applied to future cost (closer to one looks further ahead, but converges more slowly)
+	// - tolerance: iteration stops once no row minimum changes by more than tolerance * the largest row minimum
+	// - maxIterations: iteration stops after this many iterations even if not converged
+	// - method: order in which rows are updated (all methods converge to the same minima)
+
+	this->p = p;
+	this->alpha = alpha;
+	this->tolerance = tolerance;
+	this->maxIterations = maxIterations;
+	this->method = method;
+	threadCount = 0;
+	converged = false;
+	rowUpdates = 0;
+}
+
+//--------------------------------------------------------------------------------------
+// Getters & Setters
+//--------------------------------------------------------------------------------------
+
+double FutureCostSolver::GetP() {
+	return p;
+}
+
+void FutureCostSolver::SetP(double p) {
+	this->p = p;
+}
+
+float FutureCostSolver::GetAlpha() {
+	return alpha;
+}
+
+void FutureCostSolver::SetAlpha(float alpha) {
+	this->alpha = alpha;
+}
+
+float FutureCostSolver::GetTolerance() {
+	return tolerance;
+}
+
+void FutureCostSolver::SetTolerance(float tolerance) {
+	this->tolerance = tolerance;
+}
+
+int FutureCostSolver::GetMaxIterations() {
+	return maxIterations;
+}
+
+void FutureCostSolver::SetMaxIterations(int maxIterations) {
+	this->maxIterations = maxIterations;
+}
+
+FutureCostMethod FutureCostSolver::GetMethod() {
+	return method;
+}
+
+void FutureCostSolver::SetMethod(FutureCostMethod method) {
+	this->method = method;
+}
+
+int FutureCostSolver::GetThreadCount() {
+	return threadCount;
+}
+
+void FutureCostSolver::SetThreadCount(int threadCount) {
+	this->threadCount = threadCount;
+}
+
+vector<FutureCostIteration> FutureCostSolver::GetTelemetry() {
+	return telemetry;
+}
+
+int FutureCostSolver::GetIterationCount() {
+	return int(telemetry.size());
+}
+
+bool FutureCostSolver::HasConverged() {
+	return converged;
+}
+
+long long FutureCostSolver::GetRowUpdateCount() {
+	return rowUpdates;
+}
+
+vector<float> FutureCostSolver::GetInitialMinima() {
+	return initialMinima;
+}
+
+// Sets the row minima iteration starts from (see GetRowMinima) - rows beyond the end of the list start at zero, and an empty list
+// starts every row at zero (a cold start)
+void FutureCostSolver::SetInitialMinima(vector<float> initialMinima) {
+	this->initialMinima = initialMinima;
+}
+
+//--------------------------------------------------------------------------------------
+// Instance Methods (Public)
+//--------------------------------------------------------------------------------------
+
+// Computes future cost distance matrix from a motion distance matrix
+Mat FutureCostSolver::Solve(Mat motionDistanceMatrix) {
+	return SolvePowered(RaiseToPower(motionDistanceMatrix, p, threadCount));
+}
+
+// Computes future cost distance matrix from motion distances already raised to the power p (lets sweeps over alpha reuse them)
+Mat FutureCostSolver::SolvePowered(Mat motionDistanceMatrixPowP) {
+	telemetry.clear();
+	converged = false;
+	rowUpdates = 0;
+
+	int frameCount = motionDistanceMatrixPowP.rows;
+	if ((frameCount == 0) || (motionDistanceMatrixPowP.cols != frameCount))
+		return Mat();
+
+	if (motionDistanceMatrixPowP.type() != CV_32F)
+		motionDistanceMatrixPowP.convertTo(motionDistanceMatrixPowP, CV_32F);
+
+	// Warm starts break the priority queue's assumption that minima only increase
+	vector<float> lowest;
+	if ((method == FutureCostMethod::GaussSeidel) || ((method == FutureCostMethod::PriorityQueue) && !initialMinima.empty()))
+		lowest = IterateGaussSeidel(motionDistanceMatrixPowP);
+	else if (method == FutureCostMethod::PriorityQueue)
+		lowest = IteratePriorityQueue(motionDistanceMatrixPowP);
+	else
+		lowest = IterateJacobi(motionDistanceMatrixPowP);
+
+	// D''_ij = (D'_ij)^p + alpha * m_j
+	Mat distanceMatrix(frameCount, frameCount, CV_32F);
+	int taskCount = (frameCount + ROWS_PER_TASK - 1) / ROWS_PER_TASK;
+
+	WorkStealingScheduler::Run(taskCount, [&](int t) {
+		for (int i = t * ROWS_PER_TASK; i < min((t + 1) * ROWS_PER_TASK, frameCount); i++) {
+			const float* row = motionDistanceMatrixPowP.ptr<float>(i);
+			float* output = distanceMatrix.ptr<float>(i);
+
+			for (int j = 0; j < frameCount; j++)
+				output[j] = row[j] + alpha * lowest[j];
+		}
+	}, threadCount);
+
+	return distanceMatrix;
+}
+
+// Computes future cost over the stored entries of a sparse motion matrix (min_k D''_jk is taken over the entries stored in row j)
+SparseSimilarityMatrix FutureCostSolver::SolveSparse(SparseSimilarityMatrix motionDistanceMatrix) {
+	telemetry.clear();
+	converged = false;
+	rowUpdates = 0;
+
+	int frameCount = motionDistanceMatrix.GetFrameCount();
+	if (frameCount == 0)
+		return SparseSimilarityMatrix();
+
+	// (D'_ij)^p for every stored entry
+	vector<float> values = motionDistanceMatrix.GetValues();
+	RaiseToPower(values.data(), values.size(), p);
+	motionDistanceMatrix.SetValues(values);
+
+	int taskCount = (frameCount + ROWS_PER_TASK - 1) / ROWS_PER_TASK;
+
+	// m_i <- min_j ((D'_ij)^p + alpha * m_j) over the entries stored in row i, j != i
+	vector<float> minima = IterateSweeps(vector<float>(frameCount, 0), [&](const vector<float>& lowest, vector<float>& next) {
+		WorkStealingScheduler::Run(taskCount, [&](int t) {
+			for (int i = t * ROWS_PER_TASK; i < min((t + 1) * ROWS_PER_TASK, frameCount); i++) {
+				const int* columns = motionDistanceMatrix.GetRowColumns(i);
+				const float* row = motionDistanceMatrix.GetRowValues(i);
+				float value = numeric_limits<float>::infinity();
+
+				for (int c = 0; c < motionDistanceMatrix.GetRowLength(i); c++) {
+					if (columns[c] != i)
+						value = min(value, row[c] + alpha * lowest[columns[c]]);
+				}
+
+				next[i] = value;
+			}
+		}, threadCount);
+
+		// Rows with no finite stored entry take the worst known row minimum
+		float worstLowest = 0;
+		for (float value : next) {
+			if (isfinite(value))
+				worstLowest = max(worstLowest, value);
+		}
+
+		for (float& value : next) {
+			if (!isfinite(value))
+				value = worstLowest;
+		}
+	});
+
+	// D''_ij = (D'_ij)^p + alpha * m_j for every stored entry
+	size_t entry = 0;
+	for (int i = 0; i < frameCount; i++) {
+		const int* columns = motionDistanceMatrix.GetRowColumns(i);
+		for (int c = 0; c < motionDistanceMatrix.GetRowLength(i); c++, entry++)
+			values[entry] += alpha * minima[columns[c]];
+	}
+
+	motionDistanceMatrix.SetValues(values);
+
+	return motionDistanceMatrix;
+}
+
+// Computes future cost of an on-disk (tiled) motion matrix into another tiled store, streaming over the tiles once per iteration
+bool FutureCostSolver::SolveOutOfCore(TiledMatrixStore& motionDistanceMatrix, TiledMatrixStore& output, function<void(int, int)> progress) {
+	// Parameters:
+	// - motionDistanceMatrix: motion distances
+	// - output: created store receiving the future cost distances (same dimensions and tile size as the motion matrix)
+	// - progress: called with the number of tiles completed and the tile count, once per pass over the tiles (optional)
+
+	telemetry.clear();
+	converged = false;
+	rowUpdates = 0;
+
+	int frameCount = motionDistanceMatrix.GetRows();
+	if ((frameCount == 0) || (motionDistanceMatrix.GetCols() != frameCount) || (output.GetRows() != frameCount) || (output.GetCols() != frameCount) ||
+		(output.GetTileSize() != motionDistanceMatrix.GetTileSize()))
+		return false;
+
+	int tileSize = output.GetTileSize();
+	int tileRowCount = output.GetTileRowCount();
+	int tileColCount = output.GetTileColCount();
+
+	// Streams over every tile of the output (one task per band of tile rows, so each band owns its rows of the minima)
+	auto streamTiles = [&](function<void(int, int, Mat&)> visit) {
+		output.ResetProgress();
+
+		WorkStealingScheduler::Run(tileRowCount, [&](int tileRow) {
+			for (int tileCol = 0; tileCol < tileColCount; tileCol++) {
+				Mat tile = output.ReadTile(tileRow, tileCol);
+				visit(tileRow, tileCol, tile);
+
+				int completed = output.CompleteTile();
+				if (progress)
+					progress(completed, output.GetTileCount());
+			}
+		}, threadCount);
+	};
+
+	// 1. Raise motion distances to the power p (stored in the output, so p is only applied once)
+	output.ResetProgress();
+
+	WorkStealingScheduler::Run(output.GetTileCount(), [&](int t) {
+		Mat tile = RaiseToPower(motionDistanceMatrix.ReadTile(t / tileColCount, t % tileColCount), p, 1);
+		output.WriteTile(t / tileColCount, t % tileColCount, tile);
+
+		int completed = output.CompleteTile();
+		if (progress)
+			progress(completed, output.GetTileCount());
+	}, threadCount);
+
+	// 2. m_i <- min_j ((D'_ij)^p + alpha * m_j), j != i, reduced tile by tile
+	vector<float> minima = IterateSweeps(vector<float>(frameCount, 0), [&](const vector<float>& lowest, vector<float>& next) {
+		fill(next.begin(), next.end(), numeric_limits<float>::infinity());
+
+		streamTiles([&](int tileRow, int tileCol, Mat& tile) {
+			int rows = min(tileSize, frameCount - tileRow * tileSize);
+			int cols = min(tileSize, frameCount - tileCol * tileSize);
+			const float* tileLowest = lowest.data() + tileCol * tileSize;
+
+			for (int r = 0; r < rows; r++) {
+				int i = tileRow * tileSize + r;
+				int diagonal = i - tileCol * tileSize;
+				const float* values = tile.ptr<float>(r);
+
+				if ((diagonal >= 0) && (diagonal < cols))
+					next[i] = min(next[i], min(GetRowMinimum(values, tileLowest, alpha, 0, diagonal), GetRowMinimum(values, tileLowest, alpha, diagonal + 1, cols)));
+				else
+					next[i] = min(next[i], GetRowMinimum(values, tileLowest, alpha, 0, cols));
+			}
+		});
+	});
+
+	// 3. D''_ij = (D'_ij)^p + alpha * m_j for every entry
+	streamTiles([&](int tileRow, int tileCol, Mat& tile) {
+		int cols = min(tileSize, frameCount - tileCol * tileSize);
+
+		for (int r = 0; r < min(tileSize, frameCount - tileRow * tileSize); r++) {
+			float* values = tile.ptr<float>(r);
+			for (int c = 0; c < cols; c++)
+				values[c] += alpha * minima[tileCol * tileSize + c];
+		}
+
+		output.WriteTile(tileRow, tileCol, tile);
+	});
+
+	return true;
+}
+
+//--------------------------------------------------------------------------------------
+// Instance Methods (Private)
+//--------------------------------------------------------------------------------------
+
+// Iterates row minima, updating every row from the previous iteration's minima
+vector<float> FutureCostSolver::IterateJacobi(Mat& motionDistanceMatrixPowP) {
+	int frameCount = motionDistanceMatrixPowP.rows;
+	int taskCount = (frameCount + ROWS_PER_TASK - 1) / ROWS_PER_TASK;
+
+	// Row minima start at zero (so the first iteration gives the row minima of the powered motion distances) unless warm-started
+	return IterateSweeps(GetStartingMinima(motionDistanceMatrixPowP), [&](const vector<float>& lowest, vector<float>& next) {
+		// m_i <- min_j ((D'_ij)^p + alpha * m_j), j != i
+		WorkStealingScheduler::Run(taskCount, [&](int t) {
+			for (int i = t * ROWS_PER_TASK; i < min((t + 1) * ROWS_PER_TASK, frameCount); i++) {
+				const float* row = motionDistanceMatrixPowP.ptr<float>(i);
+				next[i] = min(GetRowMinimum(row, lowest.data(), alpha, 0, i), GetRowMinimum(row, lowest.data(), alpha, i + 1, frameCount));
+			}
+		}, threadCount);
+	});
+}
+
+// Iterates row minima by full sweeps, each computing every row's minimum from the previous sweep's minima, until no minimum changes by
+// more than tolerance * the largest minimum (the stopping rule shared by every storage the solver iterates over)
+vector<float> FutureCostSolver::IterateSweeps(vector<float> lowest, function<void(const vector<float>&, vector<float>&)> sweep) {
+	// Parameters:
+	// - lowest: row minima to start from
+	// - sweep: computes every row's next minimum from the current minima
+
+	int frameCount = int(lowest.size());
+	vector<float> next(frameCount);
+
+	for (int iteration = 0; iteration < maxIterations; iteration++) {
+		auto start = chrono::steady_clock::now();
+
+		sweep(lowest, next);
+		rowUpdates += frameCount;
+
+		float residual = 0;
+		float largest = 0;
+		for (int i = 0; i < frameCount; i++) {
+			residual = max(residual, abs(next[i] - lowest[i]));
+			if (isfinite(next[i]))
+				largest = max(largest, abs(next[i]));
+		}
+
+		lowest.swap(next);
+		RecordIteration(residual, start);
+
+		if (residual <= tolerance * largest) {
+			converged = true;
+			break;
+		}
+	}
+
+	return lowest;
+}
+
+// Iterates row minima in place, from the last frame backwards (each row sees the minima already updated in this sweep)
+vector<float> FutureCostSolver::IterateGaussSeidel(Mat& motionDistanceMatrixPowP) {
+	// Sweeps are sequential (each row depends on the rows before it in the sweep) - the row reductions are still vectorised
+
+	int frameCount = motionDistanceMatrixPowP.rows;
+	vector<float> lowest = GetStartingMinima(motionDistanceMatrixPowP);
+
+	for (int iteration = 0; iteration < maxIterations; iteration++) {
+		auto start = chrono::steady_clock::now();
+		float residual = 0;
+		float largest = 0;
+
+		for (int i = frameCount - 1; i >= 0; i--) {
+			const float* row = motionDistanceMatrixPowP.ptr<float>(i);
+			float updated = min(GetRowMinimum(row, lowest.data(), alpha, 0, i), GetRowMinimum(row, lowest.data(), alpha, i + 1, frameCount));
+
+			residual = max(residual, abs(updated - lowest[i]));
+			if (isfinite(updated))
+				largest = max(largest, abs(updated));
+			lowest[i] = updated;
+		}
+
+		rowUpdates += frameCount;
+		RecordIteration(residual, start);
+
+		if (residual <= tolerance * largest) {
+			converged = true;
+			break;
+		}
+	}
+
+	return lowest;
+}
+
+// Iterates row minima by only updating rows whose arg min changed, processing the largest changes first
+vector<float> FutureCostSolver::IteratePriorityQueue(Mat& motionDistanceMatrixPowP) {
+	// Minima only increase, so increasing m_j cannot lower any row minimum, and only raises those rows whose minimum is attained at j.
+	// Changes below tolerance * the largest minimum are not propagated (the same stopping rule as the other methods). Telemetry is
+	// recorded every n row updates (comparable to one sweep of the other methods)
+
+	int frameCount = motionDistanceMatrixPowP.rows;
+	vector<float> lowest(frameCount, 0);
+	vector<int> argmins(frameCount, -1);
+	vector<vector<int>> dependents(frameCount);
+	float largest = 0;
+
+	// 1. One full sweep to find every row's minimum and arg min
+	auto start = chrono::steady_clock::now();
+	float residual = 0;
+
+	for (int i = frameCount - 1; i >= 0; i--) {
+		float updated = GetRowMinimum(motionDistanceMatrixPowP.ptr<float>(i), lowest.data(), alpha, i, frameCount, argmins[i]);
+		residual = max(residual, abs(updated - lowest[i]));
+		if (isfinite(updated))
+			largest = max(largest, abs(updated));
+		lowest[i] = updated;
+
+		if (argmins[i] >= 0)
+			dependents[argmins[i]].push_back(i);
+	}
+
+	rowUpdates += frameCount;
+	RecordIteration(residual, start);
+
+	// 2. Queue rows that point at a row whose minimum changed after they read it (i.e. rows updated later in the sweep)
+	priority_queue<pair<float, int>> queue;
+	vector<float> queuedChange(frameCount, 0);
+
+	for (int i = 0; i < frameCount; i++) {
+		int j = argmins[i];
+		if ((j >= 0) && (j < i)) {
+			queuedChange[i] = FLT_MAX;
+			queue.push(make_pair(FLT_MAX, i));
+		}
+	}
+
+	// 3. Update rows until no change is above the tolerance
+	long long updatesPerRecord = frameCount;
+	long long updatesSinceRecord = 0;
+	long long maxUpdates = (long long)(maxIterations) * frameCount;
+	start = chrono::steady_clock::now();
+	residual = 0;
+
+	while (!queue.empty() && (rowUpdates < maxUpdates)) {
+		int i = queue.top().second;
+		queue.pop();
+
+		if (queuedChange[i] == 0)
+			continue;
+		queuedChange[i] = 0;
+
+		int previousArgmin = argmins[i];
+		float updated = GetRowMinimum(motionDistanceMatrixPowP.ptr<float>(i), lowest.data(), alpha, i, frameCount, argmins[i]);
+		float change = updated - lowest[i];
+
+		lowest[i] = updated;
+		if (isfinite(updated))
+			largest = max(largest, abs(updated));
+		residual = max(residual, abs(change));
+		rowUpdates++;
+		updatesSinceRecord++;
+
+		if ((argmins[i] != previousArgmin) && (argmins[i] >= 0))
+			dependents[argmins[i]].push_back(i);
+
+		// Propagate to the rows whose minimum is attained at this row (stale entries are dropped as the list is walked)
+		if (abs(change) > tolerance * largest) {
+			vector<int>& rows = dependents[i];
+			int kept = 0;
+
+			for (int k = 0; k < int(rows.size()); k++) {
+				int dependent = rows[k];
+				if (argmins[dependent] != i)
+					continue;
+
+				rows[kept++] = dependent;
+				if (abs(change) > queuedChange[dependent]) {
+					queuedChange[dependent] = abs(change);
+					queue.push(make_pair(abs(change), dependent));
+				}
+			}
+
+			rows.resize(kept);
+		}
+
+		if (updatesSinceRecord == updatesPerRecord) {
+			RecordIteration(residual, start);
+			updatesSinceRecord = 0;
+			start = chrono::steady_clock::now();
+			residual = 0;
+		}
+	}
+
+	if (updatesSinceRecord > 0)
+		RecordIteration(residual, start);
+
+	converged = queue.empty() || all_of(queuedChange.begin(), queuedChange.end(), [](float change) { return change == 0; });
+
+	return lowest;
+}
+
+// Returns the row minima iteration starts from - zero, or the initial minima if set (rows beyond them start from their best transition
+// into the warm-started rows, rather than zero, which would make every other row's minimum collapse towards them)
+vector<float> FutureCostSolver::GetStartingMinima(Mat& motionDistanceMatrixPowP) {
+	int frameCount = motionDistanceMatrixPowP.rows;
+	int initialCount = min(int(initialMinima.size()), frameCount);
+
+	vector<float> lowest(frameCount, 0);
+	copy(initialMinima.begin(), initialMinima.begin() + initialCount, lowest.begin());
+
+	if (initialCount > 0) {
+		WorkStealingScheduler::Run(frameCount - initialCount, [&](int k) {
+			int i = initialCount + k;
+			lowest[i] = GetRowMinimum(motionDistanceMatrixPowP.ptr<float>(i), lowest.data(), alpha, 0, initialCount);
+		}, threadCount);
+
+		RefineByPolicyIteration(motionDistanceMatrixPowP, lowest);
+	}
+
+	return lowest;
+}
+
+// Refines warm-started minima by policy iteration - points every row at its arg min, then replaces the minima with the exact minima of
+// those pointers, until no arg min changes (each step costs one sweep, recorded in the telemetry)
+void FutureCostSolver::RefineByPolicyIteration(Mat& motionDistanceMatrixPowP, vector<float>& lowest) {
+	int frameCount = motionDistanceMatrixPowP.rows;
+	int taskCount = (frameCount + ROWS_PER_TASK - 1) / ROWS_PER_TASK;
+	vector<int> argmins(frameCount, -1);
+	vector<int> previousArgmins;
+
+	for (int step = 0; step < MAX_POLICY_STEPS; step++) {
+		auto start = chrono::steady_clock::now();
+
+		WorkStealingScheduler::Run(taskCount, [&](int t) {
+			for (int i = t * ROWS_PER_TASK; i < min((t + 1) * ROWS_PER_TASK, frameCount); i++)
+				GetRowMinimum(motionDistanceMatrixPowP.ptr<float>(i), lowest.data(), alpha, i, frameCount, argmins[i]);
+		}, threadCount);
+
+		rowUpdates += frameCount;
+
+		if (argmins == previousArgmins)
+			break;
+
+		vector<float> evaluated = EvaluatePolicy(motionDistanceMatrixPowP, argmins, lowest);
+
+		float residual = 0;
+		for (int i = 0; i < frameCount; i++)
+			residual = max(residual, abs(evaluated[i] - lowest[i]));
+
+		lowest.swap(evaluated);
+		previousArgmins = argmins;
+		RecordIteration(residual, start);
+	}
+}
+
+// Returns the exact minima when every row i transitions to argmins[i] - following the pointers from any row leads into a cycle, whose
+// minima have a closed form (the discounted cost once round the cycle / (1 - alpha^length)), and the rows leading into it are then
+// resolved backwards
+vector<float> FutureCostSolver::EvaluatePolicy(Mat& motionDistanceMatrixPowP, vector<int>& argmins, vector<float>& lowest) {
+	// Parameters:
+	// - motionDistanceMatrixPowP: powered motion distances
+	// - argmins: row each row transitions to (-1 keeps the row's current minimum)
+	// - lowest: current minima
+
+	int frameCount = motionDistanceMatrixPowP.rows;
+	vector<double> values(frameCount, 0);
+	vector<char> state(frameCount, 0);	// 0 = unvisited, 1 = on the current path, 2 = resolved
+	vector<int> path;
+
+	for (int first = 0; first < frameCount; first++) {
+		if (state[first] != 0)
+			continue;
+
+		// 1. Follow the pointers until reaching a resolved row, a row without a pointer or a cycle
+		path.clear();
+		int i = first;
+
+		while ((i >= 0) && (state[i] == 0)) {
+			state[i] = 1;
+			path.push_back(i);
+			i = argmins[i];
+		}
+
+		int unresolved = int(path.size());
+
+		if (i < 0) {
+			values[path.back()] = lowest[path.back()];
+			unresolved--;
+		}
+		else if (state[i] == 1) {
+			// 2. Cycle from i to the end of the path - discounted cost once round it, starting at i
+			int cycleStart = int(find(path.begin(), path.end(), i) - path.begin());
+			double total = 0;
+			double discount = 1;
+
+			for (int k = cycleStart; k < int(path.size()); k++) {
+				total += discount * motionDistanceMatrixPowP.ptr<float>(path[k])[argmins[path[k]]];
+				discount *= alpha;
+			}
+
+			values[i] = total / (1 - discount);
+
+			for (int k = int(path.size()) - 1; k > cycleStart; k--)
+				values[path[k]] = motionDistanceMatrixPowP.ptr<float>(path[k])[argmins[path[k]]] + alpha * values[argmins[path[k]]];
+
+			unresolved = cycleStart;
+		}
+
+		// 3. Rows leading into the resolved row/cycle, backwards
+		for (int k = int(path.size()) - 1; k >= 0; k--) {
+			if (k < unresolved)
+				values[path[k]] = motionDistanceMatrixPowP.ptr<float>(path[k])[argmins[path[k]]] + alpha * values[argmins[path[k]]];
+
+			state[path[k]] = 2;
+		}
+	}
+
+	return vector<float>(values.begin(), values.end());
+}
+
+// Adds an entry to the telemetry
+void FutureCostSolver::RecordIteration(float residual, chrono::steady_clock::time_point start) {
+	FutureCostIteration record;
+	record.iteration = int(telemetry.size()) + 1;
+	record.residual = residual;
+	record.milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+	telemetry.push_back(record);
+}
+
+//--------------------------------------------------------------------------------------
+// Static Methods (Public)
+//--------------------------------------------------------------------------------------
+
+// Returns distance matrix raised to the power p (as CV_32F, the input is not modified)
+Mat FutureCostSolver::RaiseToPower(Mat distanceMatrix, double p, int threadCount) {
+	// Parameters:
+	// - distanceMatrix: distance matrix (need not be square)
+	// - p: exponent
+	// - threadCount: number of threads (0 uses all cores)
+
+	Mat output;
+
+	if (distanceMatrix.type() != CV_32F)
+		distanceMatrix.convertTo(output, CV_32F);
+	else if (p == 1)
+		return distanceMatrix;
+	else
+		output = distanceMatrix.clone();
+
+	int taskCount = (output.rows + ROWS_PER_TASK - 1) / ROWS_PER_TASK;
+
+	WorkStealingScheduler::Run(taskCount, [&](int t) {
+		for (int i = t * ROWS_PER_TASK; i < min((t + 1) * ROWS_PER_TASK, output.rows); i++)
+			RaiseToPower(output.ptr<float>(i), size_t(output.cols), p);
+	}, threadCount);
+
+	return output;
+}
+
+// Raises a compact distance matrix to the power p, decoding it row by row straight into the output (no full precision copy of the input
+// is made alongside it)
+Mat FutureCostSolver::RaiseToPower(const CompactMatrix& distanceMatrix, double p, int threadCount) {
+	// Parameters:
+	// - distanceMatrix: compact distance matrix (need not be square)
+	// - p: exponent
+	// - threadCount: number of threads (0 uses all cores)
+
+	Mat output(distanceMatrix.GetRows(), distanceMatrix.GetCols(), CV_32F);
+	int taskCount = (output.rows + ROWS_PER_TASK - 1) / ROWS_PER_TASK;
+
+	WorkStealingScheduler::Run(taskCount, [&](int t) {
+		for (int i = t * ROWS_PER_TASK; i < min((t + 1) * ROWS_PER_TASK, output.rows); i++) {
+			distanceMatrix.DecodeRow(i, 0, output.cols, output.ptr<float>(i));
+			RaiseToPower(output.ptr<float>(i), size_t(output.cols), p);
+		}
+	}, threadCount);
+
+	return output;
+}
+
+// Raises values to the power p in place - common exponents use specialised kernels, any other exponent uses pow
+void FutureCostSolver::RaiseToPower(float* values, size_t count, double p) {
+	if (p == 1)
+		return;
+	else if (p == 0.25)
+		RaiseToQuarterPower<1>(values, count);
+	else if (p == 0.5)
+		RaiseToQuarterPower<2>(values, count);
+	else if (p == 0.75)
+		RaiseToQuarterPower<3>(values, count);
+	else if (p == 2)
+		RaiseToQuarterPower<8>(values, count);
+	else {
+		float exponent = float(p);
+		for (size_t k = 0; k < count; k++)
+			values[k] = pow(values[k], exponent);
+	}
+}
+
+// Recovers the row minima m_j = min_k D''_jk (k != j) of a solved future cost matrix (the starting point for a warm start)
+vector<float> FutureCostSolver::GetRowMinima(Mat futureCostDistanceMatrix, int threadCount) {
+	int frameCount = min(futureCostDistanceMatrix.rows, futureCostDistanceMatrix.cols);
+	vector<float> lowest(max(frameCount, 0), 0);
+
+	if (futureCostDistanceMatrix.type() != CV_32F)
+		return lowest;
+
+	WorkStealingScheduler::Run(frameCount, [&](int j) {
+		const float* row = futureCostDistanceMatrix.ptr<float>(j);
+		float value = numeric_limits<float>::infinity();
+
+		for (int k = 0; k < frameCount; k++) {
+			if (k != j)
+				value = min(value, row[k]);
+		}
+
+		lowest[j] = (value < FLT_MAX) ? value : 0;
+	}, threadCount);
+
+	return lowest;
+}
+
+//--------------------------------------------------------------------------------------
+// Static Methods (Private)
+//--------------------------------------------------------------------------------------
+
+// Returns min_j (row_j + alpha * lowest_j) over columns [begin, end) (+inf if empty or every column is rejected)
+float FutureCostSolver::GetRowMinimum(const float* row, const float* lowest, float alpha, int begin, int end) {
+	// Eight independent running minima, so the reduction vectorises without relaxing floating point semantics
+	const int lanes = 8;
+	float minima[lanes];
+	for (int l = 0; l < lanes; l++)
+		minima[l] = numeric_limits<float>::infinity();
+
+	int j = begin;
+	for (; j + lanes <= end; j += lanes) {
+		for (int l = 0; l < lanes; l++)
+			minima[l] = min(minima[l], row[j + l] + alpha * lowest[j + l]);
+	}
+
+	for (; j < end; j++)
+		minima[0] = min(minima[0], row[j] + alpha * lowest[j]);
+
+	float minimum = minima[0];
+	for (int l = 1; l < lanes; l++)
+		minimum = min(minimum, minima[l]);
+
+	return minimum;
+}
+
+// Returns min_j (row_j + alpha * lowest_j) over all columns except one, and the column it is attained at (-1 if there are no columns)
+float FutureCostSolver::GetRowMinimum(const float* row, const float* lowest, float alpha, int exclude, int count, int& argmin) {
+	int before, after;
+	float minimumBefore = GetRowMinimumAndColumn(row, lowest, alpha, 0, exclude, before);
+	float minimumAfter = GetRowMinimumAndColumn(row, lowest, alpha, exclude + 1, count, after);
+
+	// Ties go to the earlier column
+	float minimum = (minimumAfter < minimumBefore) ? minimumAfter : minimumBefore;
+	argmin = (minimumAfter < minimumBefore) ? after : before;
+
+	// No finite value - the first column is reported (as any column attains the minimum)
+	if (argmin < 0)
+		argmin = (exclude > 0) ? 0 : ((count > 1) ? 1 : -1);
+
+	return minimum;
+}
+
+// Returns min_j (row_j + alpha * lowest_j) over columns [begin, end) and the first column attaining it (-1 if no value is below +inf) -
+// the column is tracked in the same reduction as the minimum, so it always matches the value returned
+float FutureCostSolver::GetRowMinimumAndColumn(const float* row, const float* lowest, float alpha, int begin, int end, int& column) {
+	// Eight independent running minima and their columns (each lane keeps its first column, lanes are combined by value then column)
+	const int lanes = 8;
+	float minima[lanes];
+	int columns[lanes];
+	for (int l = 0; l < lanes; l++) {
+		minima[l] = numeric_limits<float>::infinity();
+		columns[l] = -1;
+	}
+
+	int j = begin;
+	for (; j + lanes <= end; j += lanes) {
+		for (int l = 0; l < lanes; l++) {
+			float value = row[j + l] + alpha * lowest[j + l];
+			bool lower = value < minima[l];
+			minima[l] = lower ? value : minima[l];
+			columns[l] = lower ? (j + l) : columns[l];
+		}
+	}
+
+	for (; j < end; j++) {
+		float value = row[j] + alpha * lowest[j];
+		if (value < minima[0]) {
+			minima[0] = value;
+			columns[0] = j;
+		}
+	}
+
+	float minimum = minima[0];
+	column = columns[0];
+
+	for (int l = 1; l < lanes; l++) {
+		if ((minima[l] < minimum) || ((minima[l] == minimum) && (columns[l] >= 0) && ((column < 0) || (columns[l] < column)))) {
+			minimum = minima[l];
+			column = columns[l];
+		}
+	}
+
+	return minimum;
+}
+
+
+// Raises values to the power Quarters / 4 in place (contiguous, so the compiler vectorises the sqrt/multiply kernel)
+template<int Quarters>
+void FutureCostSolver::RaiseToQuarterPower(float* values, size_t count) {
+	for (size_t k = 0; k < count; k++)
+		values[k] = RaiseValue<Quarters>(values[k]);
+}
+
+// Returns value^(Quarters / 4) using square roots and multiplies (x^0.75 = sqrt(x) * sqrt(sqrt(x)))
+template<int Quarters>
+float FutureCostSolver::RaiseValue(float value) {
+	if constexpr (Quarters == 1)
+		return sqrt(sqrt(value));
+	else if constexpr (Quarters == 2)
+		return sqrt(value);
+	else if constexpr (Quarters == 3) {
+		float root = sqrt(value);
+		return root * sqrt(root);
+	}
+	else
+		return value * value;
+}
\ No newline at end of file
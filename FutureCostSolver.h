@@ -0,0 +1,116 @@
+#pragma once
+#include "CompactMatrix.h"
+#include <opencv2/opencv.hpp>
+#include <chrono>
+#include <functional>
+#include <vector>
+
+using namespace std;
+
+class SparseSimilarityMatrix;
+class TiledMatrixStore;
+
+// Methods for iterating the row minima of the future cost solver
+enum class FutureCostMethod {
+	Jacobi,			// Every row updated from the previous iteration's minima (reference, parallel)
+	GaussSeidel,	// Rows updated in place from the end of the video backwards (newer minima are used straight away)
+	PriorityQueue	// Only rows whose minimum can have changed are updated, largest change first
+};
+
+// Telemetry recorded for each iteration of the future cost solver
+struct FutureCostIteration {
+	int iteration;
+	float residual;			// Largest change of any row minimum
+	double milliseconds;	// Time taken by the iteration
+};
+
+// FutureCostSolver
+// - Solves D''_ij = (D'_ij)^p + alpha * min_k D''_jk (k != j) by value iteration until the row minima converge
+// - Only the n row minima m_j = min_k D''_jk are iterated (m_i <- min_j ((D'_ij)^p + alpha * m_j)), the matrix is built once at the end
+// - Each iteration is a contiguous reduction over every row, split across all cores
+// - Minima start at zero and only ever increase, so a row's minimum can only change when the minimum of the row it currently points
+//   to (its arg min) changes - the priority queue method uses this to skip rows that are unaffected
+// - Can be warm-started from the minima of a previous solution (e.g. before frames were appended) - value iteration converges from any
+//   starting minima, so only the iterations needed to absorb the change are run (the priority queue method needs minima to start at
+//   zero, so warm starts use Gauss-Seidel instead)
+// - Warm starts are first refined by policy iteration (each row points at its arg min, and the minima of those pointers are solved
+//   exactly), so a large drop - e.g. appended frames that loop back to earlier ones cheaply - takes a few sweeps rather than the
+//   log(tolerance) / log(alpha) sweeps value iteration needs to absorb it
+// - Common exponents (p = 0.25, 0.5, 0.75, 1, 2) are applied with kernels specialised on p (sqrt/multiply rather than pow)
+// - Rejected pairs (+inf distances) are never chosen - a row with no finite distance keeps an infinite minimum, which is left out of
+//   the convergence test
+// - Sparse matrices are iterated over their stored entries only (Jacobi sweeps from zero, with the same stopping rule and telemetry) -
+//   there a row with no finite stored entry takes the largest row minimum instead (an unknown future is never treated as cheap)
+// - Tiled (out-of-core) matrices are iterated the same way, streaming over the tiles once per sweep (only the n minima are held in memory)
+
+class FutureCostSolver {
+	public:
+		// Constructors
+		FutureCostSolver(double p = 0.75, float alpha = 0.995f, float tolerance = 1e-4f, int maxIterations = 1000, FutureCostMethod method = FutureCostMethod::Jacobi);
+
+		// Getters & Setters
+		double GetP();
+		void SetP(double p);
+		float GetAlpha();
+		void SetAlpha(float alpha);
+		float GetTolerance();
+		void SetTolerance(float tolerance);
+		int GetMaxIterations();
+		void SetMaxIterations(int maxIterations);
+		FutureCostMethod GetMethod();
+		void SetMethod(FutureCostMethod method);
+		int GetThreadCount();
+		void SetThreadCount(int threadCount);
+		vector<FutureCostIteration> GetTelemetry();
+		int GetIterationCount();
+		bool HasConverged();
+		long long GetRowUpdateCount();
+		vector<float> GetInitialMinima();
+		void SetInitialMinima(vector<float> initialMinima);
+
+		// Instance Methods
+		cv::Mat Solve(cv::Mat motionDistanceMatrix);
+		cv::Mat SolvePowered(cv::Mat motionDistanceMatrixPowP);
+		SparseSimilarityMatrix SolveSparse(SparseSimilarityMatrix motionDistanceMatrix);
+		bool SolveOutOfCore(TiledMatrixStore& motionDistanceMatrix, TiledMatrixStore& output, function<void(int, int)> progress = NULL);
+
+		// Static Methods
+		static cv::Mat RaiseToPower(cv::Mat distanceMatrix, double p, int threadCount = 0);
+		static cv::Mat RaiseToPower(const CompactMatrix& distanceMatrix, double p, int threadCount = 0);
+		static void RaiseToPower(float* values, size_t count, double p);
+		static vector<float> GetRowMinima(cv::Mat futureCostDistanceMatrix, int threadCount = 0);
+
+	private:
+		// Parameters
+		double p;
+		float alpha;
+		float tolerance;
+		int maxIterations;
+		FutureCostMethod method;
+		int threadCount;
+		vector<FutureCostIteration> telemetry;
+		bool converged;
+		long long rowUpdates;
+		vector<float> initialMinima;
+
+		// Static Parameters
+		static const int ROWS_PER_TASK = 32;
+		static const int MAX_POLICY_STEPS = 20;
+
+		// Instance Methods
+		vector<float> IterateJacobi(cv::Mat& motionDistanceMatrixPowP);
+		vector<float> IterateSweeps(vector<float> lowest, function<void(const vector<float>&, vector<float>&)> sweep);
+		vector<float> IterateGaussSeidel(cv::Mat& motionDistanceMatrixPowP);
+		vector<float> IteratePriorityQueue(cv::Mat& motionDistanceMatrixPowP);
+		vector<float> GetStartingMinima(cv::Mat& motionDistanceMatrixPowP);
+		void RefineByPolicyIteration(cv::Mat& motionDistanceMatrixPowP, vector<float>& lowest);
+		vector<float> EvaluatePolicy(cv::Mat& motionDistanceMatrixPowP, vector<int>& argmins, vector<float>& lowest);
+		void RecordIteration(float residual, chrono::steady_clock::time_point start);
+
+		// Static Methods
+		static float GetRowMinimum(const float* row, const float* lowest, float alpha, int begin, int end);
+		static float GetRowMinimum(const float* row, const float* lowest, float alpha, int exclude, int count, int& argmin);
+		static float GetRowMinimumAndColumn(const float* row, const float* lowest, float alpha, int begin, int end, int& column);
+		template<int Quarters> static void RaiseToQuarterPower(float* values, size_t count);
+		template<int Quarters> static float RaiseValue(float value);
+};
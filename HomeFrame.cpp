@@ -1,10 +1,13 @@
 #include "HomeFrame.h"
 #include "MatrixFrame.h"
+#include "ArtifactExporter.h"
 #include "VideoPreprocessing.h"
 #include "SimilarityMeasure.h"
+#include "SimilarityCache.h"
 #include "SimilarityMatrix.h"
 #include "Synthesis.h"
 #include "Rendering.h"
+#include "FrameStore.h"
 #include "Utilities.cpp"
 #include <wx/filedlg.h>
 #include <wx/cshelp.h>
@@ -352,17 +355,14 @@ void HomeFrame::UpdateUI() {
 	this->FindWindowById(570)->SetLabel(input.GetFutureCostFilePath());
 	this->FindWindowById(825)->SetLabel(output.GetVideoFilePath());
 
-	// Euclidean Display
-	if ((input.GetVideoFilePath() != "") && (input.GetEuclideanFilePath() != ""))
-		this->FindWindowById(540)->Enable(true);
+	// Euclidean Display (disabled again when the matrices are cleared)
+	this->FindWindowById(540)->Enable((input.GetVideoFilePath() != "") && (input.GetEuclideanFilePath() != ""));
 
 	// Motion Display
-	if ((input.GetVideoFilePath() != "") && (input.GetMotionFilePath() != ""))
-		this->FindWindowById(560)->Enable(true);
+	this->FindWindowById(560)->Enable((input.GetVideoFilePath() != "") && (input.GetMotionFilePath() != ""));
 
 	// Future Cost Display
-	if ((input.GetVideoFilePath() != "") && (input.GetFutureCostFilePath() != ""))
-		this->FindWindowById(580)->Enable(true);
+	this->FindWindowById(580)->Enable((input.GetVideoFilePath() != "") && (input.GetFutureCostFilePath() != ""));
 
 	// Video Processing Begin
 	if (input.GetVideoFilePath() != "")
@@ -373,8 +373,7 @@ void HomeFrame::UpdateUI() {
 		this->FindWindowById(710)->Enable(true);
 
 	// Synthesis Begin
-	if ((input.GetVideoFilePath() != "") && (input.GetMotionFilePath() != "") && (input.GetFutureCostFilePath() != ""))
-		this->FindWindowById(810)->Enable(true);
+	this->FindWindowById(810)->Enable((input.GetVideoFilePath() != "") && (input.GetMotionFilePath() != "") && (input.GetFutureCostFilePath() != ""));
 
 	// Rendering Begin
 	if (output.GetVideoFilePath() != "")
@@ -423,8 +422,17 @@ void HomeFrame::BtnVideoSelectClick(wxCommandEvent& e) {
 	{
 		// Save file path selected by user
 		string filePath = string(fileDialog->GetPath());
+
+		// Matrices of the previous video must not be updated from (the same video selected again keeps them, e.g. after footage is appended)
+		if ((input.GetVideoFilePath() != "") && (input.GetVideoFilePath() != filePath))
+			input.ClearMatrices();
+
 		input.SetVideoFilePath(filePath);
 
+		// Frames decoded (and matrices kept for export) for the previous video are no longer needed
+		FrameStore::ReleaseSharedStores();
+		ArtifactExporter::GetSharedExporter().Release();
+
 		// Update UI elements
 		UpdateUI();
 	}
@@ -442,7 +450,7 @@ void HomeFrame::BtnEuclideanSimilarityMatrixSelectClick(wxCommandEvent& e) {
 		// Save Euclidean matrix selected by user
 		string filePath = string(fileDialog->GetPath());
 		input.SetEuclideanFilePath(filePath);
-		input.SetEuclidean(ReadCSVFile(filePath));
+		input.SetEuclidean(SimilarityMatrix::Load(filePath, input.GetVideoFilePath()));
 
 		// Update UI elements
 		UpdateUI();
@@ -453,7 +461,11 @@ void HomeFrame::BtnEuclideanSimilarityMatrixSelectClick(wxCommandEvent& e) {
 
 // Event handler for display Euclidean similarity matrix button
 void HomeFrame::BtnEuclideanSimilarityMatrixViewClick(wxCommandEvent& e) {
-	MatrixFrame* matrixFrame = new MatrixFrame("Euclidean Similarity Matrix", input.GetVideoFilePath(), input.GetEuclidean().GetDistanceMatrix(), input.GetEuclidean().GetProbabilityMatrix(), "euclidean");
+	// Not kept by the fused similarity measure - computed when first viewed
+	if (input.GetEuclidean().GetDistanceMatrix().empty())
+		input.SetEuclidean(SimilarityMeasure::ComputeEuclideanSimilarityMatrix(input.GetVideoFilePath()));
+
+	MatrixFrame* matrixFrame = new MatrixFrame("Euclidean Similarity Matrix", input.GetVideoFilePath(), input.GetEuclidean().GetDenseDistanceMatrix(), input.GetEuclidean().GetProbabilityMatrix(), "euclidean");
 	matrixFrame->SetClientSize(1010, 625);
 	matrixFrame->Center();
 	matrixFrame->Show(true);
@@ -469,7 +481,7 @@ void HomeFrame::BtnMotionSimilarityMatrixSelectClick(wxCommandEvent& e) {
 		// Save motion matrix selected by user
 		string filePath = string(fileDialog->GetPath());
 		input.SetMotionFilePath(filePath);
-		input.SetMotion(ReadCSVFile(filePath));
+		input.SetMotion(SimilarityMatrix::Load(filePath, input.GetVideoFilePath()));
 
 		// Update UI elements
 		UpdateUI();
@@ -480,7 +492,7 @@ void HomeFrame::BtnMotionSimilarityMatrixSelectClick(wxCommandEvent& e) {
 
 // Event handler for display motion similarity matrix button
 void HomeFrame::BtnMotionSimilarityMatrixViewClick(wxCommandEvent& e) {
-	MatrixFrame* matrixFrame = new MatrixFrame("Motion Similarity Matrix", input.GetVideoFilePath(), input.GetMotion().GetDistanceMatrix(), input.GetMotion().GetProbabilityMatrix(), "motion");
+	MatrixFrame* matrixFrame = new MatrixFrame("Motion Similarity Matrix", input.GetVideoFilePath(), input.GetMotion().GetDenseDistanceMatrix(), input.GetMotion().GetProbabilityMatrix(), "motion");
 	matrixFrame->SetClientSize(1010, 625);
 	matrixFrame->Center();
 	matrixFrame->Show(true);
@@ -496,7 +508,7 @@ void HomeFrame::BtnFutureCostSimilarityMatrixSelectClick(wxCommandEvent& e) {
 		// Save future cost matrix selected by user
 		string filePath = string(fileDialog->GetPath());
 		input.SetFutureCostFilePath(filePath);
-		input.SetFutureCost(ReadCSVFile(filePath));
+		input.SetFutureCost(SimilarityMatrix::Load(filePath, input.GetVideoFilePath()));
 
 		// Update UI elements
 		UpdateUI();
@@ -507,7 +519,7 @@ void HomeFrame::BtnFutureCostSimilarityMatrixSelectClick(wxCommandEvent& e) {
 
 // Event handler for display future cost similarity matrix button
 void HomeFrame::BtnFutureCostSimilarityMatrixViewClick(wxCommandEvent& e) {
-	MatrixFrame* matrixFrame = new MatrixFrame("Future Cost Similarity Matrix", input.GetVideoFilePath(), input.GetFutureCost().GetDistanceMatrix(), input.GetFutureCost().GetProbabilityMatrix(), "future");
+	MatrixFrame* matrixFrame = new MatrixFrame("Future Cost Similarity Matrix", input.GetVideoFilePath(), input.GetFutureCost().GetDenseDistanceMatrix(), input.GetFutureCost().GetProbabilityMatrix(), "future");
 	matrixFrame->SetClientSize(1010, 625);
 	matrixFrame->Center();
 	matrixFrame->Show(true);
@@ -545,27 +557,47 @@ void HomeFrame::BtnBeginSimilarityMeasureClick(wxCommandEvent& e) {
 
 	// Perform similarity measure
 	if (selection == 2) { // Motion
-		input.SetFutureCost(SimilarityMeasure::ComputeFutureCostSimilarityMatrix(input.GetVideoFilePath(), input.GetMotion()));
+		input.SetFutureCost(SimilarityMeasure::ComputeFutureCostSimilarityMatrix(input.GetVideoFilePath(), input.GetMotion(), input.GetConfig()));
 		wxLogStatus("SIMILARITY MEASURE: Future Cost Similarity Matrix Complete");
 		input.SetFilePaths("001");
 	}
 	else if (selection == 1) { // Euclidean
-		input.SetMotion(SimilarityMeasure::ComputeMotionSimilarityMatrix(input.GetVideoFilePath(), input.GetEuclidean()));
+		input.SetMotion(SimilarityMeasure::ComputeMotionSimilarityMatrix(input.GetVideoFilePath(), input.GetEuclidean(), input.GetConfig()));
 		wxLogStatus("SIMILARITY MEASURE: Motion Similarity Matrix Complete");
-		input.SetFutureCost(SimilarityMeasure::ComputeFutureCostSimilarityMatrix(input.GetVideoFilePath(), input.GetMotion()));
+		input.SetFutureCost(SimilarityMeasure::ComputeFutureCostSimilarityMatrix(input.GetVideoFilePath(), input.GetMotion(), input.GetConfig()));
 		wxLogStatus("SIMILARITY MEASURE: Future Cost Similarity Matrix Complete");
 		input.SetFilePaths("011");
 	}
+	else if (!input.GetFrameHashes().empty() && (input.GetMotion().GetFrameCount() > 0) && (input.GetFutureCost().GetFrameCount() > 0)) { // Video (previous version measured)
+		// Only pairs involving frames that changed since the last run are measured again (e.g. footage appended to the video)
+		int unchangedFrameCount = 0;
+		input.SetEuclidean(SimilarityMatrix());
+		input.SetMotion(SimilarityMeasure::UpdateMotionSimilarityMatrix(input.GetVideoFilePath(), input.GetMotion(), input.GetFrameHashes(), input.GetConfig(), &unchangedFrameCount));
+		wxLogStatus("SIMILARITY MEASURE: Euclidean & Motion Similarity Matrices Updated (%d unchanged frames)", unchangedFrameCount);
+		input.SetFutureCost(SimilarityMeasure::UpdateFutureCostSimilarityMatrix(input.GetVideoFilePath(), input.GetMotion(), input.GetFutureCost(), input.GetConfig()));
+		wxLogStatus("SIMILARITY MEASURE: Future Cost Similarity Matrix Updated");
+		input.SetFilePaths("111");
+	}
 	else { // Video
-		input.SetEuclidean(SimilarityMeasure::ComputeEuclideanSimilarityMatrix(input.GetVideoFilePath()));
-		wxLogStatus("SIMILARITY MEASURE: Euclidean Similarity Matrix Complete");
-		input.SetMotion(SimilarityMeasure::ComputeMotionSimilarityMatrix(input.GetVideoFilePath(), input.GetEuclidean()));
-		wxLogStatus("SIMILARITY MEASURE: Motion Similarity Matrix Complete");
-		input.SetFutureCost(SimilarityMeasure::ComputeFutureCostSimilarityMatrix(input.GetVideoFilePath(), input.GetMotion()));
+		// Euclidean distances are streamed straight into the motion filter (the Euclidean matrix is only computed if it is viewed)
+		input.SetEuclidean(SimilarityMatrix());
+		input.SetMotion(SimilarityMeasure::ComputeFusedMotionSimilarityMatrix(input.GetVideoFilePath(), input.GetConfig()));
+		wxLogStatus("SIMILARITY MEASURE: Euclidean & Motion Similarity Matrices Complete");
+		input.SetFutureCost(SimilarityMeasure::ComputeFutureCostSimilarityMatrix(input.GetVideoFilePath(), input.GetMotion(), input.GetConfig()));
 		wxLogStatus("SIMILARITY MEASURE: Future Cost Similarity Matrix Complete");
 		input.SetFilePaths("111");
 	}
-	wxLogStatus("SIMILARITY MEASURE: Finish");
+
+	// Frame hashes are kept for the next run if the frames were decoded (stages that all hit the cache decode nothing)
+	if (selection == 0) {
+		shared_ptr<FrameStore> frames = FrameStore::FindSharedStore(input.GetVideoFilePath());
+		input.SetFrameHashes(frames ? frames->GetFrameHashes() : vector<uint64_t>());
+	}
+
+	// Stages found in the similarity cache (same video and parameters as an earlier run) were not recomputed
+	CacheStatistics cacheStatistics = SimilarityCache::GetSharedCache().GetStatistics();
+	wxLogStatus("SIMILARITY MEASURE: Finish (cache: %lld hits, %lld misses, %d matrices, %llu MB)", cacheStatistics.hits, cacheStatistics.misses,
+				cacheStatistics.entryCount, (unsigned long long)(cacheStatistics.bytes / (1024 * 1024)));
 
 	// Update UI
 	this->FindWindowById(715)->SetBackgroundColour(*wxGREEN);
@@ -580,7 +612,7 @@ void HomeFrame::BtnBeginSynthesisClick(wxCommandEvent& e) {
 	int lengthMultiplier = wxDynamicCast(this->FindWindowById(808), wxChoice)->GetSelection();
 
 	// Create video texture
-	output.SetScheduledTransitions(Synthesis::GetTransitionSet(input.GetMotion().GetDistanceMatrix(), input.GetFutureCost().GetDistanceMatrix(), lengthMultiplier));
+	output.SetScheduledTransitions(Synthesis::GetTransitionSet(input.GetMotion(), input.GetFutureCost(), lengthMultiplier, input.GetConfig()));
 	output.SetVideoFilePath(Synthesis::CreateVideoTexture(input.GetVideoFilePath(), output.GetScheduledTransitions()));
 	wxLogStatus("SYNTHESIS: Finish");
 
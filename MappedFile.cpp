@@ -0,0 +1,209 @@
+#include "MappedFile.h"
+
+#if defined(_WIN32)
+	#define NOMINMAX
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+using namespace std;
+
+//--------------------------------------------------------------------------------------
+// MappedRegion
+//--------------------------------------------------------------------------------------
+
+MappedRegion::MappedRegion(void* base, size_t mappedLength, size_t offset, size_t length) {
+	this->base = base;
+	this->mappedLength = mappedLength;
+	this->data = static_cast<unsigned char*>(base) + offset;
+	this->length = length;
+}
+
+MappedRegion::~MappedRegion() {
+#if defined(_WIN32)
+	UnmapViewOfFile(base);
+#else
+	munmap(base, mappedLength);
+#endif
+}
+
+unsigned char* MappedRegion::GetData() {
+	return data;
+}
+
+size_t MappedRegion::GetLength() {
+	return length;
+}
+
+//--------------------------------------------------------------------------------------
+// Constructors
+//--------------------------------------------------------------------------------------
+
+MappedFile::MappedFile() {
+	size = 0;
+	writable = false;
+	copyOnWrite = false;
+#if defined(_WIN32)
+	fileHandle = INVALID_HANDLE_VALUE;
+	mappingHandle = NULL;
+#else
+	fileDescriptor = -1;
+#endif
+}
+
+MappedFile::~MappedFile() {
+	Close();
+}
+
+//--------------------------------------------------------------------------------------
+// Getters & Setters
+//--------------------------------------------------------------------------------------
+
+uint64_t MappedFile::GetSize() {
+	return size;
+}
+
+//--------------------------------------------------------------------------------------
+// Instance Methods (Public)
+//--------------------------------------------------------------------------------------
+
+// Opens an existing file for mapping
+bool MappedFile::Open(string filePath, bool writable, bool copyOnWrite) {
+	// Parameters:
+	// - filePath: file to open
+	// - writable: changes made through mapped regions are written to the file
+	// - copyOnWrite: mapped regions can be modified, but changes stay private to this process (file is opened read-only)
+
+	Close();
+	this->writable = writable && !copyOnWrite;
+	this->copyOnWrite = copyOnWrite;
+
+#if defined(_WIN32)
+	DWORD access = this->writable ? (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ;
+	fileHandle = CreateFileA(filePath.c_str(), access, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	GetFileSizeEx(fileHandle, &fileSize);
+	size = uint64_t(fileSize.QuadPart);
+
+	if (size > 0)
+		mappingHandle = CreateFileMappingA(fileHandle, NULL, copyOnWrite ? PAGE_WRITECOPY : (this->writable ? PAGE_READWRITE : PAGE_READONLY), 0, 0, NULL);
+#else
+	fileDescriptor = open(filePath.c_str(), this->writable ? O_RDWR : O_RDONLY);
+	if (fileDescriptor < 0)
+		return false;
+
+	struct stat status;
+	fstat(fileDescriptor, &status);
+	size = uint64_t(status.st_size);
+#endif
+
+	return true;
+}
+
+// Creates (or truncates) a file of the specified size for mapping
+bool MappedFile::Create(string filePath, uint64_t size) {
+	Close();
+	writable = true;
+	copyOnWrite = false;
+
+#if defined(_WIN32)
+	fileHandle = CreateFileA(filePath.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	fileSize.QuadPart = LONGLONG(size);
+	if (!SetFilePointerEx(fileHandle, fileSize, NULL, FILE_BEGIN) || !SetEndOfFile(fileHandle)) {
+		Close();
+		return false;
+	}
+
+	if (size > 0)
+		mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READWRITE, 0, 0, NULL);
+#else
+	fileDescriptor = open(filePath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fileDescriptor < 0)
+		return false;
+
+	if (ftruncate(fileDescriptor, off_t(size)) != 0) {
+		Close();
+		return false;
+	}
+#endif
+
+	this->size = size;
+	return true;
+}
+
+// Closes the file (regions that are still mapped remain valid)
+void MappedFile::Close() {
+#if defined(_WIN32)
+	if (mappingHandle != NULL)
+		CloseHandle(mappingHandle);
+	if (fileHandle != INVALID_HANDLE_VALUE)
+		CloseHandle(fileHandle);
+	mappingHandle = NULL;
+	fileHandle = INVALID_HANDLE_VALUE;
+#else
+	if (fileDescriptor >= 0)
+		close(fileDescriptor);
+	fileDescriptor = -1;
+#endif
+	size = 0;
+}
+
+// Checks if a file is open
+bool MappedFile::IsOpen() {
+#if defined(_WIN32)
+	return (fileHandle != INVALID_HANDLE_VALUE);
+#else
+	return (fileDescriptor >= 0);
+#endif
+}
+
+// Maps bytes [offset, offset + length) of the file into memory (returns NULL on failure)
+shared_ptr<MappedRegion> MappedFile::MapRegion(uint64_t offset, size_t length) {
+	if (!IsOpen() || (length == 0) || (offset + length > size))
+		return NULL;
+
+	// Mappings must start on an allocation boundary - map from the boundary below and offset the data pointer
+	uint64_t alignedOffset = offset - (offset % GetAllocationGranularity());
+	size_t mappedLength = size_t(offset - alignedOffset) + length;
+
+#if defined(_WIN32)
+	if (mappingHandle == NULL)
+		return NULL;
+
+	void* base = MapViewOfFile(mappingHandle, copyOnWrite ? FILE_MAP_COPY : (writable ? (FILE_MAP_READ | FILE_MAP_WRITE) : FILE_MAP_READ), DWORD(alignedOffset >> 32), DWORD(alignedOffset & 0xFFFFFFFF), mappedLength);
+	if (base == NULL)
+		return NULL;
+#else
+	void* base = mmap(NULL, mappedLength, (writable || copyOnWrite) ? (PROT_READ | PROT_WRITE) : PROT_READ, copyOnWrite ? MAP_PRIVATE : MAP_SHARED, fileDescriptor, off_t(alignedOffset));
+	if (base == MAP_FAILED)
+		return NULL;
+#endif
+
+	return make_shared<MappedRegion>(base, mappedLength, size_t(offset - alignedOffset), length);
+}
+
+//--------------------------------------------------------------------------------------
+// Static Methods (Private)
+//--------------------------------------------------------------------------------------
+
+// Returns boundary that mapped regions must start on
+uint64_t MappedFile::GetAllocationGranularity() {
+#if defined(_WIN32)
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return uint64_t(info.dwAllocationGranularity);
+#else
+	return uint64_t(sysconf(_SC_PAGESIZE));
+#endif
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+
+using namespace std;
+
+// MappedRegion
+// - A view of part of a memory-mapped file (unmapped when the last reference is released)
+
+class MappedRegion {
+	public:
+		// Constructors
+		MappedRegion(void* base, size_t mappedLength, size_t offset, size_t length);
+		~MappedRegion();
+
+		// Getters & Setters
+		unsigned char* GetData();
+		size_t GetLength();
+
+	private:
+		// Parameters
+		void* base;
+		size_t mappedLength;
+		unsigned char* data;
+		size_t length;
+};
+
+// MappedFile
+// - Opens or creates a file and maps regions of it into memory (Windows and POSIX)
+
+class MappedFile {
+	public:
+		// Constructors
+		MappedFile();
+		~MappedFile();
+
+		// Getters & Setters
+		uint64_t GetSize();
+
+		// Instance Methods
+		bool Open(string filePath, bool writable = false, bool copyOnWrite = false);
+		bool Create(string filePath, uint64_t size);
+		void Close();
+		bool IsOpen();
+		shared_ptr<MappedRegion> MapRegion(uint64_t offset, size_t length);
+
+	private:
+		// Parameters
+		uint64_t size;
+		bool writable;
+		bool copyOnWrite;
+#if defined(_WIN32)
+		void* fileHandle;
+		void* mappingHandle;
+#else
+		int fileDescriptor;
+#endif
+
+		// Static Methods
+		static uint64_t GetAllocationGranularity();
+};
@@ -0,0 +1,164 @@
+#include "MatrixFile.h"
+#include <cstring>
+#include <fstream>
+
+using namespace cv;
+using namespace std;
+
+// File header (little-endian, padded to HEADER_BYTES - data follows immediately, so it is aligned for any element type)
+struct MatrixFileHeader {
+	uint32_t magic;
+	uint32_t version;
+	int32_t rows;
+	int32_t cols;
+	int32_t type;
+	uint32_t reserved;
+	uint64_t dataBytes;
+	uint64_t checksum;
+	uint64_t videoFingerprint;
+};
+
+//--------------------------------------------------------------------------------------
+// Static Methods (Public)
+//--------------------------------------------------------------------------------------
+
+// Saves matrix to a binary matrix file
+bool MatrixFile::Save(string filePath, Mat matrix, string videoFilePath) {
+	// Parameters:
+	// - filePath: file path to save to
+	// - matrix: matrix to save (any element type)
+	// - videoFilePath: video the matrix was computed from (fingerprinted so the matrix can be checked against the video when reloaded)
+
+	if (matrix.empty())
+		return false;
+
+	if (!matrix.isContinuous())
+		matrix = matrix.clone();
+
+	MatrixFileHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = MAGIC;
+	header.version = VERSION;
+	header.rows = matrix.rows;
+	header.cols = matrix.cols;
+	header.type = matrix.type();
+	header.dataBytes = uint64_t(matrix.total() * matrix.elemSize());
+	header.checksum = ComputeChecksum(matrix.data, size_t(header.dataBytes));
+	header.videoFingerprint = videoFilePath.empty() ? 0 : GetVideoFingerprint(videoFilePath);
+
+	char headerBytes[HEADER_BYTES] = {};
+	memcpy(headerBytes, &header, sizeof(header));
+
+	ofstream output(filePath, ios::binary | ios::trunc);
+	output.write(headerBytes, HEADER_BYTES);
+	output.write(reinterpret_cast<const char*>(matrix.data), streamsize(header.dataBytes));
+	output.close();
+
+	return !output.fail();
+}
+
+// Loads matrix from a binary matrix file - returns a Mat header into the mapped file (empty if invalid)
+Mat MatrixFile::Load(string filePath, shared_ptr<MappedRegion>& mapping, string videoFilePath, bool verifyChecksum) {
+	// Parameters:
+	// - filePath: file path to load from
+	// - mapping: receives the mapped view backing the returned Mat (the Mat is only valid while this is held)
+	// - videoFilePath: if set, the matrix is rejected unless it was computed from this video
+	// - verifyChecksum: checks the data against the stored checksum (reads the whole file)
+
+	mapping.reset();
+
+	// Modifications to the returned matrix stay private to the process (copy-on-write), the file is never changed
+	MappedFile file;
+	if (!file.Open(filePath, false, true) || (file.GetSize() < HEADER_BYTES))
+		return Mat();
+
+	shared_ptr<MappedRegion> region = file.MapRegion(0, size_t(file.GetSize()));
+	if (!region)
+		return Mat();
+
+	MatrixFileHeader header;
+	memcpy(&header, region->GetData(), sizeof(header));
+
+	if ((header.magic != MAGIC) || (header.version != VERSION) || (header.rows <= 0) || (header.cols <= 0))
+		return Mat();
+
+	if ((header.dataBytes != uint64_t(header.rows) * header.cols * CV_ELEM_SIZE(header.type)) || (file.GetSize() < HEADER_BYTES + header.dataBytes))
+		return Mat();
+
+	unsigned char* data = region->GetData() + HEADER_BYTES;
+
+	if (verifyChecksum && (ComputeChecksum(data, size_t(header.dataBytes)) != header.checksum))
+		return Mat();
+
+	if (!videoFilePath.empty() && (header.videoFingerprint != 0) && (header.videoFingerprint != GetVideoFingerprint(videoFilePath)))
+		return Mat();
+
+	mapping = region;
+	return Mat(header.rows, header.cols, header.type, data);
+}
+
+// Checks if file is a binary matrix file (rather than e.g. CSV)
+bool MatrixFile::IsMatrixFile(string filePath) {
+	ifstream input(filePath, ios::binary);
+	uint32_t magic = 0;
+	input.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+
+	return (input.gcount() == sizeof(magic)) && (magic == MAGIC);
+}
+
+// Returns a fingerprint of a video file (hash of its size, its first and last bytes and blocks sampled evenly in between - cheap, but
+// changes if the video is re-encoded, including in place edits that keep its size)
+uint64_t MatrixFile::GetVideoFingerprint(string videoFilePath) {
+	ifstream input(videoFilePath, ios::binary | ios::ate);
+	if (!input.is_open())
+		return 0;
+
+	uint64_t size = uint64_t(input.tellg());
+	uint64_t fingerprint = ComputeChecksum(reinterpret_cast<const unsigned char*>(&size), sizeof(size));
+	vector<char> buffer(FINGERPRINT_BYTES);
+
+	input.seekg(0);
+	input.read(buffer.data(), streamsize(buffer.size()));
+	fingerprint = ComputeChecksum(reinterpret_cast<const unsigned char*>(buffer.data()), size_t(input.gcount()), fingerprint);
+
+	if (size > FINGERPRINT_BYTES) {
+		input.clear();
+		input.seekg(streamoff(size - min(size - FINGERPRINT_BYTES, uint64_t(FINGERPRINT_BYTES))));
+		input.read(buffer.data(), streamsize(buffer.size()));
+		fingerprint = ComputeChecksum(reinterpret_cast<const unsigned char*>(buffer.data()), size_t(input.gcount()), fingerprint);
+	}
+
+	// Blocks sampled evenly between the first and last bytes
+	if (size > 2 * FINGERPRINT_BYTES) {
+		uint64_t middleBytes = size - 2 * FINGERPRINT_BYTES;
+
+		for (int s = 0; s < FINGERPRINT_SAMPLES; s++) {
+			uint64_t offset = FINGERPRINT_BYTES + (middleBytes * s) / FINGERPRINT_SAMPLES;
+
+			input.clear();
+			input.seekg(streamoff(offset));
+			input.read(buffer.data(), streamsize(min(uint64_t(FINGERPRINT_SAMPLE_BYTES), middleBytes)));
+			fingerprint = ComputeChecksum(reinterpret_cast<const unsigned char*>(buffer.data()), size_t(input.gcount()), fingerprint);
+		}
+	}
+
+	return fingerprint;
+}
+
+// Computes 64-bit FNV-1a hash of data (eight bytes per step, then the remaining bytes)
+uint64_t MatrixFile::ComputeChecksum(const unsigned char* data, size_t bytes, uint64_t seed) {
+	const uint64_t prime = 0x100000001B3ULL;
+	uint64_t hash = (seed != 0) ? seed : 0xCBF29CE484222325ULL;
+	size_t k = 0;
+
+	for (; k + sizeof(uint64_t) <= bytes; k += sizeof(uint64_t)) {
+		uint64_t word;
+		memcpy(&word, data + k, sizeof(word));
+		hash = (hash ^ word) * prime;
+	}
+
+	for (; k < bytes; k++)
+		hash = (hash ^ data[k]) * prime;
+
+	return hash;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include "MappedFile.h"
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+using namespace std;
+
+// MatrixFile
+// - Reads and writes matrices in a versioned binary format (replaces CSV for saving/reloading similarity matrices)
+// - Header holds the dimensions, element type, a checksum of the data and a fingerprint of the source video
+// - Matrices are written with a single bulk write and loaded zero-copy (the returned Mat points into a memory-mapped view of the file)
+
+class MatrixFile {
+	public:
+		// Static Methods
+		static bool Save(string filePath, cv::Mat matrix, string videoFilePath = "");
+		static cv::Mat Load(string filePath, shared_ptr<MappedRegion>& mapping, string videoFilePath = "", bool verifyChecksum = true);
+		static bool IsMatrixFile(string filePath);
+		static uint64_t GetVideoFingerprint(string videoFilePath);
+		static uint64_t ComputeChecksum(const unsigned char* data, size_t bytes, uint64_t seed = 0);
+
+	private:
+		// Static Parameters
+		static const uint32_t MAGIC = 0x584D5456;	// "VTMX"
+		static const uint32_t VERSION = 1;
+		static const size_t HEADER_BYTES = 64;
+		static const size_t FINGERPRINT_BYTES = 64 * 1024;
+		static const int FINGERPRINT_SAMPLES = 32;
+		static const size_t FINGERPRINT_SAMPLE_BYTES = 4 * 1024;
+};
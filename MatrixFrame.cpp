@@ -1,8 +1,11 @@
 #include "MatrixFrame.h"
 #include "HomeFrame.h"
+#include "FrameStore.h"
+#include "ArtifactExporter.h"
 #include "Utilities.cpp"
 #include <wx/notebook.h>
 #include <wx/image.h>
+#include <cfloat>
 
 using namespace cv;
 using namespace std;
@@ -39,6 +42,9 @@ MatrixFrame::MatrixFrame(const wxString& title, string videoFilePath, Mat distan
 	tabs->AddPage(distanceImagePanel, wxT("Distance Image"));
 	tabs->AddPage(probabilityImagePanel, wxT("Probability Image"));
 
+	// Image files of the matrix are written once it has been viewed (if they were not already exported during the run)
+	ArtifactExporter::GetSharedExporter().ExportDeferred(videoFilePath, type, ARTIFACT_IMAGE);
+
 	CreateStatusBar();
 }
 
@@ -110,8 +116,9 @@ void MatrixFrame::BuildMatrixPanel(wxPanel* parent, cv::Mat mat) {
 
 // Displays input matrix as clickable image
 void MatrixFrame::BuildImagePanel(wxPanel* parent, cv::Mat mat) {
-	Mat image;
-	normalize(mat, image, 0, 255, NORM_MINMAX, CV_8UC1);
+	// Rejected pairs (+inf) are drawn as the largest distance
+	Mat image(mat.size(), CV_8UC1, Scalar(255));
+	normalize(mat, image, 0, 255, NORM_MINMAX, CV_8UC1, mat < FLT_MAX);
 
 	// Create grid
 	wxGrid* imageGrid = new wxGrid(parent, wxID_ANY, wxPoint(0, 0), wxSize(1000, 600));
@@ -152,27 +159,24 @@ void MatrixFrame::MatrixCellClick(wxGridEvent& e) {
 		int row = e.GetRow() + offset;
 
 		wxLogStatus(this, "Cell (%d, %d) clicked", col, row);
-		VideoCapture inputVideo(GetVideoFilePath());
+
+		// Frames are served from the decoded store (decoded on first click, then shared with synthesis/rendering)
+		shared_ptr<FrameStore> frames = FrameStore::GetSharedStore(GetVideoFilePath());
 
 		// Show frames
-		if (!inputVideo.isOpened())
+		if (!frames->IsLoaded())
 			wxLogStatus(this, "ERROR: Cannot open video file");
 		else {
-			Mat frame1, frame2;
-			bool success;
-
 			// Frame 1
-			inputVideo.set(1, col);
-			success = inputVideo.read(frame1);
-			if (success)
+			Mat frame1 = frames->GetFrame(col);
+			if (!frame1.empty())
 				imshow("Frame " + ToStr(col), frame1);
 			else
 				wxLogStatus(this, "Error opening frame %d", col);
 
 			// Frame 2
-			inputVideo.set(1, row);
-			success = inputVideo.read(frame2);
-			if (success)
+			Mat frame2 = frames->GetFrame(row);
+			if (!frame2.empty())
 				imshow("Frame " + ToStr(row), frame2);
 			else
 				wxLogStatus(this, "Error opening frame %d", row);
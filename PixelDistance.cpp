@@ -0,0 +1,258 @@
+#include "PixelDistance.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+	#define PIXEL_DISTANCE_X86
+	#include <immintrin.h>
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+		#define TARGET_SSE41
+		#define TARGET_AVX2
+		#define TARGET_AVX512
+	#else
+		#define TARGET_SSE41 __attribute__((target("sse4.1")))
+		#define TARGET_AVX2 __attribute__((target("avx2")))
+		#define TARGET_AVX512 __attribute__((target("avx512f,avx512bw")))
+	#endif
+#endif
+
+using namespace cv;
+using namespace std;
+
+// Vector iterations between flushes of the 32-bit lane accumulators into the 64-bit total
+// (each lane gains at most 4 * 255^2 per iteration, so 8192 iterations stays below 2^32)
+static const size_t FLUSH_ITERATIONS = 8192;
+
+// Instruction sets in order of preference
+enum class InstructionSet { Scalar, SSE41, AVX2, AVX512 };
+
+// Detects the best instruction set supported by both the CPU and the operating system
+static InstructionSet DetectInstructionSet() {
+#if defined(PIXEL_DISTANCE_X86)
+	#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		int highestLeaf = info[0];
+
+		__cpuid(info, 1);
+		bool sse41 = (info[2] & (1 << 19)) != 0;
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+		bool avxState = (xcr0 & 0x6) == 0x6;
+		bool avx512State = (xcr0 & 0xE6) == 0xE6;
+
+		bool avx2 = false, avx512 = false;
+		if (highestLeaf >= 7) {
+			__cpuidex(info, 7, 0);
+			avx2 = avxState && ((info[1] & (1 << 5)) != 0);
+			avx512 = avx512State && ((info[1] & (1 << 16)) != 0) && ((info[1] & (1 << 30)) != 0);
+		}
+	#else
+		__builtin_cpu_init();
+		bool sse41 = __builtin_cpu_supports("sse4.1");
+		bool avx2 = __builtin_cpu_supports("avx2");
+		bool avx512 = __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+	#endif
+
+	if (avx512)
+		return InstructionSet::AVX512;
+	if (avx2)
+		return InstructionSet::AVX2;
+	if (sse41)
+		return InstructionSet::SSE41;
+#endif
+
+	return InstructionSet::Scalar;
+}
+
+static const InstructionSet instructionSet = DetectInstructionSet();
+
+//--------------------------------------------------------------------------------------
+// Static Methods (Public)
+//--------------------------------------------------------------------------------------
+
+// Returns sum of squared differences between two buffers
+uint64_t PixelDistance::SquaredL2(const uchar* a, const uchar* b, size_t length) {
+	switch (instructionSet) {
+		case InstructionSet::AVX512:
+			return SquaredL2AVX512(a, b, length);
+		case InstructionSet::AVX2:
+			return SquaredL2AVX2(a, b, length);
+		case InstructionSet::SSE41:
+			return SquaredL2SSE41(a, b, length);
+		default:
+			return SquaredL2Scalar(a, b, length);
+	}
+}
+
+// Returns sum of squared differences, stopping once it reaches bound (a result >= bound is then only a partial sum, but the full sum
+// is known to be at least bound)
+uint64_t PixelDistance::SquaredL2Bounded(const uchar* a, const uchar* b, size_t length, uint64_t bound) {
+	uint64_t total = 0;
+
+	for (size_t offset = 0; (offset < length) && (total < bound); offset += BOUNDED_CHUNK_BYTES)
+		total += SquaredL2(a + offset, b + offset, min(length - offset, size_t(BOUNDED_CHUNK_BYTES)));
+
+	return total;
+}
+
+// Returns name of the instruction set selected at runtime
+string PixelDistance::GetInstructionSet() {
+	switch (instructionSet) {
+		case InstructionSet::AVX512:
+			return "AVX-512";
+		case InstructionSet::AVX2:
+			return "AVX2";
+		case InstructionSet::SSE41:
+			return "SSE4.1";
+		default:
+			return "Scalar";
+	}
+}
+
+// Checks that the kernel matches cv::norm exactly for a pair of frames
+bool PixelDistance::CheckExactness(Mat frame1, Mat frame2) {
+	if ((frame1.size() != frame2.size()) || (frame1.type() != frame2.type()) || (frame1.depth() != CV_8U))
+		return false;
+
+	Mat a = frame1.isContinuous() ? frame1 : frame1.clone();
+	Mat b = frame2.isContinuous() ? frame2 : frame2.clone();
+	size_t length = a.total() * a.elemSize();
+
+	double reference = norm(a, b, NORM_L2SQR);
+
+	// Every variant the CPU supports must agree with the reference
+	bool exact = (double(SquaredL2Scalar(a.data, b.data, length)) == reference);
+	if (instructionSet >= InstructionSet::SSE41)
+		exact = exact && (double(SquaredL2SSE41(a.data, b.data, length)) == reference);
+	if (instructionSet >= InstructionSet::AVX2)
+		exact = exact && (double(SquaredL2AVX2(a.data, b.data, length)) == reference);
+	if (instructionSet >= InstructionSet::AVX512)
+		exact = exact && (double(SquaredL2AVX512(a.data, b.data, length)) == reference);
+
+	return exact;
+}
+
+//--------------------------------------------------------------------------------------
+// Static Methods (Private)
+//--------------------------------------------------------------------------------------
+
+// Reference implementation (also handles the tail of the vector implementations)
+uint64_t PixelDistance::SquaredL2Scalar(const uchar* a, const uchar* b, size_t length) {
+	uint64_t total = 0;
+
+	for (size_t i = 0; i < length; i++) {
+		int difference = int(a[i]) - int(b[i]);
+		total += uint64_t(difference * difference);
+	}
+
+	return total;
+}
+
+#if defined(PIXEL_DISTANCE_X86)
+
+// 16 pixels per iteration: |a - b| as unsigned bytes, widened to 16-bit, then squared and pairwise summed into 32-bit lanes
+TARGET_SSE41 uint64_t PixelDistance::SquaredL2SSE41(const uchar* a, const uchar* b, size_t length) {
+	uint64_t total = 0;
+	size_t i = 0;
+
+	while (i + 16 <= length) {
+		__m128i accumulator = _mm_setzero_si128();
+		size_t end = min(length - (length - i) % 16, i + (FLUSH_ITERATIONS * 16));
+
+		for (; i < end; i += 16) {
+			__m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+			__m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+			__m128i difference = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+
+			__m128i low = _mm_cvtepu8_epi16(difference);
+			__m128i high = _mm_cvtepu8_epi16(_mm_srli_si128(difference, 8));
+			accumulator = _mm_add_epi32(accumulator, _mm_madd_epi16(low, low));
+			accumulator = _mm_add_epi32(accumulator, _mm_madd_epi16(high, high));
+		}
+
+		alignas(16) uint32_t lanes[4];
+		_mm_store_si128((__m128i*)lanes, accumulator);
+		for (uint32_t lane : lanes)
+			total += lane;
+	}
+
+	return total + SquaredL2Scalar(a + i, b + i, length - i);
+}
+
+// 32 pixels per iteration (as SSE4.1, with 256-bit registers)
+TARGET_AVX2 uint64_t PixelDistance::SquaredL2AVX2(const uchar* a, const uchar* b, size_t length) {
+	uint64_t total = 0;
+	size_t i = 0;
+	__m256i zero = _mm256_setzero_si256();
+
+	while (i + 32 <= length) {
+		__m256i accumulator = _mm256_setzero_si256();
+		size_t end = min(length - (length - i) % 32, i + (FLUSH_ITERATIONS * 32));
+
+		for (; i < end; i += 32) {
+			__m256i va = _mm256_loadu_si256((const __m256i*)(a + i));
+			__m256i vb = _mm256_loadu_si256((const __m256i*)(b + i));
+			__m256i difference = _mm256_or_si256(_mm256_subs_epu8(va, vb), _mm256_subs_epu8(vb, va));
+
+			// Unpacking interleaves within 128-bit lanes - pixel order is irrelevant for the sum
+			__m256i low = _mm256_unpacklo_epi8(difference, zero);
+			__m256i high = _mm256_unpackhi_epi8(difference, zero);
+			accumulator = _mm256_add_epi32(accumulator, _mm256_madd_epi16(low, low));
+			accumulator = _mm256_add_epi32(accumulator, _mm256_madd_epi16(high, high));
+		}
+
+		alignas(32) uint32_t lanes[8];
+		_mm256_store_si256((__m256i*)lanes, accumulator);
+		for (uint32_t lane : lanes)
+			total += lane;
+	}
+
+	return total + SquaredL2Scalar(a + i, b + i, length - i);
+}
+
+// 64 pixels per iteration (as SSE4.1, with 512-bit registers)
+TARGET_AVX512 uint64_t PixelDistance::SquaredL2AVX512(const uchar* a, const uchar* b, size_t length) {
+	uint64_t total = 0;
+	size_t i = 0;
+	__m512i zero = _mm512_setzero_si512();
+
+	while (i + 64 <= length) {
+		__m512i accumulator = _mm512_setzero_si512();
+		size_t end = min(length - (length - i) % 64, i + (FLUSH_ITERATIONS * 64));
+
+		for (; i < end; i += 64) {
+			__m512i va = _mm512_loadu_si512((const void*)(a + i));
+			__m512i vb = _mm512_loadu_si512((const void*)(b + i));
+			__m512i difference = _mm512_or_si512(_mm512_subs_epu8(va, vb), _mm512_subs_epu8(vb, va));
+
+			__m512i low = _mm512_unpacklo_epi8(difference, zero);
+			__m512i high = _mm512_unpackhi_epi8(difference, zero);
+			accumulator = _mm512_add_epi32(accumulator, _mm512_madd_epi16(low, low));
+			accumulator = _mm512_add_epi32(accumulator, _mm512_madd_epi16(high, high));
+		}
+
+		alignas(64) uint32_t lanes[16];
+		_mm512_store_si512((void*)lanes, accumulator);
+		for (uint32_t lane : lanes)
+			total += lane;
+	}
+
+	return total + SquaredL2Scalar(a + i, b + i, length - i);
+}
+
+#else
+
+// Vector variants are never selected on other architectures
+uint64_t PixelDistance::SquaredL2SSE41(const uchar* a, const uchar* b, size_t length) {
+	return SquaredL2Scalar(a, b, length);
+}
+
+uint64_t PixelDistance::SquaredL2AVX2(const uchar* a, const uchar* b, size_t length) {
+	return SquaredL2Scalar(a, b, length);
+}
+
+uint64_t PixelDistance::SquaredL2AVX512(const uchar* a, const uchar* b, size_t length) {
+	return SquaredL2Scalar(a, b, length);
+}
+
+#endif
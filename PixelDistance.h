@@ -0,0 +1,30 @@
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <string>
+
+using namespace std;
+
+// PixelDistance
+// - Computes the squared Euclidean distance between two buffers of packed 8-bit pixels
+// - The best available instruction set (scalar, SSE4.1, AVX2 or AVX-512) is selected at runtime
+// - A bounded variant sums in chunks and stops as soon as the distance is known to exceed a bound (e.g. the K-th best so far)
+
+class PixelDistance {
+	public:
+		// Static Methods
+		static uint64_t SquaredL2(const uchar* a, const uchar* b, size_t length);
+		static uint64_t SquaredL2Bounded(const uchar* a, const uchar* b, size_t length, uint64_t bound);
+		static string GetInstructionSet();
+		static bool CheckExactness(cv::Mat frame1, cv::Mat frame2);
+
+	private:
+		// Static Parameters
+		static const size_t BOUNDED_CHUNK_BYTES = 4096;
+
+		// Static Methods
+		static uint64_t SquaredL2Scalar(const uchar* a, const uchar* b, size_t length);
+		static uint64_t SquaredL2SSE41(const uchar* a, const uchar* b, size_t length);
+		static uint64_t SquaredL2AVX2(const uchar* a, const uchar* b, size_t length);
+		static uint64_t SquaredL2AVX512(const uchar* a, const uchar* b, size_t length);
+};
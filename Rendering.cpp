@@ -1,4 +1,5 @@
 #include "Rendering.h"
+#include "FrameStore.h"
 
 using namespace cv;
 
@@ -14,13 +15,13 @@ string Rendering::CreateVideoTextureWithCrossFading(string inputVideoFilePath, C
 	// Get sequence of frames
 	vector<vector<int>> sequencesOfFrames = GetFrameSequence(transitions);
 
-	// Write sequence of frames to video
-	VideoCapture inputVideo(inputVideoFilePath);
+	// Write sequence of frames to video (frames are served from the decoded store rather than seeking)
+	shared_ptr<FrameStore> frames = FrameStore::GetSharedStore(inputVideoFilePath);
 
 	string outputVideoFilePath = ComputeOutputFilePath(inputVideoFilePath);
-	VideoWriter outputVideo(outputVideoFilePath, inputVideo.get(CAP_PROP_FOURCC), inputVideo.get(CAP_PROP_FPS), Size2i(inputVideo.get(CAP_PROP_FRAME_WIDTH), inputVideo.get(CAP_PROP_FRAME_HEIGHT)));
+	VideoWriter outputVideo(outputVideoFilePath, frames->GetFourCC(), frames->GetFPS(), frames->GetFrameSize());
 
-	if (inputVideo.isOpened() && outputVideo.isOpened()) {
+	if (frames->IsLoaded() && outputVideo.isOpened()) {
 
 		for (int i = 0; i < sequencesOfFrames.size(); i++) {
 			for (int j = windowSizeSplit; j < sequencesOfFrames[i].size(); j++) {
@@ -33,15 +34,11 @@ string Rendering::CreateVideoTextureWithCrossFading(string inputVideoFilePath, C
 
 					// Get frame pairs
 					for (int k = 0; k < windowSize; k++) {
-						Mat frame1, frame2;
+						Mat frame1 = frames->GetFrame(sequencesOfFrames[i][j] + k);
+						if (frame1.empty()) break;
 
-						inputVideo.set(1, sequencesOfFrames[i][j] + k);
-						bool success = inputVideo.read(frame1);
-						if (!success) break;
-
-						inputVideo.set(1, sequencesOfFrames[nextSequence][k] - windowSizeSplit - 1);
-						success = inputVideo.read(frame2);
-						if (!success) break;
+						Mat frame2 = frames->GetFrame(sequencesOfFrames[nextSequence][k] - windowSizeSplit - 1);
+						if (frame2.empty()) break;
 
 						// Get new frame via cross-fading
 						double weight = (k + 1) / (windowSize + 1.0);
@@ -52,11 +49,8 @@ string Rendering::CreateVideoTextureWithCrossFading(string inputVideoFilePath, C
 					break;
 				}
 				else {
-					Mat frame;
-
-					inputVideo.set(1, sequencesOfFrames[i][j]);
-					bool success = inputVideo.read(frame);
-					if (!success) break;
+					Mat frame = frames->GetFrame(sequencesOfFrames[i][j]);
+					if (frame.empty()) break;
 
 					outputVideo << frame;
 				}
@@ -75,13 +69,13 @@ string Rendering::CreateVideoTextureWithMorphing(string inputVideoFilePath, Comp
 	// Get sequence of frames
 	vector<vector<int>> sequencesOfFrames = GetFrameSequence(transitions);
 
-	// Write sequence of frames to video
-	VideoCapture inputVideo(inputVideoFilePath);
+	// Write sequence of frames to video (frames are served from the decoded store rather than seeking)
+	shared_ptr<FrameStore> frames = FrameStore::GetSharedStore(inputVideoFilePath);
 
 	string outputVideoFilePath = ComputeOutputFilePath(inputVideoFilePath);
-	VideoWriter outputVideo(outputVideoFilePath, inputVideo.get(CAP_PROP_FOURCC), inputVideo.get(CAP_PROP_FPS), Size2i(inputVideo.get(CAP_PROP_FRAME_WIDTH), inputVideo.get(CAP_PROP_FRAME_HEIGHT)));
+	VideoWriter outputVideo(outputVideoFilePath, frames->GetFourCC(), frames->GetFPS(), frames->GetFrameSize());
 
-	if (inputVideo.isOpened() && outputVideo.isOpened()) {
+	if (frames->IsLoaded() && outputVideo.isOpened()) {
 
 		for (int i = 0; i < sequencesOfFrames.size(); i++) {
 			for (int j = 1; j < sequencesOfFrames[i].size(); j++) {
@@ -95,13 +89,11 @@ string Rendering::CreateVideoTextureWithMorphing(string inputVideoFilePath, Comp
 					// Get transition frames
 					Mat prev, prevGrey, current, currentGrey, opticalFlow, newFrame;
 
-					inputVideo.set(1, sequencesOfFrames[i][j]);
-					bool success = inputVideo.read(prev);
-					if (!success) break;
+					prev = frames->GetFrame(sequencesOfFrames[i][j]);
+					if (prev.empty()) break;
 
-					inputVideo.set(1, sequencesOfFrames[nextSequence][0]);
-					success = inputVideo.read(current);
-					if (!success) break;
+					current = frames->GetFrame(sequencesOfFrames[nextSequence][0]);
+					if (current.empty()) break;
 
 					// Compute optical flow between frames
 					cvtColor(prev, prevGrey, COLOR_BGR2GRAY);
@@ -136,11 +128,8 @@ string Rendering::CreateVideoTextureWithMorphing(string inputVideoFilePath, Comp
 					outputVideo << current;
 				}
 				else {
-					Mat frame;
-
-					inputVideo.set(1, sequencesOfFrames[i][j]);
-					bool success = inputVideo.read(frame);
-					if (!success) break;
+					Mat frame = frames->GetFrame(sequencesOfFrames[i][j]);
+					if (frame.empty()) break;
 
 					outputVideo << frame;
 				}
@@ -0,0 +1,348 @@
+#include "SimilarityCache.h"
+#include "MatrixFile.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <thread>
+
+#if defined(_WIN32)
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace cv;
+using namespace std;
+
+//--------------------------------------------------------------------------------------
+// Constructors
+//--------------------------------------------------------------------------------------
+
+SimilarityCache::SimilarityCache(string directory, uint64_t byteBudget) {
+	// Parameters:
+	// - directory: directory the cached matrices are stored in (created when the first matrix is inserted)
+	// - byteBudget: size the cache is kept within (least recently used matrices are evicted beyond it)
+
+	this->directory = directory;
+	enabled = true;
+	scanned = false;
+	useCounter = 0;
+	statistics.byteBudget = byteBudget;
+}
+
+//--------------------------------------------------------------------------------------
+// Getters & Setters
+//--------------------------------------------------------------------------------------
+
+string SimilarityCache::GetDirectory() {
+	return directory;
+}
+
+uint64_t SimilarityCache::GetByteBudget() {
+	lock_guard<mutex> lock(entriesMutex);
+	return statistics.byteBudget;
+}
+
+// Sets the size budget (evicts immediately if the cache is now over it)
+void SimilarityCache::SetByteBudget(uint64_t byteBudget) {
+	lock_guard<mutex> lock(entriesMutex);
+	statistics.byteBudget = byteBudget;
+
+	if (scanned)
+		EvictToBudget(0);
+}
+
+bool SimilarityCache::IsEnabled() {
+	lock_guard<mutex> lock(entriesMutex);
+	return enabled;
+}
+
+// Disabled caches never hit and store nothing (lookups are not counted)
+void SimilarityCache::SetEnabled(bool enabled) {
+	lock_guard<mutex> lock(entriesMutex);
+	this->enabled = enabled;
+}
+
+CacheStatistics SimilarityCache::GetStatistics() {
+	lock_guard<mutex> lock(entriesMutex);
+	ScanDirectory();
+
+	return statistics;
+}
+
+//--------------------------------------------------------------------------------------
+// Instance Methods (Public)
+//--------------------------------------------------------------------------------------
+
+// Looks up a matrix by key - returns an empty matrix on a miss (or if the key is 0, i.e. the matrix's provenance is unknown)
+SimilarityMatrix SimilarityCache::Find(uint64_t key, float sigmaFactor) {
+	// Parameters:
+	// - key: key of the matrix (see GetKey)
+	// - sigmaFactor: sigma factor of the returned matrix (only affects probabilities, so it is not part of the key)
+
+	if (key == 0)
+		return SimilarityMatrix();
+
+	{
+		lock_guard<mutex> lock(entriesMutex);
+
+		if (!enabled)
+			return SimilarityMatrix();
+
+		ScanDirectory();
+
+		if (entries.find(key) == entries.end()) {
+			statistics.misses++;
+			return SimilarityMatrix();
+		}
+	}
+
+	// Mapped rather than read (the checksum is still verified, so a damaged entry is never used)
+	SimilarityMatrix output = SimilarityMatrix::Load(GetEntryPath(key));
+
+	lock_guard<mutex> lock(entriesMutex);
+	map<uint64_t, CacheEntry>::iterator entry = entries.find(key);
+
+	if (output.GetDistanceMatrix().empty()) {
+		if (entry != entries.end())
+			RemoveEntry(entry);
+
+		statistics.misses++;
+		return SimilarityMatrix();
+	}
+
+	// Mark as most recently used (also on disk, so the order is kept for the next run)
+	if (entry != entries.end())
+		entry->second.lastUsed = ++useCounter;
+
+	error_code error;
+	filesystem::last_write_time(GetEntryPath(key), filesystem::file_time_type::clock::now(), error);
+
+	statistics.hits++;
+
+	output.SetSigmaFactor(sigmaFactor);
+	output.SetCacheKey(key);
+
+	return output;
+}
+
+// Stores a matrix under a key, then evicts least recently used matrices until the cache is within its budget - returns false if not stored
+bool SimilarityCache::Insert(uint64_t key, const SimilarityMatrix& matrix) {
+	// Parameters:
+	// - key: key of the matrix (see GetKey - matrices with key 0 are not stored)
+	// - matrix: in-memory matrix (compact matrices are stored at full precision, out-of-core matrices are not stored)
+
+	if ((key == 0) || matrix.IsOutOfCore())
+		return false;
+
+	{
+		lock_guard<mutex> lock(entriesMutex);
+
+		if (!enabled)
+			return false;
+
+		ScanDirectory();
+
+		// Content addressed, so an existing entry already holds this matrix
+		if (entries.find(key) != entries.end())
+			return true;
+	}
+
+	Mat distanceMatrix = matrix.GetDenseDistanceMatrix();
+	if (distanceMatrix.empty() || (uint64_t(distanceMatrix.total() * distanceMatrix.elemSize()) > GetByteBudget()))
+		return false;
+
+	// Written under a temporary name then renamed, so a partly written file is never found - the name is unique to this insertion
+	// (process, thread and counter), so concurrent insertions of the same key never write to the same file
+	error_code error;
+	filesystem::create_directories(directory, error);
+
+	static atomic<unsigned long long> insertionCounter(0);
+
+#if defined(_WIN32)
+	unsigned long long processId = (unsigned long long)_getpid();
+#else
+	unsigned long long processId = (unsigned long long)getpid();
+#endif
+
+	char suffix[80];
+	snprintf(suffix, sizeof(suffix), ".%llx.%llx.%llx.tmp", processId, (unsigned long long)hash<thread::id>()(this_thread::get_id()), insertionCounter++);
+
+	string filePath = GetEntryPath(key);
+	string temporaryFilePath = filePath + suffix;
+
+	if (!MatrixFile::Save(temporaryFilePath, distanceMatrix)) {
+		filesystem::remove(temporaryFilePath, error);
+		return false;
+	}
+
+	filesystem::rename(temporaryFilePath, filePath, error);
+	if (error) {
+		filesystem::remove(temporaryFilePath, error);
+		return false;
+	}
+
+	uint64_t bytes = filesystem::file_size(filePath, error);
+
+	lock_guard<mutex> lock(entriesMutex);
+
+	if (entries.find(key) == entries.end()) {
+		entries[key] = { bytes, ++useCounter };
+		statistics.bytes += bytes;
+		statistics.entryCount++;
+	}
+
+	statistics.insertions++;
+
+	EvictToBudget(key);
+
+	return true;
+}
+
+// Removes every matrix from the cache (matrices still mapped by a similarity matrix are removed once released, where the OS allows)
+void SimilarityCache::Clear() {
+	lock_guard<mutex> lock(entriesMutex);
+	ScanDirectory();
+
+	while (!entries.empty())
+		RemoveEntry(entries.begin());
+}
+
+void SimilarityCache::ResetStatistics() {
+	lock_guard<mutex> lock(entriesMutex);
+
+	statistics.hits = 0;
+	statistics.misses = 0;
+	statistics.insertions = 0;
+	statistics.evictions = 0;
+}
+
+//--------------------------------------------------------------------------------------
+// Static Methods (Public)
+//--------------------------------------------------------------------------------------
+
+// Returns the root key of a video (fingerprint of its content - see MatrixFile::GetVideoFingerprint - combined with its modification time,
+// so a video edited in place misses even if the sampled bytes are unchanged)
+uint64_t SimilarityCache::GetVideoKey(string videoFilePath) {
+	uint64_t fingerprint = MatrixFile::GetVideoFingerprint(videoFilePath);
+	if (fingerprint == 0)
+		return 0;
+
+	error_code error;
+	long long modified = (long long)filesystem::last_write_time(videoFilePath, error).time_since_epoch().count();
+
+	if (error)
+		return 0;
+
+	uint64_t key = MatrixFile::ComputeChecksum(reinterpret_cast<const unsigned char*>(&modified), sizeof(modified), fingerprint);
+
+	return (key != 0) ? key : 1;
+}
+
+// Returns the key of a stage's output - combines the key of its input with the stage name and parameters (0 if the input key is 0)
+uint64_t SimilarityCache::GetKey(uint64_t parentKey, string stage, vector<double> parameters) {
+	// Parameters:
+	// - parentKey: key of the stage's input (GetVideoKey for the first stage)
+	// - stage: name of the stage (stages with the same parameters but different algorithms must use different names)
+	// - parameters: every parameter that changes the stage's output (hashed exactly, so no precision is lost to formatting)
+
+	if (parentKey == 0)
+		return 0;
+
+	uint64_t key = MatrixFile::ComputeChecksum(reinterpret_cast<const unsigned char*>(&parentKey), sizeof(parentKey));
+	key = MatrixFile::ComputeChecksum(reinterpret_cast<const unsigned char*>(stage.data()), stage.size() + 1, key);
+	key = MatrixFile::ComputeChecksum(reinterpret_cast<const unsigned char*>(parameters.data()), parameters.size() * sizeof(double), key);
+
+	// Mix the high bits back down (hashing whole words only carries differences upwards, and parameters often differ in a few bits)
+	key ^= key >> 33;
+	key *= 0xFF51AFD7ED558CCDULL;
+	key ^= key >> 33;
+	key *= 0xC4CEB9FE1A85EC53ULL;
+	key ^= key >> 33;
+
+	return (key != 0) ? key : 1;
+}
+
+// Returns the cache shared by every similarity stage
+SimilarityCache& SimilarityCache::GetSharedCache() {
+	static SimilarityCache cache;
+	return cache;
+}
+
+//--------------------------------------------------------------------------------------
+// Instance Methods (Private)
+//--------------------------------------------------------------------------------------
+
+// Builds the index from the entries on disk (first use only - the cache is empty if the directory does not exist yet)
+void SimilarityCache::ScanDirectory() {
+	if (scanned)
+		return;
+
+	scanned = true;
+
+	error_code error;
+	filesystem::directory_iterator file(directory, error);
+
+	for (; !error && (file != filesystem::directory_iterator()); file.increment(error)) {
+		filesystem::path filePath = file->path();
+		if (filePath.extension() != ENTRY_EXTENSION)
+			continue;
+
+		// Entry names are the key in hexadecimal
+		uint64_t key = 0;
+		if ((sscanf(filePath.stem().string().c_str(), "%llx", reinterpret_cast<unsigned long long*>(&key)) != 1) || (key == 0))
+			continue;
+
+		error_code entryError;
+		uint64_t bytes = file->file_size(entryError);
+		long long lastUsed = (long long)file->last_write_time(entryError).time_since_epoch().count();
+
+		if (entryError)
+			continue;
+
+		entries[key] = { bytes, lastUsed };
+		useCounter = max(useCounter, lastUsed);
+		statistics.bytes += bytes;
+		statistics.entryCount++;
+	}
+
+	EvictToBudget(0);
+}
+
+// Evicts least recently used entries until the cache is within its budget
+void SimilarityCache::EvictToBudget(uint64_t keptKey) {
+	// Parameters:
+	// - keptKey: key that is never evicted (the entry just inserted)
+
+	vector<pair<long long, uint64_t>> order;
+	for (const pair<const uint64_t, CacheEntry>& entry : entries) {
+		if (entry.first != keptKey)
+			order.push_back(make_pair(entry.second.lastUsed, entry.first));
+	}
+
+	sort(order.begin(), order.end());
+
+	for (size_t k = 0; (k < order.size()) && (statistics.bytes > statistics.byteBudget); k++) {
+		RemoveEntry(entries.find(order[k].second));
+		statistics.evictions++;
+	}
+}
+
+// Deletes an entry's file and removes it from the index
+void SimilarityCache::RemoveEntry(map<uint64_t, CacheEntry>::iterator entry) {
+	error_code error;
+	filesystem::remove(GetEntryPath(entry->first), error);
+
+	statistics.bytes -= min(statistics.bytes, entry->second.bytes);
+	statistics.entryCount--;
+	entries.erase(entry);
+}
+
+// Returns the file path of an entry (key in hexadecimal)
+string SimilarityCache::GetEntryPath(uint64_t key) {
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx", (unsigned long long)key);
+
+	return (filesystem::path(directory) / (string(name) + ENTRY_EXTENSION)).string();
+}
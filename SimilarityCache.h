@@ -0,0 +1,83 @@
+#pragma once
+#include "SimilarityMatrix.h"
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Hit/miss statistics of a similarity cache (since it was created or the statistics were last reset)
+struct CacheStatistics {
+	long long hits = 0;			// Lookups answered from the cache
+	long long misses = 0;		// Lookups that had to be computed
+	long long insertions = 0;	// Matrices written to the cache
+	long long evictions = 0;	// Matrices removed to stay within the size budget
+	int entryCount = 0;			// Matrices currently in the cache
+	uint64_t bytes = 0;			// Bytes currently held on disk
+	uint64_t byteBudget = 0;	// Size budget (least recently used matrices are evicted beyond it)
+};
+
+// SimilarityCache
+// - Persistent on-disk cache of distance matrices, addressed by content: each matrix is stored under a key that hashes the video it was
+//   computed from (see MatrixFile::GetVideoFingerprint, combined with its modification time) and the parameters of every stage that
+//   produced it
+// - Keys are chained: a stage's key is the key of its input combined with the stage's own parameters, so changing any earlier parameter
+//   (or the video) misses, while re-running with different synthesis settings hits
+// - Entries are binary matrix files (loaded zero-copy), evicted least recently used first once the size budget is exceeded - file
+//   modification times record use, so the order survives between runs
+
+class SimilarityCache {
+	public:
+		// Constructors
+		SimilarityCache(string directory = DEFAULT_DIRECTORY, uint64_t byteBudget = DEFAULT_BYTE_BUDGET);
+
+		// Getters & Setters
+		string GetDirectory();
+		uint64_t GetByteBudget();
+		void SetByteBudget(uint64_t byteBudget);
+		bool IsEnabled();
+		void SetEnabled(bool enabled);
+		CacheStatistics GetStatistics();
+
+		// Instance Methods
+		SimilarityMatrix Find(uint64_t key, float sigmaFactor = SimilarityConfig::DEFAULT_SIGMA_FACTOR);
+		bool Insert(uint64_t key, const SimilarityMatrix& matrix);
+		void Clear();
+		void ResetStatistics();
+
+		// Static Methods
+		static uint64_t GetVideoKey(string videoFilePath);
+		static uint64_t GetKey(uint64_t parentKey, string stage, vector<double> parameters);
+		static SimilarityCache& GetSharedCache();
+
+		// Static Parameters
+		static constexpr const char* DEFAULT_DIRECTORY = "SimilarityCache";
+		static const uint64_t DEFAULT_BYTE_BUDGET = 4ULL * 1024 * 1024 * 1024;
+
+	private:
+		// Entry of the cache index
+		struct CacheEntry {
+			uint64_t bytes;
+			long long lastUsed;
+		};
+
+		// Parameters
+		string directory;
+		bool enabled;
+		bool scanned;
+		map<uint64_t, CacheEntry> entries;
+		long long useCounter;
+		CacheStatistics statistics;
+		mutex entriesMutex;
+
+		// Static Parameters
+		static constexpr const char* ENTRY_EXTENSION = ".vtm";
+
+		// Instance Methods
+		void ScanDirectory();
+		void EvictToBudget(uint64_t keptKey);
+		void RemoveEntry(map<uint64_t, CacheEntry>::iterator entry);
+		string GetEntryPath(uint64_t key);
+};
@@ -0,0 +1,148 @@
+#include "SimilarityConfig.h"
+#include "DiagonalFilter.h"
+
+using namespace std;
+
+//--------------------------------------------------------------------------------------
+// Constructors
+//--------------------------------------------------------------------------------------
+
+// Default constructor - the original pipeline (m = 2, p = 0.75, alpha = 0.995, sigma factor = 0.1, 20 transitions)
+SimilarityConfig::SimilarityConfig() : SimilarityConfig(DEFAULT_WINDOW_SIZE, DEFAULT_P, DEFAULT_ALPHA) {}
+
+SimilarityConfig::SimilarityConfig(int windowSize, double p, float alpha, float sigmaFactor, int transitionCount) {
+	// Parameters:
+	// - windowSize: m, the number of frames either side compared by the motion filter
+	// - p: exponent applied to motion distances
+	// - alpha: discount applied to future cost
+	// - sigmaFactor: multiple of the average distance used as sigma when mapping distances to probabilities
+	// - transitionCount: number of lowest cost transitions kept when pruning (the default is used if it is less than 1)
+
+	this->windowSize = windowSize;
+	this->p = p;
+	this->alpha = alpha;
+	tolerance = DEFAULT_TOLERANCE;
+	maxIterations = DEFAULT_MAX_ITERATIONS;
+	this->sigmaFactor = sigmaFactor;
+	this->transitionCount = (transitionCount >= 1) ? transitionCount : DEFAULT_TRANSITION_COUNT;
+	storage = MatrixStorage::Float32;
+}
+
+//--------------------------------------------------------------------------------------
+// Getters & Setters
+//--------------------------------------------------------------------------------------
+
+int SimilarityConfig::GetWindowSize() {
+	return windowSize;
+}
+
+// Setting the window size discards explicitly set weights (equal weights are used for the new window)
+void SimilarityConfig::SetWindowSize(int windowSize) {
+	this->windowSize = windowSize;
+	weights.clear();
+}
+
+// Returns the 2m motion filter weights (equal weights unless set explicitly)
+vector<float> SimilarityConfig::GetWeights() {
+	if (weights.empty())
+		return DiagonalFilter::GetBoxWeights(windowSize);
+
+	return weights;
+}
+
+// Sets explicit motion filter weights (see DiagonalFilter) - the window size becomes half the number of weights
+void SimilarityConfig::SetWeights(vector<float> weights) {
+	this->weights = weights;
+	windowSize = int(weights.size()) / 2;
+}
+
+double SimilarityConfig::GetP() {
+	return p;
+}
+
+void SimilarityConfig::SetP(double p) {
+	this->p = p;
+}
+
+float SimilarityConfig::GetAlpha() {
+	return alpha;
+}
+
+void SimilarityConfig::SetAlpha(float alpha) {
+	this->alpha = alpha;
+}
+
+float SimilarityConfig::GetTolerance() {
+	return tolerance;
+}
+
+// Sets the relative tolerance of the future cost solver - returns false (leaving it unchanged) if it is negative or not a number
+bool SimilarityConfig::SetTolerance(float tolerance) {
+	if (!(tolerance >= 0))
+		return false;
+
+	this->tolerance = tolerance;
+	return true;
+}
+
+int SimilarityConfig::GetMaxIterations() {
+	return maxIterations;
+}
+
+// Sets the iteration limit of the future cost solver - returns false (leaving it unchanged) if it is less than 1
+bool SimilarityConfig::SetMaxIterations(int maxIterations) {
+	if (maxIterations < 1)
+		return false;
+
+	this->maxIterations = maxIterations;
+	return true;
+}
+
+float SimilarityConfig::GetSigmaFactor() {
+	return sigmaFactor;
+}
+
+void SimilarityConfig::SetSigmaFactor(float sigmaFactor) {
+	this->sigmaFactor = sigmaFactor;
+}
+
+int SimilarityConfig::GetTransitionCount() {
+	return transitionCount;
+}
+
+// Sets the number of transitions kept when pruning - returns false (leaving it unchanged) if the count is less than 1
+bool SimilarityConfig::SetTransitionCount(int transitionCount) {
+	if (transitionCount < 1)
+		return false;
+
+	this->transitionCount = transitionCount;
+	return true;
+}
+
+MatrixStorage SimilarityConfig::GetStorage() {
+	return storage;
+}
+
+void SimilarityConfig::SetStorage(MatrixStorage storage) {
+	this->storage = storage;
+}
+
+//--------------------------------------------------------------------------------------
+// Static Methods (Public)
+//--------------------------------------------------------------------------------------
+
+// Returns every combination of the given parameter values (for SimilarityMeasure::RunParameterSweep) - transition counts less than 1
+// are skipped
+vector<SimilarityConfig> SimilarityConfig::CreateSweep(vector<int> windowSizes, vector<double> exponents, vector<float> alphas, vector<float> sigmaFactors, vector<int> transitionCounts) {
+	vector<SimilarityConfig> configs;
+
+	for (int windowSize : windowSizes)
+		for (double p : exponents)
+			for (float alpha : alphas)
+				for (float sigmaFactor : sigmaFactors)
+					for (int transitionCount : transitionCounts)
+						if (transitionCount >= 1)
+							configs.push_back(SimilarityConfig(windowSize, p, alpha, sigmaFactor, transitionCount));
+
+	return configs;
+}
\ No newline at end of file
@@ -0,0 +1,65 @@
+#pragma once
+#include "CompactMatrix.h"
+#include <vector>
+
+using namespace std;
+
+// SimilarityConfig
+// - Tunable parameters of the similarity measure and transition pruning (defaults reproduce the original pipeline)
+// - Motion window: m frames either side (2m filter weights, equal weights unless set explicitly)
+// - Future cost: D''_ij = (D'_ij)^p + alpha * min_k D''_jk, iterated until no row minimum changes by more than tolerance * the largest
+//   row minimum (or for at most max iterations - see FutureCostSolver)
+// - Probabilities: P_ij = exp(-D_(i+1)j / sigma), sigma = sigma factor * average distance
+// - Pruning: number of lowest cost transitions kept for synthesis (at least 1 - invalid counts are rejected)
+// - Storage: element storage of the motion and future cost matrices (full precision, half precision or quantised)
+
+class SimilarityConfig {
+	public:
+		// Constructors
+		SimilarityConfig();
+		SimilarityConfig(int windowSize, double p, float alpha, float sigmaFactor = DEFAULT_SIGMA_FACTOR, int transitionCount = DEFAULT_TRANSITION_COUNT);
+
+		// Getters & Setters
+		int GetWindowSize();
+		void SetWindowSize(int windowSize);
+		vector<float> GetWeights();
+		void SetWeights(vector<float> weights);
+		double GetP();
+		void SetP(double p);
+		float GetAlpha();
+		void SetAlpha(float alpha);
+		float GetTolerance();
+		bool SetTolerance(float tolerance);
+		int GetMaxIterations();
+		bool SetMaxIterations(int maxIterations);
+		float GetSigmaFactor();
+		void SetSigmaFactor(float sigmaFactor);
+		int GetTransitionCount();
+		bool SetTransitionCount(int transitionCount);
+		MatrixStorage GetStorage();
+		void SetStorage(MatrixStorage storage);
+
+		// Static Methods
+		static vector<SimilarityConfig> CreateSweep(vector<int> windowSizes, vector<double> exponents, vector<float> alphas, vector<float> sigmaFactors = { DEFAULT_SIGMA_FACTOR }, vector<int> transitionCounts = { DEFAULT_TRANSITION_COUNT });
+
+		// Static Parameters
+		static const int DEFAULT_WINDOW_SIZE = 2;
+		static constexpr double DEFAULT_P = 0.75;
+		static constexpr float DEFAULT_ALPHA = 0.995f;
+		static constexpr float DEFAULT_TOLERANCE = 1e-4f;
+		static const int DEFAULT_MAX_ITERATIONS = 1000;
+		static constexpr float DEFAULT_SIGMA_FACTOR = 0.1f;
+		static const int DEFAULT_TRANSITION_COUNT = 20;
+
+	private:
+		// Parameters
+		int windowSize;
+		vector<float> weights;
+		double p;
+		float alpha;
+		float tolerance;
+		int maxIterations;
+		float sigmaFactor;
+		int transitionCount;
+		MatrixStorage storage;
+};
@@ -1,5 +1,8 @@
 #include "SimilarityMatrix.h"
+#include "CSVCodec.h"
+#include "WorkStealingScheduler.h"
 #include "Utilities.cpp"
+#include <cfloat>
 #include <fstream>
 
 using namespace cv;
@@ -9,132 +12,320 @@ using namespace utils_;
 // Constructors
 //--------------------------------------------------------------------------------------
 
-SimilarityMatrix::SimilarityMatrix() {}
+SimilarityMatrix::SimilarityMatrix() {
+    sigmaFactor = SimilarityConfig::DEFAULT_SIGMA_FACTOR;
+    cacheKey = 0;
+}
+
+SimilarityMatrix::SimilarityMatrix(Mat dm, float sigmaFactor) {
+    // Parameters:
+    // - dm: distance matrix
+    // - sigmaFactor: multiple of the average distance used as sigma when mapping distances to probabilities
 
-SimilarityMatrix::SimilarityMatrix(Mat dm) {
+    this->sigmaFactor = sigmaFactor;
     SetDistanceMatrix(dm);
 }
 
+// Creates out-of-core similarity matrix backed by a tiled store (probabilities are not computed)
+SimilarityMatrix::SimilarityMatrix(shared_ptr<TiledMatrixStore> store) {
+    sigmaFactor = SimilarityConfig::DEFAULT_SIGMA_FACTOR;
+    tiledStore = store;
+    cacheKey = 0;
+}
+
+// Creates similarity matrix holding a compact (half precision/quantised) distance matrix
+SimilarityMatrix::SimilarityMatrix(shared_ptr<const CompactMatrix> compact, float sigmaFactor) {
+    this->sigmaFactor = sigmaFactor;
+    compactMatrix = compact;
+    probabilityCache = make_shared<ProbabilityCache>();
+    cacheKey = 0;
+}
+
 //--------------------------------------------------------------------------------------
 // Getters & Setters
 //--------------------------------------------------------------------------------------
 
-Mat SimilarityMatrix::GetDistanceMatrix() {
+const Mat& SimilarityMatrix::GetDistanceMatrix() const {
 	return distanceMatrix;
 }
 
 void SimilarityMatrix::SetDistanceMatrix(Mat dm) {
+	tiledStore.reset();
+	compactMatrix.reset();
+
+	// Mapping is only kept while the distance matrix points into it
+	if (mappedData && ((dm.datastart < mappedData->GetData()) || (dm.datastart >= mappedData->GetData() + mappedData->GetLength())))
+		mappedData.reset();
+
 	distanceMatrix = dm;
-	MapDistancesToProbabilities();
-    NormaliseProbabilityMatrix();
+	probabilityCache = make_shared<ProbabilityCache>();
+
+	// A new matrix no longer matches the stages the key describes
+	cacheKey = 0;
+}
+
+// Returns probability matrix (computed on first access, empty if there is no in-memory distance matrix)
+Mat SimilarityMatrix::GetProbabilityMatrix() const {
+    if (!probabilityCache)
+        return Mat();
+
+    call_once(probabilityCache->computed, [&]() {
+        probabilityCache->probabilityMatrix = MapDistancesToProbabilities(GetDenseDistanceMatrix());
+        probabilityCache->ready = true;
+    });
+
+    return probabilityCache->probabilityMatrix;
+}
+
+float SimilarityMatrix::GetSigmaFactor() const {
+    return sigmaFactor;
 }
 
-Mat SimilarityMatrix::GetProbabilityMatrix() {
-	return probabilityMatrix;
+// Changing sigma invalidates the probability matrix (copies keep the probabilities for their own sigma)
+void SimilarityMatrix::SetSigmaFactor(float sigmaFactor) {
+    this->sigmaFactor = sigmaFactor;
+
+    if (probabilityCache)
+        probabilityCache = make_shared<ProbabilityCache>();
+}
+
+shared_ptr<TiledMatrixStore> SimilarityMatrix::GetTiledStore() const {
+    return tiledStore;
+}
+
+shared_ptr<const CompactMatrix> SimilarityMatrix::GetCompactMatrix() const {
+    return compactMatrix;
+}
+
+// Returns distance matrix at full precision (compact matrices are decoded into a new matrix, otherwise no copy is made)
+Mat SimilarityMatrix::GetDenseDistanceMatrix() const {
+    if (IsCompact())
+        return compactMatrix->Decode();
+
+    return distanceMatrix;
+}
+
+int SimilarityMatrix::GetFrameCount() const {
+    if (IsOutOfCore())
+        return tiledStore->GetRows();
+
+    if (IsCompact())
+        return compactMatrix->GetRows();
+
+    return distanceMatrix.rows;
+}
+
+// Returns size of the in-memory distance matrix in bytes (mapped from a file if IsMapped)
+size_t SimilarityMatrix::GetDistanceBytes() const {
+    if (IsCompact())
+        return compactMatrix->GetBytes();
+
+    return distanceMatrix.total() * distanceMatrix.elemSize();
+}
+
+// Returns size of the probability matrix in bytes (zero until it has been computed)
+size_t SimilarityMatrix::GetProbabilityBytes() const {
+    if (!probabilityCache || !probabilityCache->ready)
+        return 0;
+
+    return probabilityCache->probabilityMatrix.total() * probabilityCache->probabilityMatrix.elemSize();
+}
+
+// Returns the key of the stages that produced the matrix (0 if unknown)
+uint64_t SimilarityMatrix::GetCacheKey() const {
+    return cacheKey;
+}
+
+void SimilarityMatrix::SetCacheKey(uint64_t cacheKey) {
+    this->cacheKey = cacheKey;
 }
 
 //--------------------------------------------------------------------------------------
 // Instance Methods (Public)
 //--------------------------------------------------------------------------------------
 
+// Checks if the distance matrix is held in an on-disk tiled store rather than in memory
+bool SimilarityMatrix::IsOutOfCore() const {
+    return (tiledStore != NULL);
+}
+
+// Checks if the distance matrix points into a mapped binary matrix file
+bool SimilarityMatrix::IsMapped() const {
+    return (mappedData != NULL);
+}
+
+// Checks if the distance matrix is held in compact (half precision/quantised) storage
+bool SimilarityMatrix::IsCompact() const {
+    return (compactMatrix != NULL);
+}
+
+// Returns a similarity matrix holding the same distances in the given storage (out-of-core matrices are returned unchanged)
+SimilarityMatrix SimilarityMatrix::ToStorage(MatrixStorage storage) const {
+    if (IsOutOfCore() || (IsCompact() && (compactMatrix->GetStorage() == storage)))
+        return *this;
+
+    if (storage == MatrixStorage::Float32)
+        return SimilarityMatrix(GetDenseDistanceMatrix(), sigmaFactor);
+
+    return SimilarityMatrix(make_shared<const CompactMatrix>(GetDenseDistanceMatrix(), storage), sigmaFactor);
+}
+
+// Saves distance matrix as binary matrix file
+bool SimilarityMatrix::SaveDistanceMatrix(string filePath, string videoFilePath) const {
+    // Parameters:
+    // - filePath: file path to save to
+    // - videoFilePath: video the matrix was computed from (recorded so the file can be checked against it when reloaded)
+
+    return MatrixFile::Save(filePath, GetDenseDistanceMatrix(), videoFilePath);
+}
+
 // Saves distance matrix as CSV file
-void SimilarityMatrix::SaveDistanceMatrixAsCSV(string filePath) {
-    ofstream output(filePath);
-
-    for (int i = 0; i < distanceMatrix.rows; i++) {
-        for (int j = 0; j < distanceMatrix.cols; j++) {
-            output << ToStr(distanceMatrix.at<float>(i, j));
-            if (j + 1 < distanceMatrix.cols)
-                output << ", ";
-        }
-        output << endl;
+void SimilarityMatrix::SaveDistanceMatrixAsCSV(string filePath) const {
+    // Out-of-core matrices are written one band of tile rows at a time
+    if (IsOutOfCore()) {
+        ofstream output(filePath, ios::binary | ios::trunc);
+
+        for (int rowStart = 0; rowStart < tiledStore->GetRows(); rowStart += tiledStore->GetTileSize())
+            CSVCodec::WriteRows(output, tiledStore->ReadRegion(rowStart, min(rowStart + tiledStore->GetTileSize(), tiledStore->GetRows()), 0, tiledStore->GetCols()));
+
+        output.close();
+        return;
     }
 
-    output.close();
+    CSVCodec::Write(filePath, GetDenseDistanceMatrix());
 }
 
 // Saves probability matrix as CSV file
-void SimilarityMatrix::SaveProbabilityMatrixAsCSV(string filePath) {
-    ofstream output(filePath);
-
-    for (int i = 0; i < probabilityMatrix.rows; i++) {
-        for (int j = 0; j < probabilityMatrix.cols; j++) {
-            output << ToStr(probabilityMatrix.at<float>(i, j));
-            if (j + 1 < probabilityMatrix.cols)
-                output << ", ";
-        }
-        output << endl;
-    }
-
-    output.close();
+void SimilarityMatrix::SaveProbabilityMatrixAsCSV(string filePath) const {
+    CSVCodec::Write(filePath, GetProbabilityMatrix());
 }
 
 // Saves distance matrix as image file
-void SimilarityMatrix::SaveDistanceMatrixAsImage(string filePath) {
-    Mat image;
-    normalize(distanceMatrix, image, 0, 255, NORM_MINMAX);
+void SimilarityMatrix::SaveDistanceMatrixAsImage(string filePath) const {
+    Mat distanceMatrix = GetDenseDistanceMatrix();
+
+    if (distanceMatrix.empty())
+        return;
+
+    // Rejected pairs (+inf) are drawn as the largest distance
+    Mat image(distanceMatrix.size(), CV_32F, Scalar(255));
+    normalize(distanceMatrix, image, 0, 255, NORM_MINMAX, -1, distanceMatrix < FLT_MAX);
     imwrite(filePath, image);
 }
 
 // Saves probability matrix as image file
-void SimilarityMatrix::SaveProbabilityMatrixAsImage(string filePath) {
+void SimilarityMatrix::SaveProbabilityMatrixAsImage(string filePath) const {
+    Mat probabilityMatrix = GetProbabilityMatrix();
+
+    if (probabilityMatrix.empty())
+        return;
+
     Mat image;
     normalize(probabilityMatrix, image, 0, 255, NORM_MINMAX);
     imwrite(filePath, image);
 }
 
+//--------------------------------------------------------------------------------------
+// Static Methods (Public)
+//--------------------------------------------------------------------------------------
+
+// Loads similarity matrix from a binary matrix file (zero-copy) or a CSV file - returns an empty matrix if the file is invalid
+SimilarityMatrix SimilarityMatrix::Load(string filePath, string videoFilePath) {
+    // Parameters:
+    // - filePath: binary matrix file or CSV file
+    // - videoFilePath: if set, binary matrix files computed from a different video are rejected
+
+    SimilarityMatrix output;
+
+    Mat dm;
+    if (MatrixFile::IsMatrixFile(filePath))
+        dm = MatrixFile::Load(filePath, output.mappedData, videoFilePath);
+    else
+        dm = ReadCSVFile(filePath);
+
+    if (!dm.empty())
+        output.SetDistanceMatrix(dm);
+
+    return output;
+}
+
 //--------------------------------------------------------------------------------------
 // Instance Methods (Private)
 //--------------------------------------------------------------------------------------
 
-// Maps distances to probabilities to create the probability matrix
-void SimilarityMatrix::MapDistancesToProbabilities() {
+// Maps distances to probabilities, P_ij = exp(-D_(i+1)j / sigma) normalised so that each row sums to one
+Mat SimilarityMatrix::MapDistancesToProbabilities(const Mat& matrix) const {
+    if (matrix.rows < 2)
+        return Mat();
 
     // Calculate sigma
-    float sigma = 0.1 * GetAverageValue();
+    float scale = float(-1 / (sigmaFactor * GetAverageValue(matrix)));
 
-    // Map to probabilities
-    Mat probabilities(distanceMatrix.rows - 1, distanceMatrix.cols, CV_32F);
+    // Map to probabilities and normalise in one pass per row (the row is still in cache when it is normalised)
+    Mat probabilities(matrix.rows - 1, matrix.cols, CV_32F);
+    int cols = matrix.cols;
 
-    for (int i = 0; i < distanceMatrix.rows - 1; i++) {
-        for (int j = 0; j < distanceMatrix.cols; j++) {
-            probabilities.at<float>(i, j) = exp((-1 * distanceMatrix.at<float>(i + 1, j)) / sigma);
-        }
-    }
+    WorkStealingScheduler::Run(probabilities.rows, [&](int i) {
+        const float* distances = matrix.ptr<float>(i + 1);
+        float* values = probabilities.ptr<float>(i);
 
-    probabilityMatrix = probabilities;
-}
+        for (int j = 0; j < cols; j++)
+            values[j] = distances[j] * scale;
 
-// Get average (non-zero) value of distance matrix
-float SimilarityMatrix::GetAverageValue() {
+        // Vectorised exp (in place)
+        Mat row(1, cols, CV_32F, values);
+        exp(row, row);
 
-    float total = 0;
-    int count = 0;
+        const int lanes = 8;
+        float sums[lanes] = {};
+        int j = 0;
 
-    for (int row = 0; row < distanceMatrix.rows; row++) {
-        for (int col = 0; col < distanceMatrix.cols; col++) {
-            if (row != col) {
-                total += distanceMatrix.at<float>(row, col);
-                count++;
-            }
+        for (; j + lanes <= cols; j += lanes) {
+            for (int l = 0; l < lanes; l++)
+                sums[l] += values[j + l];
         }
-    }
 
-    return (total / count);
+        for (; j < cols; j++)
+            sums[0] += values[j];
+
+        float sum = 0;
+        for (int l = 0; l < lanes; l++)
+            sum += sums[l];
+
+        float reciprocal = 1 / sum;
+        for (j = 0; j < cols; j++)
+            values[j] *= reciprocal;
+    });
+
+    return probabilities;
 }
 
-// Normalises values in each row of the probability matrix such that the sum of each row is one
-void SimilarityMatrix::NormaliseProbabilityMatrix() {
+// Get average (non-zero) value of a distance matrix (rejected pairs, stored as +inf, are left out)
+double SimilarityMatrix::GetAverageValue(const Mat& matrix) const {
 
-    Mat normalised(probabilityMatrix.rows, probabilityMatrix.cols, CV_32F);
+    double total = 0;
+    double count = 0;
 
-    for (int i = 0; i < probabilityMatrix.rows; i++) {
-        float sum = 0;
-        for (int j = 0; j < probabilityMatrix.cols; j++) {
-            sum += probabilityMatrix.at<float>(i, j);
+    for (int row = 0; row < matrix.rows; row++) {
+        const float* distances = matrix.ptr<float>(row);
+        double rowTotal = 0;
+        int rowCount = 0;
+
+        for (int col = 0; col < matrix.cols; col++) {
+            if (distances[col] < FLT_MAX) {
+                rowTotal += distances[col];
+                rowCount++;
+            }
         }
-        normalised.row(i) = probabilityMatrix.row(i) / sum;
+
+        if ((row < matrix.cols) && (distances[row] < FLT_MAX)) {
+            rowTotal -= distances[row];
+            rowCount--;
+        }
+
+        total += rowTotal;
+        count += rowCount;
     }
 
-    probabilityMatrix = normalised;
+    return (count > 0) ? (total / count) : 0;
 }
\ No newline at end of file
@@ -1,36 +1,81 @@
 #pragma once
+#include "TiledMatrixStore.h"
+#include "MatrixFile.h"
+#include "SimilarityConfig.h"
+#include "CompactMatrix.h"
 #include <opencv2/opencv.hpp>
+#include <atomic>
+#include <memory>
+#include <mutex>
 
 using namespace std;
 
 // SimilarityMatrix
 // - Stores distance and probabilistic representations of similarities between frames
+// - Distance matrices loaded from binary matrix files point directly into the mapped file (the mapping is shared between copies)
+// - Can instead be backed by an on-disk tiled store (out-of-core), in which case only the distance matrix is kept (in the store)
+// - The probability matrix is only computed when first requested, then cached (the cache is shared between copies until the distances change)
+// - Can instead hold a compact (half precision/quantised) distance matrix, which stages dequantise on the fly (see CompactMatrix)
+// - Carries the key of the stages that produced it (see SimilarityCache), so later stages can be looked up - 0 if unknown (e.g. loaded by the user)
+// - Acts as a shared, immutable handle: copies share the distance data, which is never written through a similarity matrix (setting a new
+//   distance matrix replaces it), so consumers read it through the const getters
 
 class SimilarityMatrix {
 	public:
 		// Constructors
 		SimilarityMatrix();
-		SimilarityMatrix(cv::Mat dm);
+		SimilarityMatrix(cv::Mat dm, float sigmaFactor = SimilarityConfig::DEFAULT_SIGMA_FACTOR);
+		SimilarityMatrix(shared_ptr<TiledMatrixStore> store);
+		SimilarityMatrix(shared_ptr<const CompactMatrix> compact, float sigmaFactor = SimilarityConfig::DEFAULT_SIGMA_FACTOR);
 
 		// Getters & Setters
-		cv::Mat GetDistanceMatrix();
+		const cv::Mat& GetDistanceMatrix() const;
 		void SetDistanceMatrix(cv::Mat dm);
-		cv::Mat GetProbabilityMatrix();
+		cv::Mat GetProbabilityMatrix() const;
+		float GetSigmaFactor() const;
+		void SetSigmaFactor(float sigmaFactor);
+		shared_ptr<TiledMatrixStore> GetTiledStore() const;
+		shared_ptr<const CompactMatrix> GetCompactMatrix() const;
+		cv::Mat GetDenseDistanceMatrix() const;
+		int GetFrameCount() const;
+		size_t GetDistanceBytes() const;
+		size_t GetProbabilityBytes() const;
+		uint64_t GetCacheKey() const;
+		void SetCacheKey(uint64_t cacheKey);
 
 		// Instance Methods
-		void SaveDistanceMatrixAsCSV(string filePath);
-		void SaveProbabilityMatrixAsCSV(string filePath);
-		void SaveDistanceMatrixAsImage(string filePath);
-		void SaveProbabilityMatrixAsImage(string filePath);
+		bool IsOutOfCore() const;
+		bool IsMapped() const;
+		bool IsCompact() const;
+		SimilarityMatrix ToStorage(MatrixStorage storage) const;
+		bool SaveDistanceMatrix(string filePath, string videoFilePath = "") const;
+		void SaveDistanceMatrixAsCSV(string filePath) const;
+		void SaveProbabilityMatrixAsCSV(string filePath) const;
+		void SaveDistanceMatrixAsImage(string filePath) const;
+		void SaveProbabilityMatrixAsImage(string filePath) const;
+
+		// Static Methods
+		static SimilarityMatrix Load(string filePath, string videoFilePath = "");
 
 	private:
+		// Probability matrix computed on first access
+		struct ProbabilityCache {
+			once_flag computed;
+			atomic<bool> ready{ false };
+			cv::Mat probabilityMatrix;
+		};
+
 		// Parameters
 		cv::Mat distanceMatrix;
-		cv::Mat probabilityMatrix;
+		shared_ptr<ProbabilityCache> probabilityCache;
+		float sigmaFactor;
+		shared_ptr<TiledMatrixStore> tiledStore;
+		shared_ptr<const CompactMatrix> compactMatrix;
+		shared_ptr<MappedRegion> mappedData;
+		uint64_t cacheKey;
 
 		// Instance Methods
-		void MapDistancesToProbabilities();
-		float GetAverageValue();
-		void NormaliseProbabilityMatrix();
+		cv::Mat MapDistancesToProbabilities(const cv::Mat& matrix) const;
+		double GetAverageValue(const cv::Mat& matrix) const;
 };
 
@@ -1,42 +1,170 @@
 #include "SimilarityMeasure.h"
+#include "FrameStore.h"
+#include "FrameDescriptor.h"
+#include "DiagonalFilter.h"
+#include "FutureCostSolver.h"
+#include "WorkStealingScheduler.h"
 #include "Utilities.cpp"
+#include <limits>
+#include <numeric>
 
 using namespace std;
 using namespace cv;
 using namespace utils_;
 
+ExportOptions SimilarityMeasure::exportOptions;
+
+//--------------------------------------------------------------------------------------
+// Getters & Setters
+//--------------------------------------------------------------------------------------
+
+ExportOptions SimilarityMeasure::GetExportOptions() {
+    return exportOptions;
+}
+
+void SimilarityMeasure::SetExportOptions(ExportOptions options) {
+    exportOptions = options;
+}
+
 //--------------------------------------------------------------------------------------
 // Static Methods (Public)
 //--------------------------------------------------------------------------------------
 
 // Creates similarity matrix by calculating Euclidean distance between individual frames
-SimilarityMatrix SimilarityMeasure::ComputeEuclideanSimilarityMatrix(string videoFilePath) {
-    VideoCapture inputVideo(videoFilePath);
-
-    if (inputVideo.isOpened()) {
-        int frameCount = int(inputVideo.get(CAP_PROP_FRAME_COUNT));
-        Mat distanceMatrix(frameCount, frameCount, CV_32F), frame1, frame2;
-
-        // Calculate Euclidean distance between frames
-        for (int i = 0; i < frameCount; i++) {
-            inputVideo.set(1, i);
-            bool success = inputVideo.read(frame1);
-            if (!success) break;
-            for (int j = 0; j < frameCount; j++) {
-                inputVideo.set(1, j);
-                bool success = inputVideo.read(frame2);
-                if (!success) break;
-                distanceMatrix.at<float>(i, j) = norm(frame1, frame2, NORM_L2);
-            }
-        }
+SimilarityMatrix SimilarityMeasure::ComputeEuclideanSimilarityMatrix(string videoFilePath, int workingHeight, bool greyscale, DistanceBackend backend) {
+    // Parameters:
+    // - videoFilePath: file path for video
+    // - workingHeight: height frames are compared at (0 compares at the source resolution)
+    // - greyscale: compares single channel frames rather than BGR
+    // - backend: exact pairwise differences or the GEMM norm expansion (faster for long clips)
+
+    uint64_t cacheKey = GetEuclideanKey(videoFilePath, workingHeight, greyscale, backend);
+    SimilarityMatrix cached = SimilarityCache::GetSharedCache().Find(cacheKey);
+
+    if (cached.GetFrameCount() > 0) {
+        SaveMatrices(cached, videoFilePath, "euclidean");
+        return cached;
+    }
+
+    // Decode video once - frames are then served from memory rather than seeking for every pair
+    shared_ptr<FrameStore> frames = FrameStore::GetSharedStore(videoFilePath, workingHeight, greyscale);
+
+    if (frames->IsLoaded()) {
+        // Calculate Euclidean distance between frames (upper triangle only, tiled across all cores)
+        Mat distanceMatrix = DistanceKernel::ComputeEuclideanDistanceMatrix(*frames, backend);
+
+        SimilarityMatrix output(distanceMatrix);
+        output.SetCacheKey(cacheKey);
+        SimilarityCache::GetSharedCache().Insert(cacheKey, output);
+
+        // Export matrices as binary, CSV and image files
+        SaveMatrices(output, videoFilePath, "euclidean");
+
+        return output;
+    }
+
+    return SimilarityMatrix();
+}
+
+// Creates similarity matrix by calculating the weighted Euclidean distance between frames over the pixels of a mask
+SimilarityMatrix SimilarityMeasure::ComputeMaskedSimilarityMatrix(string videoFilePath, const FrameMask& mask, int workingHeight, bool greyscale, DistanceBackend backend) {
+    // Parameters:
+    // - videoFilePath: file path for video
+    // - mask: pixels compared and their weights (rescaled to the working resolution if necessary)
+    // - workingHeight, greyscale, backend: as for ComputeEuclideanSimilarityMatrix
+
+    uint64_t checksum = mask.GetChecksum();
+    uint64_t cacheKey = SimilarityCache::GetKey(GetEuclideanKey(videoFilePath, workingHeight, greyscale, backend), "mask", { double(checksum >> 32), double(checksum & 0xFFFFFFFF) });
+    SimilarityMatrix cached = SimilarityCache::GetSharedCache().Find(cacheKey);
+
+    if (cached.GetFrameCount() > 0) {
+        SaveMatrices(cached, videoFilePath, "euclidean");
+        return cached;
+    }
+
+    shared_ptr<FrameStore> frames = FrameStore::GetSharedStore(videoFilePath, workingHeight, greyscale);
+
+    // Active pixels are gathered once into compact frames, so every pair compares only those (with the same kernels as the full frames)
+    FrameStore gatheredFrames;
+
+    if (frames->IsLoaded() && gatheredFrames.Gather(*frames, mask)) {
+        Mat distanceMatrix = DistanceKernel::ComputeEuclideanDistanceMatrix(gatheredFrames, backend);
+
+        SimilarityMatrix output(distanceMatrix);
+        output.SetCacheKey(cacheKey);
+        SimilarityCache::GetSharedCache().Insert(cacheKey, output);
+
+        // Export matrices as binary, CSV and image files (replaces the Euclidean stage, so saved as such)
+        SaveMatrices(output, videoFilePath, "euclidean");
+
+        return output;
+    }
+
+    return SimilarityMatrix();
+}
+
+// Creates similarity matrix by calculating Euclidean distance between compact frame descriptors (alternative to the full-resolution Euclidean matrix)
+SimilarityMatrix SimilarityMeasure::ComputeDescriptorSimilarityMatrix(string videoFilePath, int thumbnailHeight, int dimensions) {
+    // Parameters:
+    // - videoFilePath: file path for video
+    // - thumbnailHeight: height frames are area-downsampled to
+    // - dimensions: number of principal components kept per descriptor (0 compares the thumbnails directly)
+
+    uint64_t cacheKey = SimilarityCache::GetKey(SimilarityCache::GetVideoKey(videoFilePath), "descriptor", { double(thumbnailHeight), double(dimensions) });
+    SimilarityMatrix cached = SimilarityCache::GetSharedCache().Find(cacheKey);
+
+    if (cached.GetFrameCount() > 0) {
+        SaveMatrices(cached, videoFilePath, "euclidean");
+        return cached;
+    }
+
+    shared_ptr<FrameStore> frames = FrameStore::GetSharedStore(videoFilePath);
+
+    if (frames->IsLoaded()) {
+        Mat descriptors = FrameDescriptor::ComputeDescriptors(*frames, thumbnailHeight, dimensions);
+        Mat distanceMatrix = FrameDescriptor::ComputeDistanceMatrix(descriptors);
 
         SimilarityMatrix output(distanceMatrix);
+        output.SetCacheKey(cacheKey);
+        SimilarityCache::GetSharedCache().Insert(cacheKey, output);
+
+        // Export matrices as binary, CSV and image files (replaces the Euclidean stage, so saved as such)
+        SaveMatrices(output, videoFilePath, "euclidean");
+
+        return output;
+    }
+
+    return SimilarityMatrix();
+}
+
+// Creates similarity matrix from a tiny pyramid level, re-evaluating only the K best candidates per row (and the diagonal band the
+// motion filter needs) at full resolution - every other pair is rejected (+inf)
+SimilarityMatrix SimilarityMeasure::ComputeCoarseToFineSimilarityMatrix(string videoFilePath, int coarseHeight, int candidatesPerRow, SimilarityConfig config) {
+    // Parameters:
+    // - videoFilePath: file path for video
+    // - coarseHeight: height of the coarse level every pair is compared at
+    // - candidatesPerRow: number of candidates per row re-evaluated at full resolution (n * K comparisons instead of n^2)
+    // - config: motion window the diagonal band is sized for (m frames either side)
+
+    int m = config.GetWindowSize();
+
+    uint64_t cacheKey = SimilarityCache::GetKey(SimilarityCache::GetVideoKey(videoFilePath), "coarse-to-fine", { double(coarseHeight), double(candidatesPerRow), double(m) });
+    SimilarityMatrix cached = SimilarityCache::GetSharedCache().Find(cacheKey, config.GetSigmaFactor());
+
+    if (cached.GetFrameCount() > 0) {
+        SaveMatrices(cached, videoFilePath, "euclidean");
+        return cached;
+    }
+
+    shared_ptr<FrameStore> frames = FrameStore::GetSharedStore(videoFilePath);
+    shared_ptr<FrameStore> coarseFrames = FrameStore::GetSharedStore(videoFilePath, coarseHeight);
 
-        // Save matrices as CSV and image files
-        output.SaveDistanceMatrixAsCSV(ComputeNewFilePath(videoFilePath, "distance", "euclidean", "csv"));
-        output.SaveProbabilityMatrixAsCSV(ComputeNewFilePath(videoFilePath, "probability", "euclidean", "csv"));
-        output.SaveDistanceMatrixAsImage(ComputeNewFilePath(videoFilePath, "distance", "euclidean", "png"));
-        output.SaveProbabilityMatrixAsImage(ComputeNewFilePath(videoFilePath, "probability", "euclidean", "png"));
+    if (frames->IsLoaded() && coarseFrames->IsLoaded()) {
+        Mat distanceMatrix = DistanceKernel::ComputeCoarseToFineDistanceMatrix(*frames, *coarseFrames, candidatesPerRow, m);
+        SimilarityMatrix output = StoreMatrix(distanceMatrix, config, cacheKey);
+
+        // Export matrices as binary, CSV and image files (replaces the Euclidean stage, so saved as such)
+        SaveMatrices(output, videoFilePath, "euclidean");
 
         return output;
     }
@@ -44,91 +172,775 @@ SimilarityMatrix SimilarityMeasure::ComputeEuclideanSimilarityMatrix(string vide
     return SimilarityMatrix();
 }
 
+// Creates similarity matrix holding exact distances to the K closest earlier frames of each frame (plus the diagonal band the motion
+// filter needs) - every other pair is rejected by the thumbnail prefilter or an early-exit comparison and stored as +inf
+SimilarityMatrix SimilarityMeasure::ComputePrefilteredSimilarityMatrix(string videoFilePath, int candidatesPerRow, SimilarityConfig config, PrefilterStatistics* statistics) {
+    // Parameters:
+    // - videoFilePath: file path for video
+    // - candidatesPerRow: number of backwards-pointing candidates kept per frame (K)
+    // - config: motion window the diagonal band is sized for (m frames either side)
+    // - statistics: receives the number of pairs rejected, abandoned and compared in full while selecting candidates (optional)
+
+    if (statistics)
+        *statistics = PrefilterStatistics();
+
+    int m = config.GetWindowSize();
+
+    uint64_t cacheKey = SimilarityCache::GetKey(SimilarityCache::GetVideoKey(videoFilePath), "prefiltered", { double(candidatesPerRow), double(m) });
+    SimilarityMatrix cached = SimilarityCache::GetSharedCache().Find(cacheKey, config.GetSigmaFactor());
+
+    if (cached.GetFrameCount() > 0) {
+        SaveMatrices(cached, videoFilePath, "euclidean");
+        return cached;
+    }
+
+    shared_ptr<FrameStore> frames = FrameStore::GetSharedStore(videoFilePath);
+
+    if (!frames->IsLoaded())
+        return SimilarityMatrix();
+
+    int frameCount = frames->GetFrameCount();
+
+    // 1. Candidates per row, then the diagonal neighbourhood of each (as for the sparse matrix)
+    vector<vector<int>> candidates = DistanceKernel::SelectBackwardCandidates(*frames, candidatesPerRow, statistics);
+    vector<vector<int>> pattern = SparseSimilarityMatrix::AddDiagonalBand(candidates, m);
+
+    vector<Point> pairs;
+    for (int i = 0; i < frameCount; i++) {
+        for (int j : pattern[i])
+            pairs.push_back(Point(i, j));
+    }
+
+    vector<float> distances = DistanceKernel::ComputePairDistances(*frames, pairs);
+
+    // 2. Kept pairs in both triangles (the matrix stays symmetric), everything else rejected
+    Mat distanceMatrix(frameCount, frameCount, CV_32F, Scalar(numeric_limits<float>::infinity()));
+
+    for (int i = 0; i < frameCount; i++)
+        distanceMatrix.at<float>(i, i) = 0;
+
+    for (size_t p = 0; p < pairs.size(); p++) {
+        distanceMatrix.at<float>(pairs[p].x, pairs[p].y) = distances[p];
+        distanceMatrix.at<float>(pairs[p].y, pairs[p].x) = distances[p];
+    }
+
+    SimilarityMatrix output = StoreMatrix(distanceMatrix, config, cacheKey);
+
+    // Export matrices as binary, CSV and image files (replaces the Euclidean stage, so saved as such)
+    SaveMatrices(output, videoFilePath, "euclidean");
+
+    return output;
+}
+
 // Creates similarity matrix by calculating Euclidean distance between sequences of frames
-SimilarityMatrix SimilarityMeasure::ComputeMotionSimilarityMatrix(string videoFilePath, SimilarityMatrix euclideanSimilarityMatrix) {
+SimilarityMatrix SimilarityMeasure::ComputeMotionSimilarityMatrix(string videoFilePath, const SimilarityMatrix& euclideanSimilarityMatrix, SimilarityConfig config) {
+    // Parameters:
+    // - videoFilePath: file path for video
+    // - euclideanSimilarityMatrix: distances between individual frames
+    // - config: motion filter weights (2m, applied along the diagonals) and sigma factor
+
+    // Only cached if the Euclidean matrix's provenance is known
+    uint64_t cacheKey = GetMotionKey(euclideanSimilarityMatrix.GetCacheKey(), config);
+    SimilarityMatrix cached = FindCachedMatrix(cacheKey, config);
+
+    if (cached.GetFrameCount() > 0) {
+        SaveMatrices(cached, videoFilePath, "motion");
+        return cached;
+    }
+
+    // Frames without a full window (first m, last m - 1) are not part of the output (compact matrices are dequantised on the fly)
+    Mat distanceMatrix;
+    if (euclideanSimilarityMatrix.IsCompact())
+        distanceMatrix = DiagonalFilter::Apply(*euclideanSimilarityMatrix.GetCompactMatrix(), config.GetWeights());
+    else
+        distanceMatrix = DiagonalFilter::Apply(euclideanSimilarityMatrix.GetDistanceMatrix(), config.GetWeights());
+
+    if (distanceMatrix.empty())
+        return SimilarityMatrix();
+
+    SimilarityMatrix output = StoreMatrix(distanceMatrix, config, cacheKey);
+
+    // Export matrices as binary, CSV and image files
+    SaveMatrices(output, videoFilePath, "motion");
+
+    return output;
+}
+
+// Creates motion similarity matrix straight from the video - Euclidean rows are streamed through the motion filter as soon as each
+// window is complete, so the Euclidean matrix is never held in full (only the motion matrix is resident)
+SimilarityMatrix SimilarityMeasure::ComputeFusedMotionSimilarityMatrix(string videoFilePath, SimilarityConfig config, SimilarityMatrix* euclideanSimilarityMatrix) {
+    // Parameters:
+    // - videoFilePath: file path for video
+    // - config: motion filter weights (2m, applied along the diagonals) and sigma factor
+    // - euclideanSimilarityMatrix: receives the full Euclidean matrix if set (only when explicitly requested, since it costs n^2 memory)
+
+    // Same keys as the separate Euclidean (full resolution, exact) and motion stages - a hit needs no decoding at all
+    uint64_t euclideanCacheKey = GetEuclideanKey(videoFilePath, 0, false, DistanceBackend::Exact);
+    uint64_t cacheKey = GetMotionKey(euclideanCacheKey, config);
+    SimilarityMatrix cached = FindCachedMatrix(cacheKey, config);
+
+    if ((cached.GetFrameCount() > 0) && euclideanSimilarityMatrix) {
+        *euclideanSimilarityMatrix = SimilarityCache::GetSharedCache().Find(euclideanCacheKey, config.GetSigmaFactor());
+        if (euclideanSimilarityMatrix->GetFrameCount() == 0)
+            cached = SimilarityMatrix();
+    }
+
+    if (cached.GetFrameCount() > 0) {
+        SaveMatrices(cached, videoFilePath, "motion");
+        if (euclideanSimilarityMatrix)
+            SaveMatrices(*euclideanSimilarityMatrix, videoFilePath, "euclidean");
+
+        return cached;
+    }
+
+    vector<float> weights = config.GetWeights();
+    shared_ptr<FrameStore> frames = FrameStore::GetSharedStore(videoFilePath);
+
+    int taps = int(weights.size());
+    int frameCount = frames->GetFrameCount();
+    int outputCount = frameCount - taps + 1;
+
+    if (!frames->IsLoaded() || (outputCount <= 0))
+        return SimilarityMatrix();
+
+    // Both matrices are symmetric, so only the upper triangles are computed: motion entry (r, c), c >= r, only reads Euclidean
+    // entries (r + t, c + t) on or above the diagonal. Euclidean rows are computed in bands (whose frames stay in cache) and kept
+    // in a window of the band plus the T - 1 rows before it
+    int bandRows = min(DistanceKernel::GetTileSize(frames->GetFrameStride()), MAX_FUSED_BAND_ROWS);
+    Mat window(bandRows + taps - 1, frameCount, CV_32F, Scalar(0));
+    Mat motionDistanceMatrix(outputCount, outputCount, CV_32F);
+    Mat euclideanDistanceMatrix;
+
+    if (euclideanSimilarityMatrix)
+        euclideanDistanceMatrix = Mat(frameCount, frameCount, CV_32F, Scalar(0));
+
+    for (int bandStart = 0; bandStart < frameCount; bandStart += bandRows) {
+        int bandEnd = min(bandStart + bandRows, frameCount);
+
+        // Window row k holds Euclidean row (bandStart - (T - 1) + k)
+        int windowStart = bandStart - (taps - 1);
+
+        // 1. Euclidean rows of the band (columns from the band onwards, one block of columns per task)
+        int blockCount = (frameCount - bandStart + bandRows - 1) / bandRows;
+
+        WorkStealingScheduler::Run(blockCount, [&](int b) {
+            int colStart = bandStart + b * bandRows;
+            int colEnd = min(colStart + bandRows, frameCount);
+            Mat block = DistanceKernel::ComputeDistanceBlock(*frames, bandStart, bandEnd, colStart, colEnd);
+
+            block.copyTo(window(Rect(colStart, taps - 1, colEnd - colStart, bandEnd - bandStart)));
+            if (euclideanSimilarityMatrix)
+                block.copyTo(euclideanDistanceMatrix(Rect(colStart, bandStart, colEnd - colStart, bandEnd - bandStart)));
+        });
+
+        // 2. Motion rows whose window ends in this band (upper triangle only)
+        int rowStart = max(bandStart - (taps - 1), 0);
+        int rowEnd = min(bandEnd - (taps - 1), outputCount);
+
+        WorkStealingScheduler::Run(rowEnd - rowStart, [&](int k) {
+            int r = rowStart + k;
+            DiagonalFilter::FilterRow(window, weights, r - windowStart, r, outputCount - r, motionDistanceMatrix.ptr<float>(r) + r);
+        });
+
+        // 3. Keep the last T - 1 Euclidean rows for the next band's windows
+        if (taps > 1)
+            window.rowRange(bandRows, bandRows + taps - 1).clone().copyTo(window.rowRange(0, taps - 1));
+    }
+
+    completeSymm(motionDistanceMatrix);
+
+    SimilarityMatrix output = StoreMatrix(motionDistanceMatrix, config, cacheKey);
+
+    // Export matrices as binary, CSV and image files
+    SaveMatrices(output, videoFilePath, "motion");
+
+    if (euclideanSimilarityMatrix) {
+        completeSymm(euclideanDistanceMatrix);
+        *euclideanSimilarityMatrix = SimilarityMatrix(euclideanDistanceMatrix, config.GetSigmaFactor());
+        euclideanSimilarityMatrix->SetCacheKey(euclideanCacheKey);
+        SimilarityCache::GetSharedCache().Insert(euclideanCacheKey, *euclideanSimilarityMatrix);
+        SaveMatrices(*euclideanSimilarityMatrix, videoFilePath, "euclidean");
+    }
+
+    return output;
+}
+
+// Incorporates future cost into distance calculations
+SimilarityMatrix SimilarityMeasure::ComputeFutureCostSimilarityMatrix(string videoFilePath, const SimilarityMatrix& motionSimilarityMatrix, SimilarityConfig config, FutureCostMethod method, vector<FutureCostIteration>* telemetry) {
+    // Parameters:
+    // - videoFilePath: file path for video
+    // - motionSimilarityMatrix: distances between sequences of frames
+    // - config: exponent p, discount alpha, solver tolerance / iteration limit and sigma factor
+    // - method: order in which row minima are propagated (Jacobi, in-place Gauss-Seidel or priority queue)
+    // - telemetry: receives the residual and time of each solver iteration (optional)
+
+    uint64_t cacheKey = GetFutureCostKey(motionSimilarityMatrix.GetCacheKey(), config, method);
+    SimilarityMatrix cached = FindCachedMatrix(cacheKey, config);
+
+    if (cached.GetFrameCount() > 0) {
+        // Nothing was iterated
+        if (telemetry)
+            telemetry->clear();
+
+        SaveMatrices(cached, videoFilePath, "future");
+        return cached;
+    }
+
+    // Calculate D''_ij = (D'_ij)^p + alpha * min_k(D''_jk), iterated until the row minima converge
+    FutureCostSolver solver(config.GetP(), config.GetAlpha(), config.GetTolerance(), config.GetMaxIterations(), method);
+
+    // Compact motion matrices are decoded row by row straight into the powered matrix the solver iterates on (the solver itself needs
+    // full precision, but no full precision copy of the motion matrix is made alongside it)
+    shared_ptr<const CompactMatrix> compactMotion = motionSimilarityMatrix.GetCompactMatrix();
+    Mat distanceMatrix;
+
+    if (compactMotion)
+        distanceMatrix = solver.SolvePowered(FutureCostSolver::RaiseToPower(*compactMotion, config.GetP()));
+    else
+        distanceMatrix = solver.Solve(motionSimilarityMatrix.GetDenseDistanceMatrix());
+
+    if (telemetry)
+        *telemetry = solver.GetTelemetry();
+
+    if (distanceMatrix.empty())
+        return SimilarityMatrix();
+
+    SimilarityMatrix output = StoreMatrix(distanceMatrix, config, cacheKey);
+
+    // Export matrices as binary, CSV and image files
+    SaveMatrices(output, videoFilePath, "future");
+
+    return output;
+}
+
+// Updates a Euclidean similarity matrix after frames were appended to (or trimmed from the end of) the video - distances between the
+// leading frames that are unchanged (same frame hash) are reused, so only pairs involving a changed frame are compared
+SimilarityMatrix SimilarityMeasure::UpdateEuclideanSimilarityMatrix(string videoFilePath, const SimilarityMatrix& previousEuclideanSimilarityMatrix, const vector<uint64_t>& previousFrameHashes, int* unchangedFrameCount, int workingHeight, bool greyscale) {
+    // Parameters:
+    // - videoFilePath: file path for (the new version of) the video
+    // - previousEuclideanSimilarityMatrix: exact Euclidean matrix of the previous version of the video
+    // - previousFrameHashes: frame hashes of the previous version (see FrameStore::GetFrameHashes - same working height and greyscale)
+    // - unchangedFrameCount: receives the number of leading frames whose distances were reused (optional - 0 if found in the cache)
+    // - workingHeight, greyscale: as for ComputeEuclideanSimilarityMatrix (must match the previous matrix)
+
+    if (unchangedFrameCount)
+        *unchangedFrameCount = 0;
+
+    uint64_t cacheKey = GetEuclideanKey(videoFilePath, workingHeight, greyscale, DistanceBackend::Exact);
+    SimilarityMatrix cached = SimilarityCache::GetSharedCache().Find(cacheKey);
+
+    if (cached.GetFrameCount() > 0) {
+        SaveMatrices(cached, videoFilePath, "euclidean");
+        return cached;
+    }
+
+    shared_ptr<FrameStore> frames = FrameStore::GetSharedStore(videoFilePath, workingHeight, greyscale);
+
+    if (!frames->IsLoaded())
+        return SimilarityMatrix();
+
+    // Compact matrices hold approximate distances, so nothing is reused from them
+    int unchanged = FrameStore::GetMatchingPrefixLength(frames->GetFrameHashes(), previousFrameHashes);
+    if (previousEuclideanSimilarityMatrix.IsCompact() || (previousEuclideanSimilarityMatrix.GetFrameCount() != int(previousFrameHashes.size())))
+        unchanged = 0;
+
+    Mat previousDistanceMatrix = (unchanged > 0) ? previousEuclideanSimilarityMatrix.GetDenseDistanceMatrix() : Mat();
+    Mat distanceMatrix = DistanceKernel::ExtendEuclideanDistanceMatrix(*frames, previousDistanceMatrix, unchanged);
+
+    if (unchangedFrameCount)
+        *unchangedFrameCount = unchanged;
+
+    SimilarityMatrix output(distanceMatrix);
+    output.SetCacheKey(cacheKey);
+    SimilarityCache::GetSharedCache().Insert(cacheKey, output);
+
+    // Export matrices as binary, CSV and image files
+    SaveMatrices(output, videoFilePath, "euclidean");
+
+    return output;
+}
+
+// Updates a motion similarity matrix after frames were appended to (or trimmed from the end of) the video - rows/columns whose window
+// only covers unchanged frames are copied from the previous matrix, and only the Euclidean rows the other windows read are computed
+// (like the fused stage, the full Euclidean matrix is never needed)
+SimilarityMatrix SimilarityMeasure::UpdateMotionSimilarityMatrix(string videoFilePath, const SimilarityMatrix& previousMotionSimilarityMatrix, const vector<uint64_t>& previousFrameHashes, SimilarityConfig config, int* unchangedFrameCount) {
+    // Parameters:
+    // - videoFilePath: file path for the new version of the video
+    // - previousMotionSimilarityMatrix: motion matrix of the previous version (filtered with the same weights)
+    // - previousFrameHashes: frame hashes of the previous version (see FrameStore::GetFrameHashes)
+    // - config: motion filter weights (2m, applied along the diagonals), sigma factor and storage
+    // - unchangedFrameCount: receives the number of leading frames that were reused (optional)
+
+    if (unchangedFrameCount)
+        *unchangedFrameCount = 0;
+
+    // Same key as the separate and fused motion stages
+    uint64_t cacheKey = GetMotionKey(GetEuclideanKey(videoFilePath, 0, false, DistanceBackend::Exact), config);
+    SimilarityMatrix cached = FindCachedMatrix(cacheKey, config);
+
+    if (cached.GetFrameCount() > 0) {
+        SaveMatrices(cached, videoFilePath, "motion");
+        return cached;
+    }
+
+    vector<float> weights = config.GetWeights();
+    shared_ptr<FrameStore> frames = FrameStore::GetSharedStore(videoFilePath);
+
+    int taps = int(weights.size());
+    int frameCount = frames->GetFrameCount();
+    int outputCount = frameCount - taps + 1;
+
+    if (!frames->IsLoaded() || (outputCount <= 0))
+        return SimilarityMatrix();
+
+    // Output row r reads frames r ... r + T - 1, so the first (unchanged frames - T + 1) rows are unchanged (nothing is reused from
+    // compact matrices, which hold approximate distances)
+    int unchanged = FrameStore::GetMatchingPrefixLength(frames->GetFrameHashes(), previousFrameHashes);
+    int firstRow = previousMotionSimilarityMatrix.IsCompact() ? 0 : max(unchanged - taps + 1, 0);
+    firstRow = min(firstRow, min(previousMotionSimilarityMatrix.GetFrameCount(), outputCount));
+
+    // Nothing to reuse (e.g. a different video) - the fused stage only computes the upper triangle
+    if (firstRow == 0)
+        return ComputeFusedMotionSimilarityMatrix(videoFilePath, config);
+
+    if (unchangedFrameCount)
+        *unchangedFrameCount = unchanged;
+
+    // Euclidean rows firstRow ... n - 1 (every column, one tile per task)
+    int tileSize = DistanceKernel::GetTileSize(frames->GetFrameStride());
+    int rowBlockCount = (frameCount - firstRow + tileSize - 1) / tileSize;
+    int colBlockCount = (frameCount + tileSize - 1) / tileSize;
+    Mat distanceRows(frameCount - firstRow, frameCount, CV_32F);
+
+    WorkStealingScheduler::Run(rowBlockCount * colBlockCount, [&](int b) {
+        int rowStart = firstRow + (b / colBlockCount) * tileSize;
+        int rowEnd = min(rowStart + tileSize, frameCount);
+        int colStart = (b % colBlockCount) * tileSize;
+        int colEnd = min(colStart + tileSize, frameCount);
+        Mat block = DistanceKernel::ComputeDistanceBlock(*frames, rowStart, rowEnd, colStart, colEnd);
+
+        block.copyTo(distanceRows(Rect(colStart, rowStart - firstRow, colEnd - colStart, rowEnd - rowStart)));
+    });
+
+    Mat previousDistanceMatrix = (firstRow > 0) ? previousMotionSimilarityMatrix.GetDenseDistanceMatrix() : Mat();
+    Mat distanceMatrix = DiagonalFilter::ApplyIncremental(distanceRows, firstRow, previousDistanceMatrix, weights);
+
+    if (distanceMatrix.empty())
+        return SimilarityMatrix();
+
+    SimilarityMatrix output = StoreMatrix(distanceMatrix, config, cacheKey);
+
+    // Export matrices as binary, CSV and image files
+    SaveMatrices(output, videoFilePath, "motion");
+
+    return output;
+}
+
+// Updates a future cost similarity matrix after frames were appended - the solver starts from the previous solution's row minima rather
+// than from zero, so it only iterates until the effect of the new frames has propagated
+SimilarityMatrix SimilarityMeasure::UpdateFutureCostSimilarityMatrix(string videoFilePath, const SimilarityMatrix& motionSimilarityMatrix, const SimilarityMatrix& previousFutureCostSimilarityMatrix, SimilarityConfig config, FutureCostMethod method, vector<FutureCostIteration>* telemetry) {
+    // Parameters:
+    // - videoFilePath: file path for video
+    // - motionSimilarityMatrix: distances between sequences of frames of the new version of the video
+    // - previousFutureCostSimilarityMatrix: future cost matrix of the previous version (any parameters - it is only a starting point)
+    // - config: exponent p, discount alpha, solver tolerance / iteration limit, sigma factor and storage
+    // - method: order in which row minima are propagated (priority queue warm starts use Gauss-Seidel, see FutureCostSolver)
+    // - telemetry: receives the residual and time of each solver iteration (optional)
+
+    uint64_t cacheKey = GetFutureCostKey(motionSimilarityMatrix.GetCacheKey(), config, method);
+    SimilarityMatrix cached = FindCachedMatrix(cacheKey, config);
+
+    if (cached.GetFrameCount() > 0) {
+        if (telemetry)
+            telemetry->clear();
 
-    Mat euclideanDistanceMatrix = euclideanSimilarityMatrix.GetDistanceMatrix();
-    int frameCount = euclideanDistanceMatrix.rows;
-    Mat distanceMatrix(frameCount, frameCount, CV_32F);
+        SaveMatrices(cached, videoFilePath, "future");
+        return cached;
+    }
+
+    FutureCostSolver solver(config.GetP(), config.GetAlpha(), config.GetTolerance(), config.GetMaxIterations(), method);
+    solver.SetInitialMinima(FutureCostSolver::GetRowMinima(previousFutureCostSimilarityMatrix.GetDenseDistanceMatrix()));
+
+    // Compact motion matrices are decoded row by row into the powered matrix (as in ComputeFutureCostSimilarityMatrix)
+    shared_ptr<const CompactMatrix> compactMotion = motionSimilarityMatrix.GetCompactMatrix();
+    Mat distanceMatrix;
+
+    if (compactMotion)
+        distanceMatrix = solver.SolvePowered(FutureCostSolver::RaiseToPower(*compactMotion, config.GetP()));
+    else
+        distanceMatrix = solver.Solve(motionSimilarityMatrix.GetDenseDistanceMatrix());
+
+    if (telemetry)
+        *telemetry = solver.GetTelemetry();
+
+    if (distanceMatrix.empty())
+        return SimilarityMatrix();
 
-    int m = 2;
-    int weights[] = { 1, 1, 1, 1 };
+    SimilarityMatrix output = StoreMatrix(distanceMatrix, config, cacheKey);
 
+    // Export matrices as binary, CSV and image files
+    SaveMatrices(output, videoFilePath, "future");
+
+    return output;
+}
+
+// Creates sparse similarity matrix holding the K closest earlier frames of each frame (plus the diagonal band the motion filter needs)
+SparseSimilarityMatrix SimilarityMeasure::ComputeSparseEuclideanSimilarityMatrix(string videoFilePath, int candidatesPerRow, int coarseHeight, SimilarityConfig config, PrefilterStatistics* statistics) {
+    // Parameters:
+    // - videoFilePath: file path for video
+    // - candidatesPerRow: number of backwards-pointing candidates kept per frame (K)
+    // - coarseHeight: height candidates are selected at (0 selects at full resolution) - kept entries are always exact
+    // - config: motion window the diagonal band is sized for (m frames either side)
+    // - statistics: receives the number of pairs rejected, abandoned and compared in full while selecting candidates (optional)
+
+    int m = config.GetWindowSize();
+
+    shared_ptr<FrameStore> frames = FrameStore::GetSharedStore(videoFilePath);
+    shared_ptr<FrameStore> selectionFrames = (coarseHeight > 0) ? FrameStore::GetSharedStore(videoFilePath, coarseHeight) : frames;
+
+    if (!frames->IsLoaded() || (selectionFrames->GetFrameCount() != frames->GetFrameCount()))
+        return SparseSimilarityMatrix();
+
+    int frameCount = frames->GetFrameCount();
+
+    // 1. Candidates per row (memory is O(n * K) - the n x n matrix is never stored)
+    vector<vector<int>> candidates = DistanceKernel::SelectBackwardCandidates(*selectionFrames, candidatesPerRow, statistics);
+
+    // 2. Add diagonal neighbourhood of each candidate, then compute exact distances for every kept entry
+    vector<vector<int>> pattern = SparseSimilarityMatrix::AddDiagonalBand(candidates, m);
+
+    vector<Point> pairs;
     for (int i = 0; i < frameCount; i++) {
-        for (int j = 0; j < frameCount; j++) {
+        for (int j : pattern[i])
+            pairs.push_back(Point(i, j));
+    }
+
+    vector<float> distances = DistanceKernel::ComputePairDistances(*frames, pairs);
+
+    vector<vector<pair<int, float>>> rows(frameCount);
+    for (size_t p = 0; p < pairs.size(); p++)
+        rows[pairs[p].x].push_back(make_pair(pairs[p].y, distances[p]));
+
+    return SparseSimilarityMatrix(frameCount, rows);
+}
+
+// Creates sparse motion similarity matrix (same filter and trimming as the dense version, evaluated only where all diagonal neighbours are stored)
+SparseSimilarityMatrix SimilarityMeasure::ComputeSparseMotionSimilarityMatrix(SparseSimilarityMatrix euclideanSimilarityMatrix, SimilarityConfig config) {
+    int frameCount = euclideanSimilarityMatrix.GetFrameCount();
+
+    vector<float> weights = config.GetWeights();
+    int taps = int(weights.size());
+    int m = taps / 2;
+
+    // Rows/columns without a full window are trimmed (as for the dense matrix)
+    int outputCount = max(frameCount - taps + 1, 0);
+    vector<vector<pair<int, float>>> rows(outputCount);
+
+    WorkStealingScheduler::Run(outputCount, [&](int row) {
+        int i = row + m;
+        const int* columns = euclideanSimilarityMatrix.GetRowColumns(i);
+
+        for (int c = 0; c < euclideanSimilarityMatrix.GetRowLength(i); c++) {
+            int j = columns[c];
+            if ((j < m) || (j - m + taps > frameCount))
+                continue;
 
             // Calculate Dij
             float newDistance = 0;
-            for (int k = -1 * m; k < m; k++) {
-                if ((k + i < 0) || (k + j < 0) || (k + i >= frameCount) || (k + j >= frameCount)) {
+            for (int k = -1 * m; k < taps - m; k++) {
+                float distance = euclideanSimilarityMatrix.GetValue(i + k, j + k);
+                if (distance == FLT_MAX) {
                     newDistance = -1;
                     break;
                 }
-                else
-                    newDistance += weights[k + 2] * euclideanDistanceMatrix.at<float>(i + k, j + k);
+                newDistance += weights[k + m] * distance;
             }
-            distanceMatrix.at<float>(i, j) = newDistance;
+
+            if (newDistance >= 0)
+                rows[row].push_back(make_pair(j - m, newDistance));
         }
-    }
+    });
 
-    distanceMatrix = RemoveInvalidFrames(distanceMatrix);
+    return SparseSimilarityMatrix(outputCount, rows);
+}
 
-    SimilarityMatrix output(distanceMatrix);
+// Incorporates future cost into the stored entries of a sparse motion matrix (min_k D''_jk is taken over the entries stored in row j)
+SparseSimilarityMatrix SimilarityMeasure::ComputeSparseFutureCostSimilarityMatrix(SparseSimilarityMatrix motionSimilarityMatrix, SimilarityConfig config, vector<FutureCostIteration>* telemetry) {
+    // Parameters:
+    // - motionSimilarityMatrix: distances between sequences of frames (stored entries only)
+    // - config: exponent p, discount alpha and solver tolerance / iteration limit
+    // - telemetry: receives the residual and time of each solver iteration (optional)
+
+    FutureCostSolver solver(config.GetP(), config.GetAlpha(), config.GetTolerance(), config.GetMaxIterations());
+    SparseSimilarityMatrix output = solver.SolveSparse(motionSimilarityMatrix);
 
-    // Save matrices as CSV and image files
-    output.SaveDistanceMatrixAsCSV(ComputeNewFilePath(videoFilePath, "distance", "motion", "csv"));
-    output.SaveProbabilityMatrixAsCSV(ComputeNewFilePath(videoFilePath, "probability", "motion", "csv"));
-    output.SaveDistanceMatrixAsImage(ComputeNewFilePath(videoFilePath, "distance", "motion", "png"));
-    output.SaveProbabilityMatrixAsImage(ComputeNewFilePath(videoFilePath, "probability", "motion", "png"));
+    if (telemetry)
+        *telemetry = solver.GetTelemetry();
 
     return output;
 }
 
-// Incorporates future cost into distance calculations
-SimilarityMatrix SimilarityMeasure::ComputeFutureCostSimilarityMatrix(string videoFilePath, SimilarityMatrix motionSimilarityMatrix) {
-    Mat distanceMatrix, motionDistanceMatrixPowP, probabilityMatrix;
-    Mat motionDistanceMatrix = motionSimilarityMatrix.GetDistanceMatrix();
-
-    double p = 0.75;
-    float alpha = 0.995;
-
-    pow(motionDistanceMatrix, p, motionDistanceMatrixPowP);
-    distanceMatrix = motionDistanceMatrixPowP;
-    Mat distanceMatrixLowestValuePerRow = GetMatrixRowLowestValues(distanceMatrix);
-
-    bool change = true;
-    while (change) {
-        change = false;
-        Mat prev = distanceMatrixLowestValuePerRow;
-        distanceMatrixLowestValuePerRow = GetMatrixRowLowestValues(distanceMatrix);
-
-        Mat dst;
-        bitwise_xor(distanceMatrixLowestValuePerRow, prev, dst);
-        if (countNonZero(dst) > 0)
-            break;
-
-        for (int i = distanceMatrix.rows - 1; i >= 0; i--) {
-            for (int j = 0; j < distanceMatrix.cols; j++) {
-                // Calculate D''_ij = (D'_ij)^p + alpha * min_k(D''_jk)
-                distanceMatrix.at<float>(i, j) = motionDistanceMatrixPowP.at<float>(i, j) + (alpha * distanceMatrixLowestValuePerRow.at<float>(j));
-            }
-        }
+// Creates on-disk (tiled) similarity matrix by calculating Euclidean distance between individual frames, for videos whose n^2 matrix does not fit in memory
+SimilarityMatrix SimilarityMeasure::ComputeOutOfCoreEuclideanSimilarityMatrix(string videoFilePath, int workingHeight, size_t memoryBudget, function<void(int, int)> progress) {
+    // Parameters:
+    // - videoFilePath: file path for video
+    // - workingHeight: height frames are compared at (0 compares at the source resolution - the decoded frames are held in memory)
+    // - memoryBudget: maximum bytes of matrix tiles mapped at once
+    // - progress: called with (tiles completed, total tiles) as each tile is written (from worker threads)
+
+    shared_ptr<FrameStore> frames = FrameStore::GetSharedStore(videoFilePath, workingHeight);
+
+    if (!frames->IsLoaded())
+        return SimilarityMatrix();
+
+    int frameCount = frames->GetFrameCount();
+    shared_ptr<TiledMatrixStore> store = make_shared<TiledMatrixStore>();
+
+    if (!store->Create(ComputeNewFilePath(videoFilePath, "distance", "euclidean", "tiles"), frameCount, frameCount, TiledMatrixStore::DEFAULT_TILE_SIZE, memoryBudget))
+        return SimilarityMatrix();
+
+    // Only tiles on or above the diagonal are computed - each is written twice (transposed below the diagonal)
+    int tileSize = store->GetTileSize();
+    int tileCount = store->GetTileRowCount();
+
+    vector<Point> tiles;
+    for (int tileRow = 0; tileRow < tileCount; tileRow++) {
+        for (int tileCol = tileRow; tileCol < tileCount; tileCol++)
+            tiles.push_back(Point(tileCol, tileRow));
     }
 
-    SimilarityMatrix output(distanceMatrix);
+    store->ResetProgress();
 
-    // Save matrices as CSV and image files
-    output.SaveDistanceMatrixAsCSV(ComputeNewFilePath(videoFilePath, "distance", "future", "csv"));
-    output.SaveProbabilityMatrixAsCSV(ComputeNewFilePath(videoFilePath, "probability", "future", "csv"));
-    output.SaveDistanceMatrixAsImage(ComputeNewFilePath(videoFilePath, "distance", "future", "png"));
-    output.SaveProbabilityMatrixAsImage(ComputeNewFilePath(videoFilePath, "probability", "future", "png"));
+    WorkStealingScheduler::Run(int(tiles.size()), [&](int t) {
+        int rowStart = tiles[t].y * tileSize;
+        int colStart = tiles[t].x * tileSize;
+        Mat block = DistanceKernel::ComputeDistanceBlock(*frames, rowStart, min(rowStart + tileSize, frameCount), colStart, min(colStart + tileSize, frameCount));
 
-    return output;
+        store->WriteTile(tiles[t].y, tiles[t].x, block);
+        int completed = store->CompleteTile();
+
+        if (tiles[t].x != tiles[t].y) {
+            store->WriteTile(tiles[t].x, tiles[t].y, block.t());
+            completed = store->CompleteTile();
+        }
+
+        if (progress)
+            progress(completed, store->GetTileCount());
+    });
+
+    return SimilarityMatrix(store);
 }
 
-//--------------------------------------------------------------------------------------
-// Static Methods (Private)
-//--------------------------------------------------------------------------------------
+// Creates on-disk (tiled) similarity matrix by calculating Euclidean distance between sequences of frames (same filter and trimming as the in-memory version)
+SimilarityMatrix SimilarityMeasure::ComputeOutOfCoreMotionSimilarityMatrix(string videoFilePath, const SimilarityMatrix& euclideanSimilarityMatrix, SimilarityConfig config, function<void(int, int)> progress) {
+    shared_ptr<TiledMatrixStore> euclidean = euclideanSimilarityMatrix.GetTiledStore();
+
+    if (!euclidean)
+        return SimilarityMatrix();
+
+    vector<float> weights = config.GetWeights();
+    int taps = int(weights.size());
+
+    // Output entry (r, c) is sum_t w_t * D(r + t, c + t), t in [0, 2m) - the first m and last m - 1 frames have no full window
+    int frameCount = euclidean->GetRows() - taps + 1;
+    if (frameCount <= 0)
+        return SimilarityMatrix();
+
+    shared_ptr<TiledMatrixStore> store = make_shared<TiledMatrixStore>();
+
+    if (!store->Create(ComputeNewFilePath(videoFilePath, "distance", "motion", "tiles"), frameCount, frameCount, euclidean->GetTileSize(), euclidean->GetMemoryBudget()))
+        return SimilarityMatrix();
+
+    int tileSize = store->GetTileSize();
+    int tileColCount = store->GetTileColCount();
+    store->ResetProgress();
+
+    WorkStealingScheduler::Run(store->GetTileCount(), [&](int t) {
+        int rowStart = (t / tileColCount) * tileSize;
+        int colStart = (t % tileColCount) * tileSize;
+        int rows = min(tileSize, frameCount - rowStart);
+        int cols = min(tileSize, frameCount - colStart);
+
+        // Window of the Euclidean matrix read by this tile (overlaps neighbouring tiles by 2m - 1)
+        Mat window = euclidean->ReadRegion(rowStart, rowStart + rows + taps - 1, colStart, colStart + cols + taps - 1);
+        Mat tile = DiagonalFilter::Apply(window, weights, 1);
+
+        store->WriteTile(t / tileColCount, t % tileColCount, tile);
+        int completed = store->CompleteTile();
+
+        if (progress)
+            progress(completed, store->GetTileCount());
+    });
+
+    return SimilarityMatrix(store);
+}
+
+// Incorporates future cost into an on-disk (tiled) motion matrix, streaming over the tiles once per iteration
+SimilarityMatrix SimilarityMeasure::ComputeOutOfCoreFutureCostSimilarityMatrix(string videoFilePath, const SimilarityMatrix& motionSimilarityMatrix, SimilarityConfig config, function<void(int, int)> progress, vector<FutureCostIteration>* telemetry) {
+    // Only the row minima (n values) are iterated: D''_ij = (D'_ij)^p + alpha * m_j, where m_j = min_k D''_jk (k != j), so each
+    // iteration is m_i = min_j ((D'_ij)^p + alpha * m_j) and the full matrix is only written once the minima have converged (see
+    // FutureCostSolver::SolveOutOfCore)
+
+    shared_ptr<TiledMatrixStore> motion = motionSimilarityMatrix.GetTiledStore();
+
+    if (!motion)
+        return SimilarityMatrix();
+
+    int frameCount = motion->GetRows();
+    shared_ptr<TiledMatrixStore> store = make_shared<TiledMatrixStore>();
+
+    if (!store->Create(ComputeNewFilePath(videoFilePath, "distance", "future", "tiles"), frameCount, frameCount, motion->GetTileSize(), motion->GetMemoryBudget()))
+        return SimilarityMatrix();
+
+    FutureCostSolver solver(config.GetP(), config.GetAlpha(), config.GetTolerance(), config.GetMaxIterations());
+    bool solved = solver.SolveOutOfCore(*motion, *store, progress);
+
+    if (telemetry)
+        *telemetry = solver.GetTelemetry();
+
+    if (!solved)
+        return SimilarityMatrix();
+
+    return SimilarityMatrix(store);
+}
+
+// Checks that a Euclidean backend reproduces the exact distance matrix to within a relative tolerance
+bool SimilarityMeasure::VerifyEuclideanBackend(string videoFilePath, DistanceBackend backend, double tolerance, int workingHeight, bool greyscale) {
+    shared_ptr<FrameStore> frames = FrameStore::GetSharedStore(videoFilePath, workingHeight, greyscale);
+
+    if (!frames->IsLoaded())
+        return false;
+
+    Mat reference = DistanceKernel::ComputeEuclideanDistanceMatrix(*frames, DistanceBackend::Exact);
+    Mat candidate = DistanceKernel::ComputeEuclideanDistanceMatrix(*frames, backend);
+
+    return DistanceKernel::CheckTolerance(reference, candidate, tolerance);
+}
+
+// Reports rank correlation between descriptor distances and exact distances (used to pick a descriptor size)
+double SimilarityMeasure::GetDescriptorRankCorrelation(string videoFilePath, int thumbnailHeight, int dimensions) {
+    shared_ptr<FrameStore> frames = FrameStore::GetSharedStore(videoFilePath);
+
+    if (!frames->IsLoaded())
+        return 0;
+
+    Mat exact = DistanceKernel::ComputeEuclideanDistanceMatrix(*frames);
+    Mat approximate = FrameDescriptor::ComputeDistanceMatrix(FrameDescriptor::ComputeDescriptors(*frames, thumbnailHeight, dimensions));
+
+    return FrameDescriptor::GetRankCorrelation(exact, approximate);
+}
+
+// Diffs coarse-to-fine against exhaustive computation after the motion filter (the matrix transitions are chosen from) - returns fraction
+// of rows whose lowest-cost transition is unchanged
+double SimilarityMeasure::VerifyCoarseToFine(string videoFilePath, int coarseHeight, int candidatesPerRow, SimilarityConfig config) {
+    // Parameters:
+    // - videoFilePath: file path for video
+    // - coarseHeight, candidatesPerRow: as for ComputeCoarseToFineSimilarityMatrix
+    // - config: motion filter both matrices are filtered with
+
+    shared_ptr<FrameStore> frames = FrameStore::GetSharedStore(videoFilePath);
+    shared_ptr<FrameStore> coarseFrames = FrameStore::GetSharedStore(videoFilePath, coarseHeight);
+
+    if (!frames->IsLoaded() || !coarseFrames->IsLoaded())
+        return 0;
+
+    Mat exhaustive = DistanceKernel::ComputeEuclideanDistanceMatrix(*frames);
+    Mat coarseToFine = DistanceKernel::ComputeCoarseToFineDistanceMatrix(*frames, *coarseFrames, candidatesPerRow, config.GetWindowSize());
+
+    Mat exhaustiveMotion = DiagonalFilter::Apply(exhaustive, config.GetWeights());
+    Mat coarseToFineMotion = DiagonalFilter::Apply(coarseToFine, config.GetWeights());
+
+    return double(DistanceKernel::CountMatchingRowMinima(exhaustiveMotion, coarseToFineMotion)) / max(exhaustiveMotion.rows, 1);
+}
+
+// Checks that a future cost method converges to the Jacobi reference to within a relative tolerance
+bool SimilarityMeasure::VerifyFutureCostMethod(const SimilarityMatrix& motionSimilarityMatrix, FutureCostMethod method, SimilarityConfig config, double tolerance, long long* rowUpdatesSaved) {
+    // Parameters:
+    // - motionSimilarityMatrix: distances between sequences of frames
+    // - method: future cost method being checked
+    // - config: exponent p, discount alpha and solver tolerance / iteration limit both solvers are run with
+    // - tolerance: largest relative difference allowed between the two future cost matrices
+    // - rowUpdatesSaved: receives the number of row minima the method recomputed fewer times than Jacobi (optional)
+
+    Mat motion = motionSimilarityMatrix.GetDenseDistanceMatrix();
+
+    if (motion.empty())
+        return false;
+
+    FutureCostSolver reference(config.GetP(), config.GetAlpha(), config.GetTolerance(), config.GetMaxIterations());
+    FutureCostSolver candidate(config.GetP(), config.GetAlpha(), config.GetTolerance(), config.GetMaxIterations(), method);
+
+    Mat referenceMatrix = reference.Solve(motion);
+    Mat candidateMatrix = candidate.Solve(motion);
+
+    if (rowUpdatesSaved)
+        *rowUpdatesSaved = reference.GetRowUpdateCount() - candidate.GetRowUpdateCount();
+
+    if (!reference.HasConverged() || !candidate.HasConverged())
+        return false;
+
+    return DistanceKernel::CheckTolerance(referenceMatrix, candidateMatrix, tolerance);
+}
+
+// Runs the similarity measure once per configuration (nothing is exported) - the Euclidean matrix is computed once, and the motion matrix
+// and powered motion distances are shared by every configuration with the same weights / exponent
+void SimilarityMeasure::RunParameterSweep(string videoFilePath, vector<SimilarityConfig> configs, function<void(int, const SimilarityMatrix&, const SimilarityMatrix&)> visit) {
+    // Parameters:
+    // - videoFilePath: file path for video
+    // - configs: configurations to evaluate (see SimilarityConfig::CreateSweep)
+    // - visit: called with the index of each configuration and its motion and future cost matrices (grouped by weights, not in index order)
+
+    shared_ptr<FrameStore> frames = FrameStore::GetSharedStore(videoFilePath);
+
+    if (!frames->IsLoaded())
+        return;
+
+    Mat euclidean = DistanceKernel::ComputeEuclideanDistanceMatrix(*frames);
+
+    // Configurations sharing weights (then exponent) are run one after another
+    vector<int> order(configs.size());
+    iota(order.begin(), order.end(), 0);
+
+    stable_sort(order.begin(), order.end(), [&](int a, int b) {
+        vector<float> weightsA = configs[a].GetWeights();
+        vector<float> weightsB = configs[b].GetWeights();
+
+        if (weightsA != weightsB)
+            return (weightsA < weightsB);
+
+        return (configs[a].GetP() < configs[b].GetP());
+    });
+
+    vector<float> weights;
+    double p = 0;
+    Mat motion, motionPowP;
+
+    for (int index : order) {
+        SimilarityConfig& config = configs[index];
+
+        if (motion.empty() || (config.GetWeights() != weights)) {
+            weights = config.GetWeights();
+            motion = DiagonalFilter::Apply(euclidean, weights);
+            motionPowP = Mat();
+
+            if (motion.empty())
+                continue;
+        }
+
+        if (motionPowP.empty() || (config.GetP() != p)) {
+            p = config.GetP();
+            motionPowP = FutureCostSolver::RaiseToPower(motion, p);
+        }
+
+        FutureCostSolver solver(p, config.GetAlpha(), config.GetTolerance(), config.GetMaxIterations());
+        Mat futureCost = solver.SolvePowered(motionPowP);
+
+        SimilarityMatrix motionSimilarityMatrix(motion, config.GetSigmaFactor());
+        SimilarityMatrix futureCostSimilarityMatrix(futureCost, config.GetSigmaFactor());
+
+        visit(index, motionSimilarityMatrix, futureCostSimilarityMatrix);
+    }
+}
 
 // Computes new file path when saving distance/probability matrix
 string SimilarityMeasure::ComputeNewFilePath(string originalFilePath, string matrixRepresentation, string matrixType, string extension) {
@@ -141,24 +953,76 @@ string SimilarityMeasure::ComputeNewFilePath(string originalFilePath, string mat
     string filename = (originalFilePath.substr(originalFilePath.find_last_of("/\\") + 1));
     filename = filename.substr(0, filename.find('.'));
 
-    if (extension == "csv")
+    if ((extension == "csv") || (extension == "vtm"))
         filename = filename + "_" + ToUpper(matrixRepresentation) + "_MATRIX_(" + ToUpper(matrixType) + ")." + extension;
     else if (extension == "png")
         filename = filename + "_" + ToUpper(matrixRepresentation) + "_IMAGE_(" + ToUpper(matrixType) + ")." + extension;
+    else if (extension == "tiles")
+        filename = filename + "_" + ToUpper(matrixRepresentation) + "_TILES_(" + ToUpper(matrixType) + ")." + extension;
 
     return filename;
 }
 
-// Removes frames from matrix that are not used in calculations
-Mat SimilarityMeasure::RemoveInvalidFrames(Mat input) {
-    Mat output(input.rows, input.cols, CV_32F);
+//--------------------------------------------------------------------------------------
+// Static Methods (Private)
+//--------------------------------------------------------------------------------------
+
+// Wraps the output of a stage in the configured storage, storing it in the cache first (at full precision)
+SimilarityMatrix SimilarityMeasure::StoreMatrix(Mat distanceMatrix, SimilarityConfig& config, uint64_t cacheKey) {
+    // Parameters:
+    // - distanceMatrix: full precision output of the stage
+    // - config: storage and sigma factor of the returned matrix
+    // - cacheKey: key of the stage's output (0 if the output is not cached)
+
+    SimilarityMatrix output(distanceMatrix, config.GetSigmaFactor());
+    output.SetCacheKey(cacheKey);
+
+    SimilarityCache::GetSharedCache().Insert(cacheKey, output);
+
+    return ApplyStorage(output, config);
+}
+
+// Looks up the output of a stage in the cache, returned in the configured storage (empty on a miss)
+SimilarityMatrix SimilarityMeasure::FindCachedMatrix(uint64_t cacheKey, SimilarityConfig& config) {
+    SimilarityMatrix cached = SimilarityCache::GetSharedCache().Find(cacheKey, config.GetSigmaFactor());
+
+    if (cached.GetFrameCount() == 0)
+        return cached;
+
+    return ApplyStorage(cached, config);
+}
 
-    output = RemoveMatrixColumn(input, 0);
-    output = RemoveMatrixColumn(output, 0);
-    output = RemoveMatrixColumn(output, output.cols - 1);
-    output = RemoveMatrixRow(output, 0);
-    output = RemoveMatrixRow(output, 0);
-    output = RemoveMatrixRow(output, output.rows - 1);
+// Converts a full precision matrix to the configured storage (compact matrices get their own key, since stages reading them see the
+// dequantised values)
+SimilarityMatrix SimilarityMeasure::ApplyStorage(SimilarityMatrix matrix, SimilarityConfig& config) {
+    if (config.GetStorage() == MatrixStorage::Float32)
+        return matrix;
+
+    SimilarityMatrix output = matrix.ToStorage(config.GetStorage());
+    output.SetCacheKey(SimilarityCache::GetKey(matrix.GetCacheKey(), "storage", { double(config.GetStorage()) }));
 
     return output;
+}
+
+// Returns the cache key of a Euclidean stage
+uint64_t SimilarityMeasure::GetEuclideanKey(string videoFilePath, int workingHeight, bool greyscale, DistanceBackend backend) {
+    return SimilarityCache::GetKey(SimilarityCache::GetVideoKey(videoFilePath), "euclidean", { double(workingHeight), double(greyscale), double(backend) });
+}
+
+// Returns the cache key of a motion stage (the motion filter weights)
+uint64_t SimilarityMeasure::GetMotionKey(uint64_t euclideanKey, SimilarityConfig& config) {
+    vector<float> weights = config.GetWeights();
+
+    return SimilarityCache::GetKey(euclideanKey, "motion", vector<double>(weights.begin(), weights.end()));
+}
+
+// Returns the cache key of a future cost stage (exponent, discount and solver settings - methods and tolerances converge to slightly
+// different values)
+uint64_t SimilarityMeasure::GetFutureCostKey(uint64_t motionKey, SimilarityConfig& config, FutureCostMethod method) {
+    return SimilarityCache::GetKey(motionKey, "future", { config.GetP(), double(config.GetAlpha()), double(method), double(config.GetTolerance()), double(config.GetMaxIterations()) });
+}
+
+// Hands the output of a stage to the artifact exporter (written in the background, immediately or on demand - see SetExportOptions)
+void SimilarityMeasure::SaveMatrices(SimilarityMatrix& output, string videoFilePath, string matrixType) {
+    ArtifactExporter::GetSharedExporter().Export(output, videoFilePath, matrixType, exportOptions);
 }
\ No newline at end of file
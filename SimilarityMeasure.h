@@ -1,22 +1,73 @@
 #pragma once
 #include "SimilarityMatrix.h"
+#include "ArtifactExporter.h"
+#include "DistanceKernel.h"
+#include "FrameMask.h"
+#include "FutureCostSolver.h"
+#include "SimilarityCache.h"
+#include "SimilarityConfig.h"
+#include "SparseSimilarityMatrix.h"
+#include "TiledMatrixStore.h"
 #include <opencv2/opencv.hpp>
+#include <functional>
 
 using namespace std;
 
 // SimilarityMeasure
 // - Measures similarity between video frames
+// - Dense stages are looked up in the shared SimilarityCache first (keyed on the video and the parameters of every stage), and store
+//   their output in it when computed
+// - When frames are appended to a video (or trimmed from its end), the Update stages reuse the previous matrices: only pairs involving a
+//   changed frame are compared, only the motion rows/columns whose window reaches a changed frame are filtered, and the future cost
+//   solver is warm-started from the previous solution
+// - The prefiltered stage keeps exact distances only for each frame's K closest earlier frames (found without comparing most pairs in
+//   full) and their diagonal neighbourhoods - rejected pairs are +inf, so they never become transitions
+// - The masked stage compares only the pixels a FrameMask keeps (weighted), so a shot's static background or a caption does not dilute
+//   the distances - the cost falls with the active area
 
 class SimilarityMeasure {
 	public:
+		// Getters & Setters
+		static ExportOptions GetExportOptions();
+		static void SetExportOptions(ExportOptions options);
+
 		// Static Methods
-		static SimilarityMatrix ComputeEuclideanSimilarityMatrix(string videoFilePath);
-		static SimilarityMatrix ComputeMotionSimilarityMatrix(string videoFilePath, SimilarityMatrix euclideanSimilarityMatrix);
-		static SimilarityMatrix ComputeFutureCostSimilarityMatrix(string videoFilePath, SimilarityMatrix motionSimilarityMatrix);
+		static SimilarityMatrix ComputeEuclideanSimilarityMatrix(string videoFilePath, int workingHeight = 0, bool greyscale = false, DistanceBackend backend = DistanceBackend::Exact);
+		static SimilarityMatrix ComputeMaskedSimilarityMatrix(string videoFilePath, const FrameMask& mask, int workingHeight = 0, bool greyscale = false, DistanceBackend backend = DistanceBackend::Exact);
+		static SimilarityMatrix ComputeDescriptorSimilarityMatrix(string videoFilePath, int thumbnailHeight, int dimensions = 0);
+		static SimilarityMatrix ComputeCoarseToFineSimilarityMatrix(string videoFilePath, int coarseHeight, int candidatesPerRow, SimilarityConfig config = SimilarityConfig());
+		static SimilarityMatrix ComputePrefilteredSimilarityMatrix(string videoFilePath, int candidatesPerRow, SimilarityConfig config = SimilarityConfig(), PrefilterStatistics* statistics = NULL);
+		static SimilarityMatrix ComputeMotionSimilarityMatrix(string videoFilePath, const SimilarityMatrix& euclideanSimilarityMatrix, SimilarityConfig config = SimilarityConfig());
+		static SimilarityMatrix ComputeFusedMotionSimilarityMatrix(string videoFilePath, SimilarityConfig config = SimilarityConfig(), SimilarityMatrix* euclideanSimilarityMatrix = NULL);
+		static SimilarityMatrix ComputeFutureCostSimilarityMatrix(string videoFilePath, const SimilarityMatrix& motionSimilarityMatrix, SimilarityConfig config = SimilarityConfig(), FutureCostMethod method = FutureCostMethod::Jacobi, vector<FutureCostIteration>* telemetry = NULL);
+		static SimilarityMatrix UpdateEuclideanSimilarityMatrix(string videoFilePath, const SimilarityMatrix& previousEuclideanSimilarityMatrix, const vector<uint64_t>& previousFrameHashes, int* unchangedFrameCount = NULL, int workingHeight = 0, bool greyscale = false);
+		static SimilarityMatrix UpdateMotionSimilarityMatrix(string videoFilePath, const SimilarityMatrix& previousMotionSimilarityMatrix, const vector<uint64_t>& previousFrameHashes, SimilarityConfig config = SimilarityConfig(), int* unchangedFrameCount = NULL);
+		static SimilarityMatrix UpdateFutureCostSimilarityMatrix(string videoFilePath, const SimilarityMatrix& motionSimilarityMatrix, const SimilarityMatrix& previousFutureCostSimilarityMatrix, SimilarityConfig config = SimilarityConfig(), FutureCostMethod method = FutureCostMethod::Jacobi, vector<FutureCostIteration>* telemetry = NULL);
+		static SparseSimilarityMatrix ComputeSparseEuclideanSimilarityMatrix(string videoFilePath, int candidatesPerRow, int coarseHeight = 0, SimilarityConfig config = SimilarityConfig(), PrefilterStatistics* statistics = NULL);
+		static SparseSimilarityMatrix ComputeSparseMotionSimilarityMatrix(SparseSimilarityMatrix euclideanSimilarityMatrix, SimilarityConfig config = SimilarityConfig());
+		static SparseSimilarityMatrix ComputeSparseFutureCostSimilarityMatrix(SparseSimilarityMatrix motionSimilarityMatrix, SimilarityConfig config = SimilarityConfig(), vector<FutureCostIteration>* telemetry = NULL);
+		static SimilarityMatrix ComputeOutOfCoreEuclideanSimilarityMatrix(string videoFilePath, int workingHeight = 0, size_t memoryBudget = TiledMatrixStore::DEFAULT_MEMORY_BUDGET, function<void(int, int)> progress = NULL);
+		static SimilarityMatrix ComputeOutOfCoreMotionSimilarityMatrix(string videoFilePath, const SimilarityMatrix& euclideanSimilarityMatrix, SimilarityConfig config = SimilarityConfig(), function<void(int, int)> progress = NULL);
+		static SimilarityMatrix ComputeOutOfCoreFutureCostSimilarityMatrix(string videoFilePath, const SimilarityMatrix& motionSimilarityMatrix, SimilarityConfig config = SimilarityConfig(), function<void(int, int)> progress = NULL, vector<FutureCostIteration>* telemetry = NULL);
+		static bool VerifyEuclideanBackend(string videoFilePath, DistanceBackend backend, double tolerance, int workingHeight = 0, bool greyscale = false);
+		static double GetDescriptorRankCorrelation(string videoFilePath, int thumbnailHeight, int dimensions = 0);
+		static double VerifyCoarseToFine(string videoFilePath, int coarseHeight, int candidatesPerRow, SimilarityConfig config = SimilarityConfig());
+		static bool VerifyFutureCostMethod(const SimilarityMatrix& motionSimilarityMatrix, FutureCostMethod method, SimilarityConfig config, double tolerance, long long* rowUpdatesSaved = NULL);
+		static void RunParameterSweep(string videoFilePath, vector<SimilarityConfig> configs, function<void(int, const SimilarityMatrix&, const SimilarityMatrix&)> visit);
+		static string ComputeNewFilePath(string originalFilePath, string matrixRepresentation, string matrixType, string extension);
 		
 	private:
 		// Static Methods
-		static string ComputeNewFilePath(string originalFilePath, string matrixRepresentation, string matrixType, string extension);
-		static cv::Mat RemoveInvalidFrames(cv:: Mat input);
+		static SimilarityMatrix StoreMatrix(cv::Mat distanceMatrix, SimilarityConfig& config, uint64_t cacheKey = 0);
+		static SimilarityMatrix FindCachedMatrix(uint64_t cacheKey, SimilarityConfig& config);
+		static SimilarityMatrix ApplyStorage(SimilarityMatrix matrix, SimilarityConfig& config);
+		static uint64_t GetEuclideanKey(string videoFilePath, int workingHeight, bool greyscale, DistanceBackend backend);
+		static uint64_t GetMotionKey(uint64_t euclideanKey, SimilarityConfig& config);
+		static uint64_t GetFutureCostKey(uint64_t motionKey, SimilarityConfig& config, FutureCostMethod method);
+		static void SaveMatrices(SimilarityMatrix& output, string videoFilePath, string matrixType);
+
+		// Static Parameters
+		static ExportOptions exportOptions;
+		static const int MAX_FUSED_BAND_ROWS = 256;
 };
 
@@ -0,0 +1,187 @@
+#include "SparseSimilarityMatrix.h"
+
+using namespace cv;
+using namespace std;
+
+//--------------------------------------------------------------------------------------
+// Constructors
+//--------------------------------------------------------------------------------------
+
+// Default constructor - creates an empty matrix
+SparseSimilarityMatrix::SparseSimilarityMatrix() {
+	frameCount = 0;
+	rowOffsets.push_back(0);
+}
+
+// Creates matrix from the entries of each row (columns need not be sorted)
+SparseSimilarityMatrix::SparseSimilarityMatrix(int frameCount, vector<vector<pair<int, float>>> rows) {
+	this->frameCount = frameCount;
+	rowOffsets.push_back(0);
+
+	for (int i = 0; i < frameCount; i++) {
+		if (i < int(rows.size())) {
+			sort(rows[i].begin(), rows[i].end());
+			for (pair<int, float>& entry : rows[i]) {
+				columns.push_back(entry.first);
+				values.push_back(entry.second);
+			}
+		}
+		rowOffsets.push_back(columns.size());
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// Getters & Setters
+//--------------------------------------------------------------------------------------
+
+int SparseSimilarityMatrix::GetFrameCount() {
+	return frameCount;
+}
+
+size_t SparseSimilarityMatrix::GetEntryCount() {
+	return values.size();
+}
+
+// Values of every stored entry (row by row, in column order)
+vector<float> SparseSimilarityMatrix::GetValues() {
+	return values;
+}
+
+// Replaces the values of every stored entry (the sparsity pattern is unchanged)
+void SparseSimilarityMatrix::SetValues(vector<float> v) {
+	if (v.size() == values.size())
+		values = v;
+}
+
+//--------------------------------------------------------------------------------------
+// Instance Methods (Public)
+//--------------------------------------------------------------------------------------
+
+// Returns entry (i, j), or FLT_MAX if it is not stored
+float SparseSimilarityMatrix::GetValue(int i, int j) {
+	if ((i < 0) || (i >= frameCount))
+		return FLT_MAX;
+
+	const int* start = columns.data() + rowOffsets[i];
+	const int* end = columns.data() + rowOffsets[i + 1];
+	const int* found = lower_bound(start, end, j);
+
+	if ((found == end) || (*found != j))
+		return FLT_MAX;
+
+	return values[found - columns.data()];
+}
+
+// Checks if entry (i, j) is stored
+bool SparseSimilarityMatrix::Contains(int i, int j) {
+	if ((i < 0) || (i >= frameCount))
+		return false;
+
+	return binary_search(columns.begin() + rowOffsets[i], columns.begin() + rowOffsets[i + 1], j);
+}
+
+// Returns number of entries stored in row i
+int SparseSimilarityMatrix::GetRowLength(int i) {
+	return int(rowOffsets[i + 1] - rowOffsets[i]);
+}
+
+// Returns (ascending) columns of the entries stored in row i
+const int* SparseSimilarityMatrix::GetRowColumns(int i) {
+	return columns.data() + rowOffsets[i];
+}
+
+// Returns values of the entries stored in row i
+const float* SparseSimilarityMatrix::GetRowValues(int i) {
+	return values.data() + rowOffsets[i];
+}
+
+// Returns lowest value stored in row i (excluding the diagonal), or FLT_MAX if the row is empty
+float SparseSimilarityMatrix::GetRowLowestValue(int i) {
+	float lowest = FLT_MAX;
+
+	for (size_t k = rowOffsets[i]; k < rowOffsets[i + 1]; k++) {
+		if ((columns[k] != i) && (values[k] < lowest))
+			lowest = values[k];
+	}
+
+	return lowest;
+}
+
+// Returns number of bytes held by the matrix
+size_t SparseSimilarityMatrix::GetMemoryUsage() {
+	return (rowOffsets.size() * sizeof(size_t)) + (columns.size() * sizeof(int)) + (values.size() * sizeof(float));
+}
+
+// Expands into a dense matrix (entries that are not stored are FLT_MAX)
+Mat SparseSimilarityMatrix::ToDenseMatrix() {
+	Mat dense(frameCount, frameCount, CV_32F, Scalar(FLT_MAX));
+
+	for (int i = 0; i < frameCount; i++) {
+		float* row = dense.ptr<float>(i);
+		for (size_t k = rowOffsets[i]; k < rowOffsets[i + 1]; k++)
+			row[columns[k]] = values[k];
+	}
+
+	return dense;
+}
+
+//--------------------------------------------------------------------------------------
+// Static Methods (Public)
+//--------------------------------------------------------------------------------------
+
+// Keeps the K lowest backwards-pointing entries of each row of a dense matrix, plus their diagonal neighbourhoods
+SparseSimilarityMatrix SparseSimilarityMatrix::FromDenseMatrix(Mat distanceMatrix, int candidatesPerRow, int bandHalfWidth) {
+	// Parameters:
+	// - distanceMatrix: dense distance matrix
+	// - candidatesPerRow: number of lowest entries kept per row (only j < i, since transitions jump backwards)
+	// - bandHalfWidth: half-width of the motion filter window (entries (i + k, j + k) for k in [-m, m) are also kept)
+
+	int frameCount = distanceMatrix.rows;
+	vector<vector<int>> candidates(frameCount);
+
+	for (int i = 1; i < frameCount; i++) {
+		const float* row = distanceMatrix.ptr<float>(i);
+		vector<int> columns(i);
+		for (int j = 0; j < i; j++)
+			columns[j] = j;
+
+		int count = min(candidatesPerRow, i);
+		partial_sort(columns.begin(), columns.begin() + count, columns.end(), [&](int a, int b) {
+			return row[a] < row[b];
+		});
+
+		candidates[i] = vector<int>(columns.begin(), columns.begin() + count);
+	}
+
+	vector<vector<int>> pattern = AddDiagonalBand(candidates, bandHalfWidth);
+	vector<vector<pair<int, float>>> rows(frameCount);
+
+	for (int i = 0; i < frameCount; i++) {
+		for (int j : pattern[i])
+			rows[i].push_back(make_pair(j, distanceMatrix.at<float>(i, j)));
+	}
+
+	return SparseSimilarityMatrix(frameCount, rows);
+}
+
+// Adds the diagonal neighbours (i + k, j + k), k in [-m, m), of every candidate (i, j) - returns sorted, unique columns per row
+vector<vector<int>> SparseSimilarityMatrix::AddDiagonalBand(vector<vector<int>> candidates, int bandHalfWidth) {
+	int frameCount = int(candidates.size());
+	vector<vector<int>> pattern(frameCount);
+
+	for (int i = 0; i < frameCount; i++) {
+		for (int j : candidates[i]) {
+			for (int k = -bandHalfWidth; k < max(bandHalfWidth, 1); k++) {
+				if ((i + k >= 0) && (j + k >= 0) && (i + k < frameCount) && (j + k < frameCount))
+					pattern[i + k].push_back(j + k);
+			}
+		}
+	}
+
+	for (vector<int>& row : pattern) {
+		sort(row.begin(), row.end());
+		row.erase(unique(row.begin(), row.end()), row.end());
+	}
+
+	return pattern;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+using namespace std;
+
+// SparseSimilarityMatrix
+// - Stores only selected entries of a distance matrix (compressed rows), so memory scales with the number of entries rather than n^2
+// - Typically holds the K best backwards-pointing candidates per row (j < i) plus the diagonal neighbourhood the motion filter reads
+// - Entries that are not stored read as FLT_MAX
+
+class SparseSimilarityMatrix {
+	public:
+		// Constructors
+		SparseSimilarityMatrix();
+		SparseSimilarityMatrix(int frameCount, vector<vector<pair<int, float>>> rows);
+
+		// Getters & Setters
+		int GetFrameCount();
+		size_t GetEntryCount();
+		vector<float> GetValues();
+		void SetValues(vector<float> v);
+
+		// Instance Methods
+		float GetValue(int i, int j);
+		bool Contains(int i, int j);
+		int GetRowLength(int i);
+		const int* GetRowColumns(int i);
+		const float* GetRowValues(int i);
+		float GetRowLowestValue(int i);
+		size_t GetMemoryUsage();
+		cv::Mat ToDenseMatrix();
+
+		// Static Methods
+		static SparseSimilarityMatrix FromDenseMatrix(cv::Mat distanceMatrix, int candidatesPerRow, int bandHalfWidth);
+		static vector<vector<int>> AddDiagonalBand(vector<vector<int>> candidates, int bandHalfWidth);
+
+	private:
+		// Parameters
+		int frameCount;
+		vector<size_t> rowOffsets;
+		vector<int> columns;
+		vector<float> values;
+};
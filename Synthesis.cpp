@@ -1,4 +1,5 @@
 #include "Synthesis.h"
+#include "FrameStore.h"
 
 using namespace cv;
 using namespace std;
@@ -8,12 +9,72 @@ using namespace std;
 //--------------------------------------------------------------------------------------
 
 // Computes an ordered set of transitions for a video texture
-CompoundLoop Synthesis::GetTransitionSet(Mat motionDistanceMatrix, Mat futureCostDistanceMatrix, int lengthMultiplier) {
-	vector<Transition> prunedTransitionSet = PruneTransitions(motionDistanceMatrix, futureCostDistanceMatrix);
-	CompoundLoop unscheduledTransitionSet = GetSetOfTransitions(prunedTransitionSet, lengthMultiplier);
-	CompoundLoop scheduledTransitionSet = ScheduleTransitions(unscheduledTransitionSet);
+CompoundLoop Synthesis::GetTransitionSet(const Mat& motionDistanceMatrix, const Mat& futureCostDistanceMatrix, int lengthMultiplier, SimilarityConfig config) {
+	return ComputeTransitionSet(motionDistanceMatrix, futureCostDistanceMatrix, lengthMultiplier, config.GetTransitionCount());
+}
 
-	return scheduledTransitionSet;
+// Computes an ordered set of transitions for a video texture from sparse similarity matrices
+CompoundLoop Synthesis::GetTransitionSet(SparseSimilarityMatrix motionSimilarityMatrix, SparseSimilarityMatrix futureCostSimilarityMatrix, int lengthMultiplier, SimilarityConfig config) {
+	return ComputeTransitionSet(motionSimilarityMatrix, futureCostSimilarityMatrix, lengthMultiplier, config.GetTransitionCount());
+}
+
+// Computes an ordered set of transitions for a video texture from similarity matrices in any storage (in memory, compact or out-of-core)
+CompoundLoop Synthesis::GetTransitionSet(const SimilarityMatrix& motionSimilarityMatrix, const SimilarityMatrix& futureCostSimilarityMatrix, int lengthMultiplier, SimilarityConfig config) {
+	int transitionCount = config.GetTransitionCount();
+
+	if (motionSimilarityMatrix.IsOutOfCore() && futureCostSimilarityMatrix.IsOutOfCore())
+		return ComputeTransitionSet(*motionSimilarityMatrix.GetTiledStore(), *futureCostSimilarityMatrix.GetTiledStore(), lengthMultiplier, transitionCount);
+
+	// Only one matrix out-of-core - each is read in its own storage (the out-of-core one band by band from disk)
+	if (motionSimilarityMatrix.IsOutOfCore() || futureCostSimilarityMatrix.IsOutOfCore())
+		return ComputeTransitionSet(motionSimilarityMatrix, futureCostSimilarityMatrix, lengthMultiplier, transitionCount);
+
+	if (!motionSimilarityMatrix.IsCompact() && !futureCostSimilarityMatrix.IsCompact())
+		return ComputeTransitionSet(motionSimilarityMatrix.GetDistanceMatrix(), futureCostSimilarityMatrix.GetDistanceMatrix(), lengthMultiplier, transitionCount);
+
+	// Mixed storage - in-memory matrices are wrapped as full precision compact matrices (no copy)
+	shared_ptr<const CompactMatrix> motion = motionSimilarityMatrix.GetCompactMatrix();
+	shared_ptr<const CompactMatrix> futureCost = futureCostSimilarityMatrix.GetCompactMatrix();
+
+	if (!motion)
+		motion = make_shared<const CompactMatrix>(motionSimilarityMatrix.GetDistanceMatrix(), MatrixStorage::Float32);
+	if (!futureCost)
+		futureCost = make_shared<const CompactMatrix>(futureCostSimilarityMatrix.GetDistanceMatrix(), MatrixStorage::Float32);
+
+	return ComputeTransitionSet(*motion, *futureCost, lengthMultiplier, transitionCount);
+}
+
+// Checks that storing the matrices compactly leaves the pruned transition set unchanged (and optionally reports the storage error)
+bool Synthesis::VerifyStorage(const Mat& motionDistanceMatrix, const Mat& futureCostDistanceMatrix, MatrixStorage storage, SimilarityConfig config, CompactMatrixError* error) {
+	// Parameters:
+	// - motionDistanceMatrix, futureCostDistanceMatrix: full precision distance matrices
+	// - storage: storage being checked
+	// - config: number of transitions kept when pruning
+	// - error: receives the larger error of the two compact matrices relative to full precision (optional)
+
+	CompactMatrix motion(motionDistanceMatrix, storage);
+	CompactMatrix futureCost(futureCostDistanceMatrix, storage);
+
+	if (error) {
+		CompactMatrixError motionError = motion.GetError(motionDistanceMatrix);
+		CompactMatrixError futureCostError = futureCost.GetError(futureCostDistanceMatrix);
+
+		error->maxAbsolute = max(motionError.maxAbsolute, futureCostError.maxAbsolute);
+		error->maxRelative = max(motionError.maxRelative, futureCostError.maxRelative);
+	}
+
+	vector<Transition> reference = PruneTransitions(motionDistanceMatrix, futureCostDistanceMatrix, config.GetTransitionCount());
+	vector<Transition> candidate = PruneTransitions(motion, futureCost, config.GetTransitionCount());
+
+	if (reference.size() != candidate.size())
+		return false;
+
+	for (int k = 0; k < int(reference.size()); k++) {
+		if ((reference[k].GetSourceFrame() != candidate[k].GetSourceFrame()) || (reference[k].GetDestinationFrame() != candidate[k].GetDestinationFrame()))
+			return false;
+	}
+
+	return true;
 }
 
 // Saves list of frames to video
@@ -22,20 +83,17 @@ string Synthesis::CreateVideoTexture(string inputVideoFilePath, CompoundLoop com
 	// Get sequence of frames
 	vector<int> sequenceOfFrames = GetFrameSequence(compoundLoopOfTransitions);
 
-	// Write sequence of frames to video
-	VideoCapture inputVideo(inputVideoFilePath);
+	// Write sequence of frames to video (frames are served from the decoded store rather than seeking)
+	shared_ptr<FrameStore> frames = FrameStore::GetSharedStore(inputVideoFilePath);
 
 	string outputVideoFilePath = ComputeOutputFilePath(inputVideoFilePath);
-	VideoWriter outputVideo(outputVideoFilePath, inputVideo.get(CAP_PROP_FOURCC), inputVideo.get(CAP_PROP_FPS), Size2i(inputVideo.get(CAP_PROP_FRAME_WIDTH), inputVideo.get(CAP_PROP_FRAME_HEIGHT)));
+	VideoWriter outputVideo(outputVideoFilePath, frames->GetFourCC(), frames->GetFPS(), frames->GetFrameSize());
 
-	if (inputVideo.isOpened() && outputVideo.isOpened()) {
+	if (frames->IsLoaded() && outputVideo.isOpened()) {
 
 		for (int i = 0; i < sequenceOfFrames.size(); i++) {
-			Mat frame;
-
-			inputVideo.set(1, sequenceOfFrames[i]);
-			bool success = inputVideo.read(frame);
-			if (!success) break;
+			Mat frame = frames->GetFrame(sequenceOfFrames[i]);
+			if (frame.empty()) break;
 
 			outputVideo << frame;
 		}
@@ -50,51 +108,193 @@ string Synthesis::CreateVideoTexture(string inputVideoFilePath, CompoundLoop com
 // Static Methods (Private)
 //--------------------------------------------------------------------------------------
 
+// Computes an ordered set of transitions from matrices in any storage that has a PruneTransitions overload
+template<class Matrix> CompoundLoop Synthesis::ComputeTransitionSet(Matrix& motionDistanceMatrix, Matrix& futureCostDistanceMatrix, int lengthMultiplier, int transitionCount) {
+	vector<Transition> prunedTransitionSet = PruneTransitions(motionDistanceMatrix, futureCostDistanceMatrix, transitionCount);
+	CompoundLoop unscheduledTransitionSet = GetSetOfTransitions(prunedTransitionSet, lengthMultiplier);
+	CompoundLoop scheduledTransitionSet = ScheduleTransitions(unscheduledTransitionSet);
+
+	return scheduledTransitionSet;
+}
+
 // Prunes matrix of transitions for synthesis
-vector<Transition> Synthesis::PruneTransitions(Mat motionDistanceMatrix, Mat futureCostDistanceMatrix) {
+vector<Transition> Synthesis::PruneTransitions(const Mat& motionDistanceMatrix, const Mat& futureCostDistanceMatrix, int transitionCount) {
 	// Essentially find primitive loops that will be used to form compound loops
 	// In order to create a cycle for transition i->j: range = [j, i] (i.e. i >= j) and cost = D''_ij (motion distance matrix)
 
-	vector<Transition> localMinimaTransitions, transitions;
-	double cost = 0;
-	Point frame(0, 0);
+	vector<Transition> localMinimaTransitions;
 
 	// 1. Select local minima (i.e. lowest cost transition) for each source frame
+	// Range [j, i] excluding the diagonal means only the columns before i are searched (the matrices are not modified)
 	for (int i = 1; i < futureCostDistanceMatrix.rows; i++) {
-		futureCostDistanceMatrix.at<float>(i, i) = FLT_MAX;
-		bool validRange = false;
+		const float* values = futureCostDistanceMatrix.ptr<float>(i);
+		int destination = int(min_element(values, values + i) - values);
 
-		while (!validRange) { // Ensures range [j, i]
-			minMaxLoc(futureCostDistanceMatrix.row(i), &cost, NULL, &frame, NULL);
-			if (frame.x <= i)
-				validRange = true;
-			else
-				futureCostDistanceMatrix.at<float>(i, frame.x) = FLT_MAX;
+		localMinimaTransitions.push_back(Transition(i, destination, values[destination]));
+	}
+
+	// Motion cost of each local minimum (used to rank transitions)
+	vector<float> motionCosts;
+	for (Transition& t : localMinimaTransitions)
+		motionCosts.push_back(motionDistanceMatrix.at<float>(t.GetSourceFrame(), t.GetDestinationFrame()));
+
+	return SelectBestTransitions(localMinimaTransitions, motionCosts, transitionCount);
+}
+
+// Prunes sparse matrix of transitions for synthesis (only stored entries are considered)
+vector<Transition> Synthesis::PruneTransitions(SparseSimilarityMatrix motionSimilarityMatrix, SparseSimilarityMatrix futureCostSimilarityMatrix, int transitionCount) {
+	vector<Transition> localMinimaTransitions;
+	vector<float> motionCosts;
+
+	// 1. Select local minima (i.e. lowest cost transition) for each source frame - range [j, i] requires j < i
+	for (int i = 1; i < futureCostSimilarityMatrix.GetFrameCount(); i++) {
+		const int* columns = futureCostSimilarityMatrix.GetRowColumns(i);
+		const float* values = futureCostSimilarityMatrix.GetRowValues(i);
+		int destination = -1;
+		float cost = FLT_MAX;
+
+		for (int c = 0; c < futureCostSimilarityMatrix.GetRowLength(i) && columns[c] < i; c++) {
+			if (values[c] < cost) {
+				cost = values[c];
+				destination = columns[c];
+			}
 		}
 
-		localMinimaTransitions.push_back(Transition(i, frame.x, cost));
+		if (destination >= 0) {
+			localMinimaTransitions.push_back(Transition(i, destination, cost));
+			motionCosts.push_back(motionSimilarityMatrix.GetValue(i, destination));
+		}
 	}
 
-	// 2. Remove transitions with length <= 2 & compute average cost for each transition
-	for (Transition& t : localMinimaTransitions) {
-		if (t.GetTransitionLength() > 2) {
-			float cost = motionDistanceMatrix.at<float>(t.GetSourceFrame(), t.GetDestinationFrame());
-			t.SetTransitionCost(cost);
+	return SelectBestTransitions(localMinimaTransitions, motionCosts, transitionCount);
+}
+
+// Prunes on-disk (tiled) matrix of transitions for synthesis, reading one band of tile rows at a time
+vector<Transition> Synthesis::PruneTransitions(TiledMatrixStore& motionDistanceMatrix, TiledMatrixStore& futureCostDistanceMatrix, int transitionCount) {
+	vector<Transition> localMinimaTransitions;
+	vector<float> motionCosts;
+	int frameCount = futureCostDistanceMatrix.GetRows();
+	int tileSize = futureCostDistanceMatrix.GetTileSize();
+
+	// 1. Select local minima (i.e. lowest cost transition) for each source frame - range [j, i] requires j < i
+	for (int rowStart = 0; rowStart < frameCount; rowStart += tileSize) {
+		int rowEnd = min(rowStart + tileSize, frameCount);
+		Mat band = futureCostDistanceMatrix.ReadRegion(rowStart, rowEnd, 0, rowEnd);
+
+		for (int i = max(rowStart, 1); i < rowEnd; i++) {
+			const float* values = band.ptr<float>(i - rowStart);
+			int destination = int(min_element(values, values + i) - values);
+
+			localMinimaTransitions.push_back(Transition(i, destination, values[destination]));
+			motionCosts.push_back(motionDistanceMatrix.GetValue(i, destination));
+		}
+	}
+
+	return SelectBestTransitions(localMinimaTransitions, motionCosts, transitionCount);
+}
+
+// Prunes compact matrix of transitions for synthesis, dequantising only the part of each row that is searched
+vector<Transition> Synthesis::PruneTransitions(const CompactMatrix& motionDistanceMatrix, const CompactMatrix& futureCostDistanceMatrix, int transitionCount) {
+	vector<Transition> localMinimaTransitions;
+	vector<float> motionCosts;
+	vector<float> values(futureCostDistanceMatrix.GetCols());
+
+	// 1. Select local minima (i.e. lowest cost transition) for each source frame - range [j, i] requires j < i
+	for (int i = 1; i < futureCostDistanceMatrix.GetRows(); i++) {
+		futureCostDistanceMatrix.DecodeRow(i, 0, i, values.data());
+		int destination = int(min_element(values.begin(), values.begin() + i) - values.begin());
+
+		localMinimaTransitions.push_back(Transition(i, destination, values[destination]));
+		motionCosts.push_back(motionDistanceMatrix.GetValue(i, destination));
+	}
+
+	return SelectBestTransitions(localMinimaTransitions, motionCosts, transitionCount);
+}
+
+// Prunes matrices of transitions held in different storage (in memory, compact or out-of-core), reading the future cost matrix one band
+// of rows at a time
+vector<Transition> Synthesis::PruneTransitions(const SimilarityMatrix& motionSimilarityMatrix, const SimilarityMatrix& futureCostSimilarityMatrix, int transitionCount) {
+	vector<Transition> localMinimaTransitions;
+	vector<float> motionCosts;
+	int frameCount = futureCostSimilarityMatrix.GetFrameCount();
+
+	shared_ptr<TiledMatrixStore> motionStore = motionSimilarityMatrix.GetTiledStore();
+	shared_ptr<const CompactMatrix> motionCompact = motionSimilarityMatrix.GetCompactMatrix();
+	shared_ptr<TiledMatrixStore> futureCostStore = futureCostSimilarityMatrix.GetTiledStore();
+	shared_ptr<const CompactMatrix> futureCostCompact = futureCostSimilarityMatrix.GetCompactMatrix();
+
+	if (motionSimilarityMatrix.GetFrameCount() != frameCount)
+		return localMinimaTransitions;
+
+	int bandRows = futureCostStore ? futureCostStore->GetTileSize() : TiledMatrixStore::DEFAULT_TILE_SIZE;
+
+	// 1. Select local minima (i.e. lowest cost transition) for each source frame - range [j, i] requires j < i
+	for (int rowStart = 0; rowStart < frameCount; rowStart += bandRows) {
+		int rowEnd = min(rowStart + bandRows, frameCount);
+		Mat band;
+
+		if (futureCostStore)
+			band = futureCostStore->ReadRegion(rowStart, rowEnd, 0, rowEnd);
+		else if (futureCostCompact)
+			band = futureCostCompact->DecodeRows(rowStart, rowEnd);
+		else
+			band = futureCostSimilarityMatrix.GetDistanceMatrix().rowRange(rowStart, rowEnd);
+
+		for (int i = max(rowStart, 1); i < rowEnd; i++) {
+			const float* values = band.ptr<float>(i - rowStart);
+			int destination = int(min_element(values, values + i) - values);
+			float motionCost;
+
+			if (motionStore)
+				motionCost = motionStore->GetValue(i, destination);
+			else if (motionCompact)
+				motionCost = motionCompact->GetValue(i, destination);
+			else
+				motionCost = motionSimilarityMatrix.GetDistanceMatrix().at<float>(i, destination);
+
+			localMinimaTransitions.push_back(Transition(i, destination, values[destination]));
+			motionCosts.push_back(motionCost);
+		}
+	}
+
+	return SelectBestTransitions(localMinimaTransitions, motionCosts, transitionCount);
+}
+
+// Keeps the best transitions of the local minima
+vector<Transition> Synthesis::SelectBestTransitions(vector<Transition> localMinimaTransitions, vector<float> motionCosts, int transitionCount) {
+	vector<Transition> transitions;
+
+	// Nothing can be kept (see SimilarityConfig::SetTransitionCount)
+	if (transitionCount < 1)
+		return transitions;
+
+	// 2. Remove transitions with length <= 2 (or between rejected pairs, whose cost is +inf) & compute average cost for each transition
+	for (int k = 0; k < int(localMinimaTransitions.size()); k++) {
+		Transition& t = localMinimaTransitions[k];
+		if ((t.GetTransitionLength() > 2) && (motionCosts[k] < FLT_MAX)) {
+			t.SetTransitionCost(motionCosts[k]);
 			transitions.push_back(t);
 		}
 	}
 
-	// Ensure we have enough transitions to create texture
-	if (transitions.size() < 2)
-		transitions = localMinimaTransitions;
+	// Ensure we have enough transitions to create texture - short transitions are allowed back in, rejected pairs never are (the texture
+	// may then have fewer transitions)
+	if (transitions.size() < 2) {
+		transitions.clear();
 
-	// 3. We only want to use the best transitions (20)
+		for (int k = 0; k < int(localMinimaTransitions.size()); k++) {
+			if ((localMinimaTransitions[k].GetTransitionCost() < FLT_MAX) && (motionCosts[k] < FLT_MAX))
+				transitions.push_back(localMinimaTransitions[k]);
+		}
+	}
+
+	// 3. We only want to use the best transitions (20 by default)
 	sort(transitions.begin(), transitions.end(), [](Transition& a, Transition& b) {
 		return a.GetTransitionCost() < b.GetTransitionCost();
 	});
 
-	if (transitions.size() > 20) {
-		vector<Transition> bestTransitions(transitions.begin(), transitions.begin() + 20);
+	if (int(transitions.size()) > transitionCount) {
+		vector<Transition> bestTransitions(transitions.begin(), transitions.begin() + transitionCount);
 		return bestTransitions;
 	}
 
@@ -104,97 +304,152 @@ vector<Transition> Synthesis::PruneTransitions(Mat motionDistanceMatrix, Mat fut
 // Finds the lowest cost compound loop of a given length
 CompoundLoop Synthesis::GetSetOfTransitions(vector<Transition> transitions, int lengthMultiplier) {
 
-	int maxLoopLength = lengthMultiplier * Transition::GetLongestLength(transitions);
-	vector<vector<CompoundLoop>> compoundLoops;
+	int transitionCount = transitions.size();
+	if (transitionCount == 0)
+		return CompoundLoop();
+
+	int longestLength = Transition::GetLongestLength(transitions);
+	int maxLoopLength = lengthMultiplier * longestLength;
 
 	// Dynamic programming algorithm to find compound loops
 
 	// For each cell:
 	// - Look at shorter compound loops that sum to this length
-	// - Ensure these compound loops have overlapping ranges
+	// - Ensure these compound loops have overlapping ranges (and do not already contain the cell's primitive loop)
 	// - Select compound loop with lowest cost
-	// - Combine with cell's compound loop for this entry
+	// - Combine with cell's primitive loop for this entry
+
+	// OUTPUT - Back-pointer for every cell -> the transitions of a compound loop are recovered by following them
+
+	// Cells only ever look back by the length of a primitive loop, so full cells are kept in a window of that many lengths (rows are
+	// reused modulo the window), and only the back-pointers are kept for every length
+	int windowLength = longestLength + 1;
+	int maskWords = (transitionCount + 63) / 64;
+
+	vector<int> lengths(transitionCount);
+	vector<int> costs(transitionCount);
 
-	// OUTPUT - List of compound loops -> each compound loop is a list of transitions
+	for (int t = 0; t < transitionCount; t++) {
+		lengths[t] = transitions[t].GetTransitionLength();
+		costs[t] = int(transitions[t].GetTransitionCost());
+	}
+
+	vector<int> previous(size_t(maxLoopLength) * transitionCount, EMPTY_CELL);
+	vector<LoopCell> cells(size_t(windowLength) * transitionCount);
+	vector<uint64_t> masks(size_t(windowLength) * transitionCount * maskWords);
+	vector<vector<int>> costOrder(windowLength);
+
+	// Cells of the longest length that contains transitions
+	int finalLength = 0;
+	vector<LoopCell> finalCells;
+	vector<int> finalCostOrder;
 
 	for (int length = 1; length <= maxLoopLength; length++) {
-		vector<CompoundLoop> compoundLoopsOfLengthN;
-		for (Transition& primitiveLoop : transitions) {
-			CompoundLoop current;
+		int row = length % windowLength;
+		LoopCell* rowCells = &cells[size_t(row) * transitionCount];
+		uint64_t* rowMasks = &masks[size_t(row) * transitionCount * maskWords];
+		int* rowPrevious = &previous[size_t(length - 1) * transitionCount];
+
+		for (int t = 0; t < transitionCount; t++) {
+			LoopCell& current = rowCells[t];
+			uint64_t* currentMask = rowMasks + size_t(t) * maskWords;
+			uint64_t transitionBit = 1ULL << (t % 64);
+
+			Transition& primitiveLoop = transitions[t];
+			current.transitionCount = 0;
+
 			// Look at length of primitive loop - determine difference from current length
-			int lengthDifference = length - primitiveLoop.GetTransitionLength();
-
-			// Do nothing if current length is less than length of primitive loop
-
-			if (lengthDifference == 0) // Current length = loop length, so the compound loop is simply the primitive loop
-				current.AddTransition(primitiveLoop);
-
-			if (lengthDifference > 0) {
-				current.AddTransition(primitiveLoop);
-				// Need to combine primitive loop with compound loop to get current length
-				vector<CompoundLoop> possibleCompoundLoops = compoundLoops[lengthDifference - 1];
-
-				// Sort set of compound loops by cost
-				sort(possibleCompoundLoops.begin(), possibleCompoundLoops.end(), [](CompoundLoop& a, CompoundLoop& b) {
-					return a.GetCost() < b.GetCost();
-				});
-
-				// Add lowest-cost compound loop with overlapping range to the primitive loop (ensure no duplicate transitions in new compound loop)
-				for (CompoundLoop& c : possibleCompoundLoops) {
-					if (!(current.ContainsTransitions(c)) && (c.GetNumberOfTransitions() > 0) && (CompoundLoop::CheckIfOverlappingRanges(current, c))) {
-						current = CompoundLoop::MergeCompoundLoops(current, c);
-						break;
-					}
-				}
-
-				// If only one transition in the compound loop, then no smaller one has been found - this column is therefore empty
-				if (current.GetNumberOfTransitions() == 1) {
-					CompoundLoop empty;
-					current = empty;
-				}
+			int lengthDifference = length - lengths[t];
+
+			// Do nothing if current length is less than length of primitive loop (or the loop has no length)
+			if ((lengthDifference < 0) || (lengths[t] < 1))
+				continue;
+
+			if (lengthDifference == 0) { // Current length = loop length, so the compound loop is simply the primitive loop
+				current = { costs[t], primitiveLoop.GetSourceFrame(), primitiveLoop.GetDestinationFrame(), 1 };
+				fill(currentMask, currentMask + maskWords, 0);
+				currentMask[t / 64] = transitionBit;
+				rowPrevious[t] = PRIMITIVE_LOOP;
+				continue;
 			}
-			compoundLoopsOfLengthN.push_back(current);
+
+			// Need to combine primitive loop with compound loop to get current length - add lowest-cost compound loop with overlapping
+			// range (ensure no duplicate transitions in new compound loop)
+			int previousRow = lengthDifference % windowLength;
+			const LoopCell* previousCells = &cells[size_t(previousRow) * transitionCount];
+			const uint64_t* previousMasks = &masks[size_t(previousRow) * transitionCount * maskWords];
+
+			for (int c : costOrder[previousRow]) {
+				const LoopCell& candidate = previousCells[c];
+				const uint64_t* candidateMask = previousMasks + size_t(c) * maskWords;
+
+				if (candidateMask[t / 64] & transitionBit)
+					continue;
+
+				// Same test as CompoundLoop::CheckIfOverlappingRanges
+				long long overlap = (long long)(candidate.rangeEnd - primitiveLoop.GetSourceFrame()) * (primitiveLoop.GetDestinationFrame() - candidate.rangeStart);
+				if (overlap < 0)
+					continue;
+
+				current = { costs[t] + candidate.cost, max(primitiveLoop.GetSourceFrame(), candidate.rangeStart), min(primitiveLoop.GetDestinationFrame(), candidate.rangeEnd), candidate.transitionCount + 1 };
+				copy(candidateMask, candidateMask + maskWords, currentMask);
+				currentMask[t / 64] |= transitionBit;
+				rowPrevious[t] = c;
+				break;
+			}
+
+			// If no smaller compound loop has been found, this cell is empty
 		}
-		compoundLoops.push_back(compoundLoopsOfLengthN);
-	}
 
-	// Get compound loop of largest length which contains transitions
-	vector<CompoundLoop> compoundLoopsOfFinalLength = GetLongestSetOfCompoundLoopsWithTransitions(compoundLoops);
+		// Sort this length's compound loops by cost once, for every longer cell that looks them up
+		vector<int>& rowCostOrder = costOrder[row];
+		rowCostOrder.clear();
 
-	sort(compoundLoopsOfFinalLength.begin(), compoundLoopsOfFinalLength.end(), [](CompoundLoop& a, CompoundLoop& b) {
-		return a.GetCost() < b.GetCost();
-	});
+		for (int t = 0; t < transitionCount; t++) {
+			if (rowCells[t].transitionCount > 0)
+				rowCostOrder.push_back(t);
+		}
 
-	// Return compound loop with lowest cost (> 0)
-	CompoundLoop compoundLoopWithNonZeroCost;
-	for (CompoundLoop& c : compoundLoopsOfFinalLength) {
-		if (c.GetCost() > 0) {
-			compoundLoopWithNonZeroCost = c;
-			break;
+		sort(rowCostOrder.begin(), rowCostOrder.end(), [&](int a, int b) {
+			return (rowCells[a].cost < rowCells[b].cost) || ((rowCells[a].cost == rowCells[b].cost) && (a < b));
+		});
+
+		if (!rowCostOrder.empty()) {
+			finalLength = length;
+			finalCells.assign(rowCells, rowCells + transitionCount);
+			finalCostOrder = rowCostOrder;
 		}
 	}
 
-	return compoundLoopWithNonZeroCost;
-}
+	// Return compound loop of largest length with lowest cost (> 0) - its transitions are recovered by following the back-pointers
+	CompoundLoop compoundLoopWithNonZeroCost;
 
-// Returns set of compound loops of the longest length that contains transitions
-vector<CompoundLoop> Synthesis::GetLongestSetOfCompoundLoopsWithTransitions(vector<vector<CompoundLoop>> compoundLoops) {
-	while (compoundLoops.size() > 0) {
-		vector<CompoundLoop> longestCompoundLoops = compoundLoops.back();
+	for (int t : finalCostOrder) {
+		if (finalCells[t].cost <= 0)
+			continue;
 
-		for (CompoundLoop& c : longestCompoundLoops) {
-			if (c.GetNumberOfTransitions() > 0)
-				return compoundLoops.back();
+		for (int length = finalLength, loop = t; loop != PRIMITIVE_LOOP; ) {
+			compoundLoopWithNonZeroCost.AddTransition(transitions[loop]);
+
+			int next = previous[size_t(length - 1) * transitionCount + loop];
+			length -= lengths[loop];
+			loop = next;
 		}
 
-		compoundLoops.pop_back();
+		break;
 	}
+
+	return compoundLoopWithNonZeroCost;
 }
 
 // Schedules transitions to form valid video structure
 CompoundLoop Synthesis::ScheduleTransitions(CompoundLoop transitionSet) {
 
-	CompoundLoop orderedCompoundLoop;
+	CompoundLoop orderedCompoundLoop = transitionSet.RemoveAllTransitions();
+
+	// Nothing to schedule (e.g. no transitions survived pruning)
+	if (transitionSet.GetNumberOfTransitions() == 0)
+		return orderedCompoundLoop;
 
 	// Transition at end of sequence is first transition to be taken (i.e. find largest value of i) - add to ordered compound loop
 	Transition latestTransition = transitionSet.GetLatestTransition();
@@ -226,8 +481,8 @@ CompoundLoop Synthesis::ScheduleBeforeStartPoint(CompoundLoop rangeSet) {
 		return a.GetSourceFrame() > b.GetSourceFrame();
 	});
 
-	// Create compound loop
-	CompoundLoop sorted;
+	// Create compound loop (shares the range set's transition table, so merging it is cheap)
+	CompoundLoop sorted = rangeSet.RemoveAllTransitions();
 	for (Transition& t : toSchedule) {
 		sorted.AddTransition(t);
 	}
@@ -245,8 +500,8 @@ CompoundLoop Synthesis::ScheduleAfterStartPoint(CompoundLoop rangeSet) {
 		return a.GetSourceFrame() < b.GetSourceFrame();
 		});
 
-	// Create compound loop
-	CompoundLoop sorted;
+	// Create compound loop (shares the range set's transition table, so merging it is cheap)
+	CompoundLoop sorted = rangeSet.RemoveAllTransitions();
 	for (Transition& t : toSchedule) {
 		sorted.AddTransition(t);
 	}
@@ -260,6 +515,9 @@ vector<int> Synthesis::GetFrameSequence(CompoundLoop compoundLoopOfTransitions)
 	vector<Transition> transitions = compoundLoopOfTransitions.GetTransitions();
 	vector<int> sequenceOfFrames;
 
+	if (transitions.empty())
+		return sequenceOfFrames;
+
 	// Start from the destination frame of the transition with the latest source frame (i.e. transitions[0].destinationFrame)
 	int startFrame = transitions[0].GetDestinationFrame();
 
@@ -1,6 +1,11 @@
 #pragma once
 #include "Transition.h"
 #include "CompoundLoop.h"
+#include "SimilarityConfig.h"
+#include "SimilarityMatrix.h"
+#include "CompactMatrix.h"
+#include "SparseSimilarityMatrix.h"
+#include "TiledMatrixStore.h"
 #include <opencv2/opencv.hpp>
 
 using namespace std;
@@ -8,22 +13,46 @@ using namespace std;
 // Synthesis
 // - Tranforms a similarity matrix into a video texture
 // - A video texture is a video with a looping property (such that it can be played on a loop with no/minimal visual discontinuities)
+// - Distance matrices are only read (they are shared with the similarity matrices they came from)
+// - Every storage (in memory, sparse, compact or out-of-core) only needs its own PruneTransitions - the rest of synthesis is shared
+// - Compound loops are found with a flat table of (length x primitive loop) cells: every cell keeps a back-pointer, while costs, ranges
+//   and transition bitmasks are only kept for the last (longest primitive loop) lengths - the furthest back any cell looks
 
 class Synthesis {
 	public:
 		// Static Methods
-		static CompoundLoop GetTransitionSet(cv::Mat motionDistanceMatrix, cv::Mat futureCostDistanceMatrix, int lengthMultiplier);
+		static CompoundLoop GetTransitionSet(const cv::Mat& motionDistanceMatrix, const cv::Mat& futureCostDistanceMatrix, int lengthMultiplier, SimilarityConfig config = SimilarityConfig());
+		static CompoundLoop GetTransitionSet(SparseSimilarityMatrix motionSimilarityMatrix, SparseSimilarityMatrix futureCostSimilarityMatrix, int lengthMultiplier, SimilarityConfig config = SimilarityConfig());
+		static CompoundLoop GetTransitionSet(const SimilarityMatrix& motionSimilarityMatrix, const SimilarityMatrix& futureCostSimilarityMatrix, int lengthMultiplier, SimilarityConfig config = SimilarityConfig());
+		static bool VerifyStorage(const cv::Mat& motionDistanceMatrix, const cv::Mat& futureCostDistanceMatrix, MatrixStorage storage, SimilarityConfig config = SimilarityConfig(), CompactMatrixError* error = NULL);
 		static string CreateVideoTexture(string inputVideoFilePath, CompoundLoop transitions);
 
 	private:
+		// Cell of the compound loop table (lowest cost compound loop of a given length made with a given primitive loop)
+		struct LoopCell {
+			int cost;
+			int rangeStart;			// Latest source frame
+			int rangeEnd;			// Earliest destination frame
+			int transitionCount;	// 0 if no compound loop exists
+		};
+
 		// Static Methods
-		static vector<Transition> PruneTransitions(cv::Mat motionDistanceMatrix, cv::Mat futureCostDistanceMatrix);
+		template<class Matrix> static CompoundLoop ComputeTransitionSet(Matrix& motionDistanceMatrix, Matrix& futureCostDistanceMatrix, int lengthMultiplier, int transitionCount);
+		static vector<Transition> PruneTransitions(const cv::Mat& motionDistanceMatrix, const cv::Mat& futureCostDistanceMatrix, int transitionCount);
+		static vector<Transition> PruneTransitions(SparseSimilarityMatrix motionSimilarityMatrix, SparseSimilarityMatrix futureCostSimilarityMatrix, int transitionCount);
+		static vector<Transition> PruneTransitions(TiledMatrixStore& motionDistanceMatrix, TiledMatrixStore& futureCostDistanceMatrix, int transitionCount);
+		static vector<Transition> PruneTransitions(const CompactMatrix& motionDistanceMatrix, const CompactMatrix& futureCostDistanceMatrix, int transitionCount);
+		static vector<Transition> PruneTransitions(const SimilarityMatrix& motionSimilarityMatrix, const SimilarityMatrix& futureCostSimilarityMatrix, int transitionCount);
+		static vector<Transition> SelectBestTransitions(vector<Transition> localMinimaTransitions, vector<float> motionCosts, int transitionCount);
 		static CompoundLoop GetSetOfTransitions(vector<Transition> transitionMatrix, int lengthMultiplier);
-		static vector<CompoundLoop> GetLongestSetOfCompoundLoopsWithTransitions(vector<vector<CompoundLoop>> compoundLoops);
 		static CompoundLoop ScheduleTransitions(CompoundLoop transitionSet);
 		static CompoundLoop ScheduleBeforeStartPoint(CompoundLoop rangeSet);
 		static CompoundLoop ScheduleAfterStartPoint(CompoundLoop rangeSet);
 		static vector<int> GetFrameSequence(CompoundLoop transitions);
 		static string ComputeOutputFilePath(string inputFilePath);
+
+		// Static Parameters
+		static const int EMPTY_CELL = -2;
+		static const int PRIMITIVE_LOOP = -1;
 };
 
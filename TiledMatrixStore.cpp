@@ -0,0 +1,281 @@
+#include "TiledMatrixStore.h"
+#include <cstring>
+
+using namespace cv;
+using namespace std;
+
+// File header (little-endian, padded to HEADER_BYTES)
+struct TiledMatrixHeader {
+	uint32_t magic;
+	uint32_t version;
+	int32_t rows;
+	int32_t cols;
+	int32_t type;
+	int32_t tileSize;
+};
+
+//--------------------------------------------------------------------------------------
+// Constructors
+//--------------------------------------------------------------------------------------
+
+TiledMatrixStore::TiledMatrixStore() {
+	rows = 0;
+	cols = 0;
+	tileSize = DEFAULT_TILE_SIZE;
+	memoryBudget = DEFAULT_MEMORY_BUDGET;
+	completedTiles = 0;
+}
+
+//--------------------------------------------------------------------------------------
+// Getters & Setters
+//--------------------------------------------------------------------------------------
+
+string TiledMatrixStore::GetFilePath() {
+	return filePath;
+}
+
+int TiledMatrixStore::GetRows() {
+	return rows;
+}
+
+int TiledMatrixStore::GetCols() {
+	return cols;
+}
+
+int TiledMatrixStore::GetTileSize() {
+	return tileSize;
+}
+
+int TiledMatrixStore::GetTileRowCount() {
+	return (rows + tileSize - 1) / tileSize;
+}
+
+int TiledMatrixStore::GetTileColCount() {
+	return (cols + tileSize - 1) / tileSize;
+}
+
+int TiledMatrixStore::GetTileCount() {
+	return GetTileRowCount() * GetTileColCount();
+}
+
+size_t TiledMatrixStore::GetMemoryBudget() {
+	return memoryBudget;
+}
+
+void TiledMatrixStore::SetMemoryBudget(size_t budget) {
+	lock_guard<mutex> lock(residentTilesMutex);
+	memoryBudget = budget;
+	EvictTiles();
+}
+
+int TiledMatrixStore::GetResidentTileCount() {
+	lock_guard<mutex> lock(residentTilesMutex);
+	return int(residentTiles.size());
+}
+
+int TiledMatrixStore::GetCompletedTileCount() {
+	return completedTiles;
+}
+
+//--------------------------------------------------------------------------------------
+// Instance Methods (Public)
+//--------------------------------------------------------------------------------------
+
+// Creates a new (zero-filled) tiled matrix file
+bool TiledMatrixStore::Create(string filePath, int rows, int cols, int tileSize, size_t memoryBudget) {
+	// Parameters:
+	// - filePath: file the matrix is stored in (overwritten if it exists)
+	// - rows, cols: dimensions of the matrix
+	// - tileSize: width and height of each tile
+	// - memoryBudget: maximum bytes of tiles mapped at once
+
+	lock_guard<mutex> lock(residentTilesMutex);
+	residentTiles.clear();
+	recentTiles.clear();
+
+	this->filePath = filePath;
+	this->rows = max(rows, 0);
+	this->cols = max(cols, 0);
+	this->tileSize = max(tileSize, 1);
+	this->memoryBudget = memoryBudget;
+	completedTiles = 0;
+
+	uint64_t fileSize = HEADER_BYTES + uint64_t(GetTileCount()) * GetTileBytes();
+
+	if (!file.Create(filePath, fileSize))
+		return false;
+
+	shared_ptr<MappedRegion> region = file.MapRegion(0, HEADER_BYTES);
+	if (!region)
+		return false;
+
+	TiledMatrixHeader header = { MAGIC, VERSION, this->rows, this->cols, CV_32F, this->tileSize };
+	memset(region->GetData(), 0, HEADER_BYTES);
+	memcpy(region->GetData(), &header, sizeof(header));
+
+	return true;
+}
+
+// Opens an existing tiled matrix file (fails if the header is invalid or the file is truncated)
+bool TiledMatrixStore::Open(string filePath, size_t memoryBudget) {
+	lock_guard<mutex> lock(residentTilesMutex);
+	residentTiles.clear();
+	recentTiles.clear();
+
+	this->filePath = filePath;
+	this->memoryBudget = memoryBudget;
+	rows = 0;
+	cols = 0;
+	completedTiles = 0;
+
+	if (!file.Open(filePath, true) || (file.GetSize() < HEADER_BYTES))
+		return false;
+
+	shared_ptr<MappedRegion> region = file.MapRegion(0, HEADER_BYTES);
+	if (!region)
+		return false;
+
+	TiledMatrixHeader header;
+	memcpy(&header, region->GetData(), sizeof(header));
+
+	if ((header.magic != MAGIC) || (header.version != VERSION) || (header.type != CV_32F) || (header.tileSize <= 0)) {
+		file.Close();
+		return false;
+	}
+
+	rows = header.rows;
+	cols = header.cols;
+	tileSize = header.tileSize;
+
+	if (file.GetSize() < HEADER_BYTES + uint64_t(GetTileCount()) * GetTileBytes()) {
+		rows = 0;
+		cols = 0;
+		file.Close();
+		return false;
+	}
+
+	return true;
+}
+
+// Checks if a matrix file is open
+bool TiledMatrixStore::IsOpen() {
+	return file.IsOpen();
+}
+
+// Returns a copy of the specified tile (tileSize x tileSize - padding beyond the matrix edge included)
+Mat TiledMatrixStore::ReadTile(int tileRow, int tileCol) {
+	shared_ptr<MappedRegion> region = MapTile(tileRow, tileCol);
+	if (!region)
+		return Mat();
+
+	return Mat(tileSize, tileSize, CV_32F, region->GetData()).clone();
+}
+
+// Writes the specified tile (may be smaller than tileSize x tileSize at the matrix edge)
+void TiledMatrixStore::WriteTile(int tileRow, int tileCol, Mat tile) {
+	shared_ptr<MappedRegion> region = MapTile(tileRow, tileCol);
+	if (!region || tile.empty())
+		return;
+
+	Mat destination(tileSize, tileSize, CV_32F, region->GetData());
+	tile.convertTo(destination(Rect(0, 0, min(tile.cols, tileSize), min(tile.rows, tileSize))), CV_32F);
+}
+
+// Returns a copy of an arbitrary block of the matrix, gathered from the tiles it overlaps
+Mat TiledMatrixStore::ReadRegion(int rowStart, int rowEnd, int colStart, int colEnd) {
+	rowStart = max(rowStart, 0);
+	colStart = max(colStart, 0);
+	rowEnd = min(rowEnd, rows);
+	colEnd = min(colEnd, cols);
+
+	if ((rowEnd <= rowStart) || (colEnd <= colStart))
+		return Mat();
+
+	Mat output(rowEnd - rowStart, colEnd - colStart, CV_32F);
+
+	for (int tileRow = rowStart / tileSize; tileRow <= (rowEnd - 1) / tileSize; tileRow++) {
+		for (int tileCol = colStart / tileSize; tileCol <= (colEnd - 1) / tileSize; tileCol++) {
+			shared_ptr<MappedRegion> region = MapTile(tileRow, tileCol);
+			if (!region)
+				return Mat();
+
+			// Overlap between the tile and the requested block
+			int top = max(rowStart, tileRow * tileSize);
+			int bottom = min(rowEnd, (tileRow + 1) * tileSize);
+			int left = max(colStart, tileCol * tileSize);
+			int right = min(colEnd, (tileCol + 1) * tileSize);
+
+			Mat tile(tileSize, tileSize, CV_32F, region->GetData());
+			tile(Rect(left - tileCol * tileSize, top - tileRow * tileSize, right - left, bottom - top)).copyTo(output(Rect(left - colStart, top - rowStart, right - left, bottom - top)));
+		}
+	}
+
+	return output;
+}
+
+// Returns a single element of the matrix (maps the containing tile - prefer ReadTile/ReadRegion for bulk access)
+float TiledMatrixStore::GetValue(int i, int j) {
+	if ((i < 0) || (j < 0) || (i >= rows) || (j >= cols))
+		return 0;
+
+	shared_ptr<MappedRegion> region = MapTile(i / tileSize, j / tileSize);
+	if (!region)
+		return 0;
+
+	return reinterpret_cast<float*>(region->GetData())[(i % tileSize) * tileSize + (j % tileSize)];
+}
+
+// Resets the completed tile counter (at the start of a pass)
+void TiledMatrixStore::ResetProgress() {
+	completedTiles = 0;
+}
+
+// Marks a tile as completed - returns number of tiles completed in the current pass
+int TiledMatrixStore::CompleteTile() {
+	return ++completedTiles;
+}
+
+//--------------------------------------------------------------------------------------
+// Instance Methods (Private)
+//--------------------------------------------------------------------------------------
+
+// Returns number of bytes occupied by a tile in the file
+size_t TiledMatrixStore::GetTileBytes() {
+	return size_t(tileSize) * tileSize * sizeof(float);
+}
+
+// Returns mapping of the specified tile, mapping it (and unmapping the least recently used tiles) if it is not resident
+shared_ptr<MappedRegion> TiledMatrixStore::MapTile(int tileRow, int tileCol) {
+	if ((tileRow < 0) || (tileCol < 0) || (tileRow >= GetTileRowCount()) || (tileCol >= GetTileColCount()))
+		return NULL;
+
+	int index = tileRow * GetTileColCount() + tileCol;
+
+	lock_guard<mutex> lock(residentTilesMutex);
+
+	auto existing = residentTiles.find(index);
+	if (existing != residentTiles.end()) {
+		recentTiles.splice(recentTiles.begin(), recentTiles, existing->second.second);
+		return existing->second.first;
+	}
+
+	shared_ptr<MappedRegion> region = file.MapRegion(HEADER_BYTES + uint64_t(index) * GetTileBytes(), GetTileBytes());
+	if (!region)
+		return NULL;
+
+	recentTiles.push_front(index);
+	residentTiles[index] = make_pair(region, recentTiles.begin());
+	EvictTiles();
+
+	return region;
+}
+
+// Unmaps least recently used tiles until the resident tiles fit in the memory budget (at least one tile is always kept)
+void TiledMatrixStore::EvictTiles() {
+	size_t maxResidentTiles = max(memoryBudget / GetTileBytes(), size_t(1));
+
+	while (residentTiles.size() > maxResidentTiles) {
+		residentTiles.erase(recentTiles.back());
+		recentTiles.pop_back();
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include "MappedFile.h"
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+using namespace std;
+
+// TiledMatrixStore
+// - Stores a float matrix on disk as fixed-size square tiles (edge tiles are padded), so n^2 matrices larger than RAM can be processed
+// - File starts with a header holding the dimensions, element type and tile size, followed by the tiles in row-major tile order
+// - Tiles are memory-mapped on demand; the number of mapped tiles is bounded by a memory budget (least recently used tiles are unmapped first)
+// - Tiles are read and written by copy, so tile data handed out stays valid after the tile is unmapped (safe across threads)
+
+class TiledMatrixStore {
+	public:
+		// Constructors
+		TiledMatrixStore();
+
+		// Getters & Setters
+		string GetFilePath();
+		int GetRows();
+		int GetCols();
+		int GetTileSize();
+		int GetTileRowCount();
+		int GetTileColCount();
+		int GetTileCount();
+		size_t GetMemoryBudget();
+		void SetMemoryBudget(size_t budget);
+		int GetResidentTileCount();
+		int GetCompletedTileCount();
+
+		// Instance Methods
+		bool Create(string filePath, int rows, int cols, int tileSize = DEFAULT_TILE_SIZE, size_t memoryBudget = DEFAULT_MEMORY_BUDGET);
+		bool Open(string filePath, size_t memoryBudget = DEFAULT_MEMORY_BUDGET);
+		bool IsOpen();
+		cv::Mat ReadTile(int tileRow, int tileCol);
+		void WriteTile(int tileRow, int tileCol, cv::Mat tile);
+		cv::Mat ReadRegion(int rowStart, int rowEnd, int colStart, int colEnd);
+		float GetValue(int i, int j);
+		void ResetProgress();
+		int CompleteTile();
+
+		// Static Parameters
+		static const int DEFAULT_TILE_SIZE = 512;
+		static const size_t DEFAULT_MEMORY_BUDGET = size_t(512) * 1024 * 1024;
+
+	private:
+		// Parameters
+		string filePath;
+		int rows;
+		int cols;
+		int tileSize;
+		size_t memoryBudget;
+		MappedFile file;
+		map<int, pair<shared_ptr<MappedRegion>, list<int>::iterator>> residentTiles;
+		list<int> recentTiles;
+		mutex residentTilesMutex;
+		atomic<int> completedTiles;
+
+		// Static Parameters
+		static const uint32_t MAGIC = 0x4D545456;	// "VTTM"
+		static const uint32_t VERSION = 1;
+		static const size_t HEADER_BYTES = 64;
+
+		// Instance Methods
+		size_t GetTileBytes();
+		shared_ptr<MappedRegion> MapTile(int tileRow, int tileCol);
+		void EvictTiles();
+};
@@ -1,3 +1,4 @@
+#include "CSVCodec.h"
 #include <string>
 #include <fstream>
 #include <limits>
@@ -32,31 +33,9 @@ namespace utils_ {
     // File Operations
     //--------------------------------------------------------------------------------------
 
-    // Reads .csv file and stores in Mat
+    // Reads .csv file and stores in Mat (empty if the file is missing or its rows are ragged)
     static Mat ReadCSVFile(string filePath) {
-        vector<vector<float>> data;
-        string currentLine;
-
-        ifstream input(filePath);
-
-        while (getline(input, currentLine)) {
-            vector<float> lineValues;
-            stringstream tempLine(currentLine);
-            string this_value;
-            while (getline(tempLine, this_value, ',')) {
-                lineValues.push_back(atof(this_value.c_str()));
-            }
-            data.push_back(lineValues);
-        }
-
-        Mat matrix(int(data.size()), int(data[0].size()), CV_32F);
-        for (int row = 0; row < int(data.size()); row++) {
-            for (int col = 0; col < int(data[0].size()); col++) {
-                matrix.at<float>(row, col) = data[row][col];
-            }
-        }
-
-        return matrix;
+        return CSVCodec::Read(filePath);
     }
 
     //--------------------------------------------------------------------------------------
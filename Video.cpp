@@ -1,4 +1,5 @@
 #include "Video.h"
+#include <set>
 
 //--------------------------------------------------------------------------------------
 // Constructors
@@ -42,28 +43,48 @@ void Video::SetFutureCostFilePath(string fp) {
 	futureCostFilePath = fp;
 }
 
-SimilarityMatrix Video::GetEuclidean() {
+const SimilarityMatrix& Video::GetEuclidean() const {
 	return euclidean;
 }
 
 void Video::SetEuclidean(SimilarityMatrix e) {
-	euclidean = e;
+	euclidean = move(e);
 }
 
-SimilarityMatrix Video::GetMotion() {
+const SimilarityMatrix& Video::GetMotion() const {
 	return motion;
 }
 
+// Clears the frame hashes (the new matrix may come from another video)
 void Video::SetMotion(SimilarityMatrix m) {
-	motion = m;
+	motion = move(m);
+	frameHashes.clear();
 }
 
-SimilarityMatrix Video::GetFutureCost() {
+const SimilarityMatrix& Video::GetFutureCost() const {
 	return futureCost;
 }
 
 void Video::SetFutureCost(SimilarityMatrix fc) {
-	futureCost = fc;
+	futureCost = move(fc);
+}
+
+SimilarityConfig Video::GetConfig() {
+	return config;
+}
+
+// Clears the frame hashes (matrices computed with the previous config cannot be updated with this one)
+void Video::SetConfig(SimilarityConfig c) {
+	config = c;
+	frameHashes.clear();
+}
+
+const vector<uint64_t>& Video::GetFrameHashes() const {
+	return frameHashes;
+}
+
+void Video::SetFrameHashes(vector<uint64_t> h) {
+	frameHashes = move(h);
 }
 
 //--------------------------------------------------------------------------------------
@@ -78,9 +99,50 @@ void Video::SetFilePaths(string option) {
 	filename = filename.substr(0, filename.find('.'));
 
 	if (option.substr(0, 1) == "1")
-		SetEuclideanFilePath(filename + "_" + "DISTANCE_MATRIX_(EUCLIDEAN).csv");
+		SetEuclideanFilePath(filename + "_" + "DISTANCE_MATRIX_(EUCLIDEAN).vtm");
 	if (option.substr(1, 1) == "1")
-		SetMotionFilePath(filename + "_" + "DISTANCE_MATRIX_(MOTION).csv");
+		SetMotionFilePath(filename + "_" + "DISTANCE_MATRIX_(MOTION).vtm");
 	if (option.substr(2, 1) == "1")
-		SetFutureCostFilePath(filename + "_" + "DISTANCE_MATRIX_(FUTURE).csv");
+		SetFutureCostFilePath(filename + "_" + "DISTANCE_MATRIX_(FUTURE).vtm");
+}
+
+// Clears all matrices, their file paths and the frame hashes (e.g. when another video is selected, so nothing is updated from them)
+void Video::ClearMatrices() {
+	euclideanFilePath = "";
+	motionFilePath = "";
+	futureCostFilePath = "";
+	euclidean = SimilarityMatrix();
+	motion = SimilarityMatrix();
+	futureCost = SimilarityMatrix();
+	frameHashes.clear();
+}
+
+// Reports how many bytes of matrix data are live for this video
+MatrixMemoryReport Video::GetMatrixMemoryReport() const {
+	MatrixMemoryReport report;
+	set<const uchar*> counted;
+
+	for (const SimilarityMatrix* matrix : { &euclidean, &motion, &futureCost }) {
+		if (matrix->IsOutOfCore()) {
+			shared_ptr<TiledMatrixStore> store = matrix->GetTiledStore();
+			report.outOfCoreBytes += size_t(store->GetResidentTileCount()) * store->GetTileSize() * store->GetTileSize() * sizeof(float);
+			continue;
+		}
+
+		// Copies of a matrix share their distance data (or compact matrix)
+		const uchar* data = matrix->IsCompact() ? reinterpret_cast<const uchar*>(matrix->GetCompactMatrix().get()) : matrix->GetDistanceMatrix().datastart;
+		if ((data == NULL) || !counted.insert(data).second)
+			continue;
+
+		if (matrix->IsMapped())
+			report.mappedBytes += matrix->GetDistanceBytes();
+		else
+			report.distanceBytes += matrix->GetDistanceBytes();
+
+		report.probabilityBytes += matrix->GetProbabilityBytes();
+	}
+
+	report.totalBytes = report.distanceBytes + report.mappedBytes + report.probabilityBytes + report.outOfCoreBytes;
+
+	return report;
 }
\ No newline at end of file
@@ -1,11 +1,26 @@
 #pragma once
 #include "SimilarityMatrix.h"
+#include "SimilarityConfig.h"
+#include <cstdint>
 #include <string>
+#include <vector>
 
 using namespace std;
 
+// Bytes of matrix data held by the similarity matrices of a video (buffers shared between matrices are counted once)
+struct MatrixMemoryReport {
+	size_t distanceBytes = 0;		// Distance matrices held in memory (compact matrices count their compact size)
+	size_t mappedBytes = 0;			// Distance matrices mapped from binary matrix files (paged in on demand)
+	size_t probabilityBytes = 0;	// Probability matrices that have been computed
+	size_t outOfCoreBytes = 0;		// Tiles of out-of-core matrices that are currently mapped
+	size_t totalBytes = 0;
+};
+
 // Video
 // - Stores related data to an input video
+// - Similarity matrices are handed out as read-only references (no copies), and setters take ownership by moving
+// - The frame hashes of the video the motion matrix was computed from are kept, so the matrices can be updated when footage is appended
+//   (cleared whenever the motion matrix or config is replaced by other means, and with the matrices when another video is selected)
 
 class Video {
 	public:
@@ -21,15 +36,21 @@ class Video {
 		void SetMotionFilePath(string fp);
 		string GetFutureCostFilePath();
 		void SetFutureCostFilePath(string fp);
-		SimilarityMatrix GetEuclidean();
+		const SimilarityMatrix& GetEuclidean() const;
 		void SetEuclidean(SimilarityMatrix e);
-		SimilarityMatrix GetMotion();
+		const SimilarityMatrix& GetMotion() const;
 		void SetMotion(SimilarityMatrix m);
-		SimilarityMatrix GetFutureCost();
+		const SimilarityMatrix& GetFutureCost() const;
 		void SetFutureCost(SimilarityMatrix fc);
+		SimilarityConfig GetConfig();
+		void SetConfig(SimilarityConfig c);
+		const vector<uint64_t>& GetFrameHashes() const;
+		void SetFrameHashes(vector<uint64_t> h);
 
 		// Instance Methods
 		void SetFilePaths(string option);
+		void ClearMatrices();
+		MatrixMemoryReport GetMatrixMemoryReport() const;
 
 	private:
 		// Parameters
@@ -40,5 +61,7 @@ class Video {
 		SimilarityMatrix euclidean;
 		SimilarityMatrix motion;
 		SimilarityMatrix futureCost;
+		SimilarityConfig config;
+		vector<uint64_t> frameHashes;
 };
 
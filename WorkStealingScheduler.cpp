@@ -0,0 +1,111 @@
+#include "WorkStealingScheduler.h"
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Queue of task indices owned by a single worker
+struct WorkerQueue {
+	deque<int> tasks;
+	mutex lock;
+};
+
+// Takes a task from the back of the worker's own queue
+static bool PopTask(WorkerQueue& queue, int& task) {
+	lock_guard<mutex> guard(queue.lock);
+
+	if (queue.tasks.empty())
+		return false;
+
+	task = queue.tasks.back();
+	queue.tasks.pop_back();
+	return true;
+}
+
+// Takes a task from the front of another worker's queue
+static bool StealTask(WorkerQueue& queue, int& task) {
+	lock_guard<mutex> guard(queue.lock);
+
+	if (queue.tasks.empty())
+		return false;
+
+	task = queue.tasks.front();
+	queue.tasks.pop_front();
+	return true;
+}
+
+//--------------------------------------------------------------------------------------
+// Static Methods (Public)
+//--------------------------------------------------------------------------------------
+
+// Runs tasks [0, taskCount) and returns once every task has completed
+void WorkStealingScheduler::Run(int taskCount, function<void(int)> task, int threadCount) {
+	// Parameters:
+	// - taskCount: number of tasks (each task is identified by its index)
+	// - task: function called once per task index (must be safe to call concurrently)
+	// - threadCount: number of workers (0 uses every core)
+
+	if (taskCount <= 0)
+		return;
+
+	if (threadCount <= 0)
+		threadCount = GetDefaultThreadCount();
+	threadCount = min(threadCount, taskCount);
+
+	// Run on the calling thread if there is nothing to distribute
+	if (threadCount == 1) {
+		for (int i = 0; i < taskCount; i++)
+			task(i);
+		return;
+	}
+
+	// Give each worker a contiguous block of tasks (neighbouring tasks tend to share data)
+	vector<unique_ptr<WorkerQueue>> queues;
+	for (int w = 0; w < threadCount; w++) {
+		queues.push_back(make_unique<WorkerQueue>());
+		int start = int((long long)(taskCount) * w / threadCount);
+		int end = int((long long)(taskCount) * (w + 1) / threadCount);
+		for (int i = start; i < end; i++)
+			queues[w]->tasks.push_back(i);
+	}
+
+	auto worker = [&](int w) {
+		int current;
+		while (true) {
+			if (PopTask(*queues[w], current)) {
+				task(current);
+				continue;
+			}
+
+			// Own queue is empty - look for work elsewhere (tasks never create tasks, so no work anywhere means we are done)
+			bool stolen = false;
+			for (int offset = 1; offset < threadCount && !stolen; offset++)
+				stolen = StealTask(*queues[(w + offset) % threadCount], current);
+
+			if (!stolen)
+				break;
+
+			task(current);
+		}
+	};
+
+	// Calling thread acts as the first worker
+	vector<thread> threads;
+	for (int w = 1; w < threadCount; w++)
+		threads.push_back(thread(worker, w));
+
+	worker(0);
+
+	for (thread& t : threads)
+		t.join();
+}
+
+// Returns number of workers used when no thread count is specified
+int WorkStealingScheduler::GetDefaultThreadCount() {
+	int cores = int(thread::hardware_concurrency());
+	return max(cores, 1);
+}
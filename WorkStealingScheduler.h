@@ -0,0 +1,15 @@
+#pragma once
+#include <functional>
+
+using namespace std;
+
+// WorkStealingScheduler
+// - Runs a set of independent tasks across all cores
+// - Each worker owns a queue of tasks and steals from the other workers' queues once its own is empty
+
+class WorkStealingScheduler {
+	public:
+		// Static Methods
+		static void Run(int taskCount, function<void(int)> task, int threadCount = 0);
+		static int GetDefaultThreadCount();
+};